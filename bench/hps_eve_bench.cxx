@@ -0,0 +1,285 @@
+// HPS
+#include "DetectorGeometry.h"
+#include "EventIndex.h"
+#include "EventObjects.h"
+#include "FileCache.h"
+#include "Logger.h"
+#include "PropagatorRegistry.h"
+#include "SceneExporter.h"
+#include "ThreadPool.h"
+
+// ROOT
+#include "TROOT.h"
+
+// LCIO
+#include "IO/LCReader.h"
+#include "IOIMPL/LCFactory.h"
+
+// C++ standard library
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <dirent.h>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using hps::DetectorGeometry;
+using hps::EventIndex;
+using hps::EventObjects;
+using hps::FileCache;
+using hps::PropagatorRegistry;
+using hps::SceneExporter;
+using hps::ThreadPool;
+
+/*
+ * Times the stages of showing events from LCIO files, e.g. those written by
+ * hps-eve-gen-events, and prints one CSV row per stage and name with the
+ * number of timed calls, their total and their mean and maximum.
+ *
+ * The open stage times the parts of opening files in the display that do not
+ * need the GUI: loading the event index and the geometry, each without and
+ * with the copy saved in the cache. Every event is then read by its run and event number,
+ * built without the Eve manager, with the time of each builder by LCIO type,
+ * and cut with each of the cuts of the GUI.
+ */
+
+void print_usage() {
+    std::cout << "Usage: hps-eve-bench [args] [LCIO files]" << std::endl;
+    std::cout << "    -g [gdml]       : Path to GDML file (required)" << std::endl;
+    std::cout << "    -b [bY]         : Fixed mag field value (default 1.034)" << std::endl;
+    std::cout << "    -j [threads]    : Number of threads building collections (default 0)" << std::endl;
+    std::cout << "    -n [events]     : Maximum number of events (default all)" << std::endl;
+    std::cout << "    -m [p]          : MCParticle P cut (default 0.1)" << std::endl;
+    std::cout << "    -p [p]          : Track P cut (default 0.5)" << std::endl;
+    std::cout << "    -x [chi2]       : Track chi2 cut (default 20)" << std::endl;
+    std::cout << "    -e [expression] : Cut expression (default \"pt > 0.2 && charge != 0\")" << std::endl;
+    std::cout << "    -l [level]      : Log level (0-6)" << std::endl;
+    exit(1);
+}
+
+/**
+ * Timed calls of one stage.
+ */
+struct Timing {
+    int count{0};
+    double seconds{0.};
+    double max{0.};
+
+    void add(double s) {
+        count++;
+        seconds += s;
+        max = std::max(max, s);
+    }
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Remove a directory with the files in it.
+ */
+void remove_dir(const std::string& path) {
+    DIR* dir = opendir(path.c_str());
+    if (dir != nullptr) {
+        for (struct dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+            std::string name(entry->d_name);
+            if (name != "." && name != "..") {
+                std::remove((path + "/" + name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(path.c_str());
+}
+
+int main(int argc, char **argv) {
+
+    std::string geometryFile;
+    double bY = 1.034;
+    int buildThreads = 0;
+    int maxEvents = -1;
+    double mcPCut = 0.1;
+    double trackPCut = 0.5;
+    double chi2Cut = 20.;
+    std::string cutExpression = "pt > 0.2 && charge != 0";
+    int logLevel = hps::ERROR;
+
+    int c = 0;
+    while ((c = getopt(argc, argv, "hg:b:j:n:m:p:x:e:l:")) != -1) {
+        switch (c) {
+            case 'g':
+                geometryFile = optarg;
+                break;
+            case 'b':
+                bY = std::stod(optarg);
+                break;
+            case 'j':
+                buildThreads = atoi(optarg);
+                break;
+            case 'n':
+                maxEvents = atoi(optarg);
+                break;
+            case 'm':
+                mcPCut = std::stod(optarg);
+                break;
+            case 'p':
+                trackPCut = std::stod(optarg);
+                break;
+            case 'x':
+                chi2Cut = std::stod(optarg);
+                break;
+            case 'e':
+                cutExpression = optarg;
+                break;
+            case 'l':
+                logLevel = atoi(optarg);
+                break;
+            default:
+                print_usage();
+        }
+    }
+
+    std::vector<std::string> lcioFiles;
+    for (int index = optind; index < argc; index++) {
+        lcioFiles.push_back(std::string(argv[index]));
+    }
+    if (geometryFile.length() == 0 || lcioFiles.size() == 0) {
+        print_usage();
+    }
+
+    ROOT::EnableThreadSafety();
+
+    std::map<std::string, Timing> timings;
+
+    // The index and geometry are saved to a new cache directory, so that the first loads read the files.
+    char cacheDir[] = "/tmp/hps-eve-bench-XXXXXX";
+    if (mkdtemp(cacheDir) == nullptr) {
+        std::cerr << "ERROR: Failed to create cache directory" << std::endl;
+        return 1;
+    }
+    FileCache cache(cacheDir);
+    cache.setLogLevel(logLevel);
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        EventIndex coldIndex(&cache, lcioFiles);
+        coldIndex.setLogLevel(logLevel);
+        coldIndex.load();
+    }
+    timings["open,index_cold"].add(seconds_since(start));
+
+    EventIndex index(&cache, lcioFiles);
+    index.setLogLevel(logLevel);
+    start = std::chrono::steady_clock::now();
+    index.load();
+    timings["open,index_warm"].add(seconds_since(start));
+
+    // Loading the geometry again replaces the one that was loaded first.
+    {
+        DetectorGeometry coldDet(&cache);
+        coldDet.setLogLevel(logLevel);
+        start = std::chrono::steady_clock::now();
+        coldDet.loadDetectorFile(geometryFile);
+        timings["open,geometry_cold"].add(seconds_since(start));
+    }
+
+    DetectorGeometry det(&cache);
+    det.setLogLevel(logLevel);
+    start = std::chrono::steady_clock::now();
+    det.loadDetectorFile(geometryFile);
+    timings["open,geometry_warm"].add(seconds_since(start));
+    remove_dir(cacheDir);
+    if (buildThreads > 0) {
+        det.setMaxThreads(buildThreads);
+    }
+
+    int nEvents = index.getNumberOfEvents();
+    if (maxEvents >= 0) {
+        nEvents = std::min(nEvents, maxEvents);
+    }
+
+    PropagatorRegistry propagators(bY);
+    propagators.setLogLevel(logLevel);
+
+    // Events are built on a worker, where Eve does not need a manager.
+    {
+        ThreadPool pool(1);
+        pool.submit([&]() {
+            EventObjects builder(&det, &propagators, buildThreads);
+            builder.setLogLevel(logLevel);
+
+            // The expression is compiled once and then looked up by the cuts of every event.
+            auto compileStart = std::chrono::steady_clock::now();
+            builder.setCutExpression(cutExpression);
+            timings["cut,compile"].add(seconds_since(compileStart));
+
+            IO::LCReader* reader = nullptr;
+            int file = -1;
+            for (int i = 0; i < nEvents; i++) {
+                const EventIndex::Entry& entry = index.getEntry(i);
+
+                auto readStart = std::chrono::steady_clock::now();
+                if (entry.file != file) {
+                    if (reader != nullptr) {
+                        reader->close();
+                        delete reader;
+                    }
+                    reader = IOIMPL::LCFactory::getInstance()->createLCReader(IO::LCReader::directAccess);
+                    reader->open(index.getFile(entry.file));
+                    file = entry.file;
+                }
+                EVENT::LCEvent* event = reader->readEvent(entry.run, entry.event);
+                timings["read,event"].add(seconds_since(readStart));
+                if (event == nullptr) {
+                    std::cerr << "ERROR: Failed to read event: " << i << std::endl;
+                    continue;
+                }
+
+                auto buildStart = std::chrono::steady_clock::now();
+                std::vector<TEveElementList*> elementLists = builder.build(nullptr, event);
+                timings["build,event"].add(seconds_since(buildStart));
+                const EventObjects::BuildTimes& buildTimes = builder.getBuildTimes();
+                for (EventObjects::BuildTimes::const_iterator it = buildTimes.begin(); it != buildTimes.end(); it++) {
+                    timings["build," + it->first].add(it->second);
+                }
+                timings["build,decode"].add(builder.getDecodeTime());
+                timings["build,make_tracks"].add(builder.getMakeTracksTime());
+
+                auto cutStart = std::chrono::steady_clock::now();
+                builder.setMCPCut(mcPCut);
+                timings["cut,mcp_p"].add(seconds_since(cutStart));
+                cutStart = std::chrono::steady_clock::now();
+                builder.setTrackPCut(trackPCut);
+                timings["cut,track_p"].add(seconds_since(cutStart));
+                cutStart = std::chrono::steady_clock::now();
+                builder.setChi2Cut(chi2Cut);
+                timings["cut,chi2"].add(seconds_since(cutStart));
+                cutStart = std::chrono::steady_clock::now();
+                builder.setCutExpression(cutExpression);
+                timings["cut,expression"].add(seconds_since(cutStart));
+
+                for (size_t l = 0; l < elementLists.size(); l++) {
+                    SceneExporter::destroy(elementLists[l]);
+                }
+            }
+            if (reader != nullptr) {
+                reader->close();
+                delete reader;
+            }
+        }).get();
+    }
+
+    std::cout << "stage,name,count,seconds,mean_ms,max_ms" << std::endl;
+    for (std::map<std::string, Timing>::iterator it = timings.begin(); it != timings.end(); it++) {
+        const Timing& timing = it->second;
+        std::cout << it->first << "," << timing.count << "," << timing.seconds << ","
+                << (timing.count > 0 ? 1000. * timing.seconds / timing.count : 0.) << ","
+                << 1000. * timing.max << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,126 @@
+// HPS
+#include "DeferredStamp.h"
+#include "PropagatorRegistry.h"
+#include "ThreadPool.h"
+#include "TrackMaker.h"
+
+// ROOT
+#include "TEveTrack.h"
+#include "TEveVSDStructs.h"
+#include "TMath.h"
+#include "TRandom3.h"
+#include "TROOT.h"
+
+// C++ standard library
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using hps::DeferredStamp;
+using hps::PropagatorRegistry;
+using hps::ThreadPool;
+using hps::TrackMaker;
+
+/*
+ * Times making the points of synthetic tracks with the parallel track maker
+ * for increasing numbers of threads and prints the speedup over one thread.
+ */
+
+void print_usage() {
+    std::cout << "Usage: hps-eve-bench-tracks [args]" << std::endl;
+    std::cout << "    -n [tracks]     : Number of tracks (default 5000)" << std::endl;
+    std::cout << "    -b [bY]         : Fixed mag field value (default 1.034)" << std::endl;
+    std::cout << "    -j [threads]    : Maximum number of threads (default all cores)" << std::endl;
+    std::cout << "    -r [repeat]     : Number of timed runs per thread count (default 3)" << std::endl;
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+
+    int nTracks = 5000;
+    double bY = 1.034;
+    int maxThreads = std::max((int) std::thread::hardware_concurrency(), 1);
+    int repeat = 3;
+
+    int c = 0;
+    while ((c = getopt(argc, argv, "hn:b:j:r:")) != -1) {
+        switch (c) {
+            case 'n':
+                nTracks = atoi(optarg);
+                break;
+            case 'b':
+                bY = std::stod(optarg);
+                break;
+            case 'j':
+                maxThreads = atoi(optarg);
+                break;
+            case 'r':
+                repeat = atoi(optarg);
+                break;
+            default:
+                print_usage();
+        }
+    }
+
+    ROOT::EnableThreadSafety();
+
+    PropagatorRegistry propagators(bY);
+    PropagatorRegistry::Settings settings;
+    TEveTrackPropagator* propagator = propagators.getPropagator(settings);
+
+    // Tracks are created on a worker, where Eve does not need a manager.
+    std::vector<TEveTrack*> tracks;
+    {
+        ThreadPool pool(1);
+        pool.submit([&tracks, nTracks]() {
+            TRandom3 random(12345);
+            for (int i = 0; i < nTracks; i++) {
+                TEveRecTrack recTrack;
+                double p = random.Uniform(0.1, 2.5);
+                double theta = random.Uniform(0., 0.1);
+                double phi = random.Uniform(0., TMath::TwoPi());
+                recTrack.fV.Set(0., 0., 0.);
+                recTrack.fP.Set(p * sin(theta) * cos(phi), p * sin(theta) * sin(phi), p * cos(theta));
+                recTrack.fSign = random.Rndm() < 0.5 ? -1 : 1;
+                tracks.push_back(new DeferredStamp<TEveTrack>(&recTrack, nullptr));
+            }
+        }).get();
+    }
+
+    // Powers of two up to the maximum, which is always included
+    std::vector<int> threadCounts;
+    for (int nThreads = 1; nThreads < maxThreads; nThreads *= 2) {
+        threadCounts.push_back(nThreads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    std::cout << "threads,tracks,seconds,speedup" << std::endl;
+    double single = 0.;
+    for (size_t t = 0; t < threadCounts.size(); t++) {
+        int nThreads = threadCounts[t];
+        ThreadPool pool(nThreads);
+        TrackMaker maker(&propagators, &pool);
+        maker.setMinTracksPerTask(1);
+        double best = -1.;
+        for (int r = 0; r < repeat; r++) {
+            for (size_t i = 0; i < tracks.size(); i++) {
+                maker.addTrack(tracks[i], propagator);
+            }
+            auto start = std::chrono::steady_clock::now();
+            maker.makeTracks();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (best < 0. || elapsed.count() < best) {
+                best = elapsed.count();
+            }
+        }
+        if (nThreads == 1) {
+            single = best;
+        }
+        std::cout << nThreads << "," << nTracks << "," << best << "," << single / best << std::endl;
+    }
+
+    return 0;
+}
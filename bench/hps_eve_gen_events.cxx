@@ -0,0 +1,718 @@
+// ROOT
+#include "TMath.h"
+#include "TRandom3.h"
+
+// LCIO
+#include "EVENT/LCIO.h"
+#include "IMPL/CalorimeterHitImpl.h"
+#include "IMPL/ClusterImpl.h"
+#include "IMPL/LCCollectionVec.h"
+#include "IMPL/LCEventImpl.h"
+#include "IMPL/LCRunHeaderImpl.h"
+#include "IMPL/MCParticleImpl.h"
+#include "IMPL/ParticleIDImpl.h"
+#include "IMPL/ReconstructedParticleImpl.h"
+#include "IMPL/SimCalorimeterHitImpl.h"
+#include "IMPL/SimTrackerHitImpl.h"
+#include "IMPL/TrackImpl.h"
+#include "IMPL/TrackStateImpl.h"
+#include "IMPL/VertexImpl.h"
+#include "IO/LCWriter.h"
+#include "IOIMPL/LCFactory.h"
+
+// C++ standard library
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using EVENT::LCIO;
+
+/*
+ * Writes reproducible synthetic events with fixed numbers of objects per
+ * collection, and optionally a stand-in GDML geometry whose volumes are named
+ * like those of the HPS detector, so that hps-eve can be run and timed
+ * without real data or network access. All lengths are in mm and momenta in GeV.
+ */
+
+// Tracker layers along the beam, each with a top and a bottom module of two sensors
+static const double LAYER_Z[] = {50., 100., 200., 300., 500., 700., 900.};
+static const int N_LAYERS = sizeof(LAYER_Z) / sizeof(LAYER_Z[0]);
+static const double SENSOR_X = 100.;
+static const double SENSOR_Y = 40.;
+static const double SENSOR_Z = 0.32;
+static const double SENSOR_GAP = 4.;
+static const double MODULE_Y = 30.;
+
+// Tracking volume, which holds the base of the modules and the hodoscope
+static const double TRACKING_Z = 500.;
+static const double BASE_Z = 450.;
+
+// Hodoscope layers in front of the ECAL
+static const double HODO_Z[] = {1100., 1110.};
+
+// ECAL crystals in columns -23 to 23 and rows -5 to 5 without 0
+static const int N_COLUMNS = 23;
+static const int N_ROWS = 5;
+static const double CRYSTAL_PITCH = 16.;
+static const double CRYSTAL_FRONT = 13.3;
+static const double CRYSTAL_LENGTH = 160.;
+static const double CRYSTAL_Y0 = 22.;
+static const double ECAL_Z = 1394.;
+
+static const double FIELD_CONVERSION = 2.99792458e-4;
+
+struct Crystal {
+    int ix;
+    int iy;
+};
+
+void print_usage() {
+    std::cout << "Usage: hps-eve-gen-events [args] [LCIO file]" << std::endl;
+    std::cout << "    -g [gdml]       : Also write the matching stand-in geometry" << std::endl;
+    std::cout << "    -d [name]       : Detector name (default HPS-Bench-v1)" << std::endl;
+    std::cout << "    -n [events]     : Number of events (default 1000)" << std::endl;
+    std::cout << "    -s [seed]       : Random seed (default 12345)" << std::endl;
+    std::cout << "    -i [run]        : Run number (default 1)" << std::endl;
+    std::cout << "    -b [bY]         : Mag field value of the tracks (default 1.034)" << std::endl;
+    std::cout << "    -p [n]          : MCParticles per event (default 30)" << std::endl;
+    std::cout << "    -k [n]          : SimTrackerHits per event (default 100)" << std::endl;
+    std::cout << "    -c [n]          : SimCalorimeterHits per event (default 40)" << std::endl;
+    std::cout << "    -t [n]          : Tracks per event (default 4)" << std::endl;
+    std::cout << "    -l [n]          : Clusters per event (default 3)" << std::endl;
+    std::cout << "    -f [n]          : ReconstructedParticles per event (default 6)" << std::endl;
+    std::cout << "    -v [n]          : Vertices per event (default 2)" << std::endl;
+    std::cout << "    -w [ms]         : Write one event at a time with this delay, e.g. to test follow mode" << std::endl;
+    exit(1);
+}
+
+double crystal_x(int ix) {
+    return (ix > 0 ? 1. : -1.) * (std::abs(ix) - 0.5) * CRYSTAL_PITCH;
+}
+
+double crystal_y(int iy) {
+    return (iy > 0 ? 1. : -1.) * (CRYSTAL_Y0 + (std::abs(iy) - 0.5) * CRYSTAL_PITCH);
+}
+
+int crystal_cell_id(int ix, int iy) {
+    return ((ix + 64) << 8) | (iy + 64);
+}
+
+std::vector<Crystal> all_crystals() {
+    std::vector<Crystal> crystals;
+    for (int iy = -N_ROWS; iy <= N_ROWS; iy++) {
+        for (int ix = -N_COLUMNS; ix <= N_COLUMNS; ix++) {
+            if (ix != 0 && iy != 0) {
+                Crystal crystal = {ix, iy};
+                crystals.push_back(crystal);
+            }
+        }
+    }
+    return crystals;
+}
+
+void write_box(std::ostream& out, const std::string& name, double x, double y, double z) {
+    out << "    <box name=\"" << name << "\" x=\"" << x << "\" y=\"" << y << "\" z=\"" << z
+            << "\" lunit=\"mm\"/>" << std::endl;
+}
+
+void write_volume(std::ostream& out, const std::string& name, const std::string& material,
+                  const std::string& solid, const std::vector<std::string>& physvols) {
+    out << "    <volume name=\"" << name << "\">" << std::endl;
+    out << "      <materialref ref=\"" << material << "\"/>" << std::endl;
+    out << "      <solidref ref=\"" << solid << "\"/>" << std::endl;
+    for (size_t i = 0; i < physvols.size(); i++) {
+        out << physvols[i];
+    }
+    out << "    </volume>" << std::endl;
+}
+
+std::string physvol(const std::string& volume, int copy, double x, double y, double z) {
+    std::stringstream ss;
+    ss << "      <physvol copynumber=\"" << copy << "\">" << std::endl;
+    ss << "        <volumeref ref=\"" << volume << "\"/>" << std::endl;
+    ss << "        <position name=\"" << volume << "_" << copy << "_pos\" x=\"" << x << "\" y=\"" << y
+            << "\" z=\"" << z << "\" unit=\"mm\"/>" << std::endl;
+    ss << "      </physvol>" << std::endl;
+    return ss.str();
+}
+
+/**
+ * Write a geometry with the volume names and paths that the display looks
+ * for: tracker modules with sensors under the base of the tracking volume,
+ * the hodoscope in the tracking volume and the crystals in the world volume.
+ */
+void write_gdml(const std::string& path) {
+    std::ofstream out(path.c_str());
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << std::endl;
+    out << "<gdml>" << std::endl;
+    out << "  <define/>" << std::endl;
+
+    out << "  <materials>" << std::endl;
+    out << "    <material name=\"Vacuum\" Z=\"1.0\"><D value=\"1e-25\"/><atom value=\"1.00794\"/></material>" << std::endl;
+    out << "    <material name=\"Silicon\" Z=\"14.0\"><D value=\"2.33\"/><atom value=\"28.0855\"/></material>" << std::endl;
+    out << "    <material name=\"Scintillator\" Z=\"6.0\"><D value=\"1.032\"/><atom value=\"12.011\"/></material>" << std::endl;
+    out << "    <material name=\"LeadTungstate\" Z=\"74.0\"><D value=\"8.28\"/><atom value=\"183.84\"/></material>" << std::endl;
+    out << "  </materials>" << std::endl;
+
+    out << "  <solids>" << std::endl;
+    write_box(out, "world_box", 4000., 2000., 6000.);
+    write_box(out, "tracking_box", 1000., 400., 1400.);
+    write_box(out, "base_box", 900., 380., 1100.);
+    write_box(out, "module_box", SENSOR_X + 10., SENSOR_Y + 5., SENSOR_GAP + 2.);
+    write_box(out, "sensor_box", SENSOR_X, SENSOR_Y, SENSOR_Z);
+    write_box(out, "hodo_box", 300., 60., 5.);
+    out << "    <trd name=\"crystal_trd\" x1=\"" << CRYSTAL_FRONT << "\" x2=\"" << CRYSTAL_PITCH
+            << "\" y1=\"" << CRYSTAL_FRONT << "\" y2=\"" << CRYSTAL_PITCH
+            << "\" z=\"" << CRYSTAL_LENGTH << "\" lunit=\"mm\"/>" << std::endl;
+    out << "  </solids>" << std::endl;
+
+    out << "  <structure>" << std::endl;
+    std::vector<std::string> none;
+    std::vector<std::string> modules;
+    for (int l = 0; l < N_LAYERS; l++) {
+        for (int top = 1; top >= 0; top--) {
+            std::stringstream module;
+            module << "module_L" << (l + 1) << (top ? "t" : "b");
+            std::vector<std::string> sensors;
+            const char* kinds[] = {"axial", "stereo"};
+            for (int s = 0; s < 2; s++) {
+                std::string sensor = module.str() + "_sensor_" + kinds[s] + "_volume";
+                write_volume(out, sensor, "Silicon", "sensor_box", none);
+                sensors.push_back(physvol(sensor, 0, 0., 0., (s - 0.5) * SENSOR_GAP));
+            }
+            std::string volume = module.str() + "_volume";
+            write_volume(out, volume, "Vacuum", "module_box", sensors);
+            modules.push_back(physvol(volume, 0, 0., top ? MODULE_Y : -MODULE_Y, LAYER_Z[l] - BASE_Z));
+        }
+    }
+    write_volume(out, "base_volume", "Vacuum", "base_box", modules);
+
+    std::vector<std::string> tracking;
+    tracking.push_back(physvol("base_volume", 0, 0., 0., BASE_Z - TRACKING_Z));
+    for (int l = 0; l < 2; l++) {
+        for (int top = 1; top >= 0; top--) {
+            std::stringstream hodo;
+            hodo << "hodo_vol_L" << (l + 1) << (top ? "t" : "b");
+            write_volume(out, hodo.str(), "Scintillator", "hodo_box", none);
+            tracking.push_back(physvol(hodo.str(), 0, 0., top ? 52. : -52., HODO_Z[l] - TRACKING_Z));
+        }
+    }
+    write_volume(out, "tracking_volume", "Vacuum", "tracking_box", tracking);
+
+    write_volume(out, "crystal_volume", "LeadTungstate", "crystal_trd", none);
+    std::vector<std::string> world;
+    world.push_back(physvol("tracking_volume", 0, 0., 0., TRACKING_Z));
+    std::vector<Crystal> crystals = all_crystals();
+    for (size_t i = 0; i < crystals.size(); i++) {
+        world.push_back(physvol("crystal_volume", i + 1, crystal_x(crystals[i].ix), crystal_y(crystals[i].iy),
+                                ECAL_Z + CRYSTAL_LENGTH / 2.));
+    }
+    write_volume(out, "world_volume", "Vacuum", "world_box", world);
+    out << "  </structure>" << std::endl;
+
+    out << "  <setup name=\"Default\" version=\"1.0\">" << std::endl;
+    out << "    <world ref=\"world_volume\"/>" << std::endl;
+    out << "  </setup>" << std::endl;
+    out << "</gdml>" << std::endl;
+    out.close();
+    if (out.fail()) {
+        std::cerr << "ERROR: Failed to write GDML file: " << path << std::endl;
+        exit(1);
+    }
+}
+
+/**
+ * Generator of the collections of an event, which are named like those in
+ * HPS reconstruction output.
+ */
+class EventGenerator {
+
+    public:
+
+        EventGenerator(unsigned int seed, double bY) : random_(seed), bY_(bY), crystals_(all_crystals()) {
+        }
+
+        void setMultiplicities(int nParticles, int nTrackerHits, int nCalHits,
+                               int nTracks, int nClusters, int nRecon, int nVertices) {
+            nParticles_ = nParticles;
+            nTrackerHits_ = nTrackerHits;
+            nCalHits_ = std::min(nCalHits, (int) crystals_.size());
+            nTracks_ = nTracks;
+            nClusters_ = nClusters;
+            nRecon_ = nRecon;
+            nVertices_ = nVertices;
+        }
+
+        IMPL::LCEventImpl* generate(int run, int eventNumber, const std::string& detectorName) {
+            IMPL::LCEventImpl* event = new IMPL::LCEventImpl();
+            event->setRunNumber(run);
+            event->setEventNumber(eventNumber);
+            event->setDetectorName(detectorName);
+            event->setTimeStamp(1000000000LL * eventNumber);
+
+            IMPL::LCCollectionVec* particles = createMCParticles();
+            event->addCollection(particles, "MCParticle");
+            event->addCollection(createSimTrackerHits(particles), "TrackerHits");
+            event->addCollection(createSimCalorimeterHits(particles), "EcalHits");
+
+            std::vector<double> trackCharges;
+            std::vector<std::vector<double>> trackMomenta;
+            IMPL::LCCollectionVec* tracks = createTracks(trackCharges, trackMomenta);
+            event->addCollection(tracks, "GBLTracks");
+
+            IMPL::LCCollectionVec* calHits = new IMPL::LCCollectionVec(LCIO::CALORIMETERHIT);
+            calHits->setFlag(1 << LCIO::RCHBIT_LONG);
+            IMPL::LCCollectionVec* clusters = createClusters(calHits);
+            event->addCollection(calHits, "EcalCalHits");
+            event->addCollection(clusters, "EcalClustersCorr");
+
+            IMPL::LCCollectionVec* recon = createFinalStateParticles(tracks, trackCharges, trackMomenta, clusters);
+            event->addCollection(recon, "FinalStateParticles");
+
+            IMPL::LCCollectionVec* candidates = new IMPL::LCCollectionVec(LCIO::RECONSTRUCTEDPARTICLE);
+            event->addCollection(createVertices(recon, candidates), "UnconstrainedV0Vertices");
+            event->addCollection(candidates, "UnconstrainedV0Candidates");
+
+            return event;
+        }
+
+    private:
+
+        /**
+         * Beam electrons and positrons, whose secondaries start along the path of an
+         * earlier particle and end at the ECAL face.
+         */
+        IMPL::LCCollectionVec* createMCParticles() {
+            static const int pdgs[] = {11, -11, 22, 211, -211, 2212};
+            static const double masses[] = {0.000511, 0.000511, 0., 0.13957, 0.13957, 0.938272};
+            static const double charges[] = {-1., 1., 0., 1., -1., 1.};
+
+            IMPL::LCCollectionVec* coll = new IMPL::LCCollectionVec(LCIO::MCPARTICLE);
+            std::vector<IMPL::MCParticleImpl*> particles;
+            for (int i = 0; i < nParticles_; i++) {
+                IMPL::MCParticleImpl* particle = new IMPL::MCParticleImpl();
+                int type = i < 2 ? i : random_.Integer(sizeof(pdgs) / sizeof(pdgs[0]));
+                double vertex[3] = {random_.Gaus(0., 0.1), random_.Gaus(0., 0.05), 0.};
+                double p = random_.Uniform(0.5, 2.5);
+                if (i >= 2) {
+                    IMPL::MCParticleImpl* parent = particles[random_.Integer(particles.size())];
+                    particle->addParent(parent);
+                    double f = random_.Uniform(0., 1.);
+                    for (int c = 0; c < 3; c++) {
+                        vertex[c] = parent->getVertex()[c] + f * (parent->getEndpoint()[c] - parent->getVertex()[c]);
+                    }
+                    p = random_.Uniform(0.05, 0.5) * parent->getMomentum()[2];
+                }
+                double theta = random_.Uniform(0.015, 0.06);
+                double phi = random_.Uniform(0., TMath::TwoPi());
+                double momentum[3] = {p * sin(theta) * cos(phi), p * sin(theta) * sin(phi), p * cos(theta)};
+                double length = (ECAL_Z - vertex[2]) / cos(theta);
+                double endpoint[3];
+                for (int c = 0; c < 3; c++) {
+                    endpoint[c] = vertex[c] + length * momentum[c] / p;
+                }
+                particle->setPDG(pdgs[type]);
+                particle->setMass(masses[type]);
+                particle->setCharge(charges[type]);
+                particle->setGeneratorStatus(i < 2 ? 1 : 0);
+                particle->setVertex(vertex);
+                particle->setEndpoint(endpoint);
+                particle->setMomentum(momentum);
+                particle->setTime(0.);
+                particles.push_back(particle);
+                coll->addElement(particle);
+            }
+            return coll;
+        }
+
+        /**
+         * Hits at random positions on the sensors.
+         */
+        IMPL::LCCollectionVec* createSimTrackerHits(EVENT::LCCollection* particles) {
+            IMPL::LCCollectionVec* coll = new IMPL::LCCollectionVec(LCIO::SIMTRACKERHIT);
+            coll->setFlag(1 << LCIO::THBIT_MOMENTUM);
+            for (int i = 0; i < nTrackerHits_; i++) {
+                IMPL::SimTrackerHitImpl* hit = new IMPL::SimTrackerHitImpl();
+                int layer = random_.Integer(N_LAYERS);
+                int top = random_.Integer(2);
+                int sensor = random_.Integer(2);
+                double position[3] = {
+                    random_.Uniform(-SENSOR_X / 2., SENSOR_X / 2.),
+                    (top ? 1. : -1.) * (MODULE_Y + random_.Uniform(-SENSOR_Y / 2., SENSOR_Y / 2.)),
+                    LAYER_Z[layer] + (sensor - 0.5) * SENSOR_GAP
+                };
+                hit->setCellID0((layer << 8) | (top << 4) | sensor);
+                hit->setPosition(position);
+                hit->setEDep(random_.Exp(1.e-4));
+                hit->setTime(random_.Uniform(0., 50.));
+                if (particles->getNumberOfElements() > 0) {
+                    EVENT::MCParticle* particle = static_cast<EVENT::MCParticle*>(
+                            particles->getElementAt(random_.Integer(particles->getNumberOfElements())));
+                    hit->setMCParticle(particle);
+                    const double* p = particle->getMomentum();
+                    hit->setMomentum(p[0], p[1], p[2]);
+                }
+                hit->setPathLength(SENSOR_Z);
+                coll->addElement(hit);
+            }
+            return coll;
+        }
+
+        /**
+         * Hits at the centers of distinct crystals.
+         */
+        IMPL::LCCollectionVec* createSimCalorimeterHits(EVENT::LCCollection* particles) {
+            IMPL::LCCollectionVec* coll = new IMPL::LCCollectionVec(LCIO::SIMCALORIMETERHIT);
+            coll->setFlag(1 << LCIO::CHBIT_LONG);
+            for (int i = 0; i < nCalHits_; i++) {
+                std::swap(crystals_[i], crystals_[i + random_.Integer(crystals_.size() - i)]);
+                const Crystal& crystal = crystals_[i];
+                IMPL::SimCalorimeterHitImpl* hit = new IMPL::SimCalorimeterHitImpl();
+                float position[3] = {
+                    (float) crystal_x(crystal.ix),
+                    (float) crystal_y(crystal.iy),
+                    (float) (ECAL_Z + CRYSTAL_LENGTH / 2.)
+                };
+                float energy = random_.Exp(0.1);
+                hit->setCellID0(crystal_cell_id(crystal.ix, crystal.iy));
+                hit->setPosition(position);
+                if (particles->getNumberOfElements() > 0) {
+                    EVENT::MCParticle* particle = static_cast<EVENT::MCParticle*>(
+                            particles->getElementAt(random_.Integer(particles->getNumberOfElements())));
+                    hit->addMCParticleContribution(particle, energy, random_.Uniform(0., 50.), particle->getPDG());
+                } else {
+                    hit->setEnergy(energy);
+                }
+                coll->addElement(hit);
+            }
+            return coll;
+        }
+
+        /**
+         * Tracks from the target with states at the target, the first and last
+         * layer and the ECAL face. Track states are in the tracking frame, whose
+         * x, y and z are the z, x and y of the detector.
+         */
+        IMPL::LCCollectionVec* createTracks(std::vector<double>& charges,
+                                            std::vector<std::vector<double>>& momenta) {
+            static const int locations[] = {
+                EVENT::TrackState::AtIP,
+                EVENT::TrackState::AtFirstHit,
+                EVENT::TrackState::AtLastHit,
+                EVENT::TrackState::AtCalorimeter
+            };
+            static const double beamPositions[] = {0., LAYER_Z[0], LAYER_Z[N_LAYERS - 1], ECAL_Z};
+
+            IMPL::LCCollectionVec* coll = new IMPL::LCCollectionVec(LCIO::TRACK);
+            for (int i = 0; i < nTracks_; i++) {
+                double charge = random_.Rndm() < 0.5 ? -1. : 1.;
+                double pt = random_.Uniform(0.3, 2.3);
+                double phi0 = random_.Uniform(-0.05, 0.05);
+                double tanLambda = (random_.Rndm() < 0.5 ? -1. : 1.) * random_.Uniform(0.015, 0.05);
+                float omega = (charge < 0. ? 1. : -1.) * bY_ * FIELD_CONVERSION / pt;
+
+                IMPL::TrackImpl* track = new IMPL::TrackImpl();
+                for (int s = 0; s < 4; s++) {
+                    double length = beamPositions[s] / cos(phi0);
+                    double phi = phi0 + omega * length;
+                    float reference[3] = {
+                        (float) ((sin(phi) - sin(phi0)) / omega),
+                        (float) (-(cos(phi) - cos(phi0)) / omega),
+                        (float) (length * tanLambda)
+                    };
+                    IMPL::TrackStateImpl* state = new IMPL::TrackStateImpl();
+                    state->setLocation(locations[s]);
+                    state->setD0(0.);
+                    state->setPhi(phi);
+                    state->setOmega(omega);
+                    state->setZ0(0.);
+                    state->setTanLambda(tanLambda);
+                    state->setReferencePoint(reference);
+                    track->addTrackState(state);
+                }
+                track->setChi2(random_.Uniform(0., 30.));
+                track->setNdf(7);
+                coll->addElement(track);
+
+                std::vector<double> p = {pt * sin(phi0), pt * tanLambda, pt * cos(phi0)};
+                charges.push_back(charge);
+                momenta.push_back(p);
+            }
+            return coll;
+        }
+
+        /**
+         * Clusters of the crystals around a seed crystal.
+         */
+        IMPL::LCCollectionVec* createClusters(IMPL::LCCollectionVec* calHits) {
+            IMPL::LCCollectionVec* coll = new IMPL::LCCollectionVec(LCIO::CLUSTER);
+            coll->setFlag(1 << LCIO::CLBIT_HITS);
+            for (int i = 0; i < nClusters_; i++) {
+                const Crystal& seed = crystals_[random_.Integer(crystals_.size())];
+                IMPL::ClusterImpl* cluster = new IMPL::ClusterImpl();
+                double energy = 0.;
+                double center[3] = {0., 0., ECAL_Z};
+                for (int dx = -1; dx <= 1; dx++) {
+                    for (int dy = -1; dy <= 1; dy++) {
+                        int ix = seed.ix + dx;
+                        int iy = seed.iy + dy;
+                        if (ix == 0 || iy == 0 || std::abs(ix) > N_COLUMNS || std::abs(iy) > N_ROWS) {
+                            continue;
+                        }
+                        if ((dx != 0 || dy != 0) && random_.Rndm() < 0.3) {
+                            continue;
+                        }
+                        float e = (dx == 0 && dy == 0) ? random_.Uniform(0.5, 2.) : random_.Exp(0.05);
+                        float position[3] = {
+                            (float) crystal_x(ix),
+                            (float) crystal_y(iy),
+                            (float) (ECAL_Z + CRYSTAL_LENGTH / 2.)
+                        };
+                        IMPL::CalorimeterHitImpl* hit = new IMPL::CalorimeterHitImpl();
+                        hit->setCellID0(crystal_cell_id(ix, iy));
+                        hit->setEnergy(e);
+                        hit->setTime(random_.Uniform(30., 50.));
+                        hit->setPosition(position);
+                        calHits->addElement(hit);
+                        cluster->addHit(hit, 1.);
+                        energy += e;
+                        center[0] += e * position[0];
+                        center[1] += e * position[1];
+                    }
+                }
+                float position[3] = {(float) (center[0] / energy), (float) (center[1] / energy), (float) center[2]};
+                cluster->setEnergy(energy);
+                cluster->setPosition(position);
+                coll->addElement(cluster);
+            }
+            return coll;
+        }
+
+        /**
+         * Particles of the tracks and clusters in order, with electrons or
+         * positrons for tracks and photons for clusters without a track.
+         */
+        IMPL::LCCollectionVec* createFinalStateParticles(EVENT::LCCollection* tracks,
+                                                         const std::vector<double>& charges,
+                                                         const std::vector<std::vector<double>>& momenta,
+                                                         EVENT::LCCollection* clusters) {
+            IMPL::LCCollectionVec* coll = new IMPL::LCCollectionVec(LCIO::RECONSTRUCTEDPARTICLE);
+            for (int i = 0; i < nRecon_; i++) {
+                IMPL::ReconstructedParticleImpl* particle = new IMPL::ReconstructedParticleImpl();
+                double charge = 0.;
+                double p[3] = {0., 0., random_.Uniform(0.5, 2.)};
+                if (i < tracks->getNumberOfElements()) {
+                    particle->addTrack(static_cast<EVENT::Track*>(tracks->getElementAt(i)));
+                    charge = charges[i];
+                    for (int c = 0; c < 3; c++) {
+                        p[c] = momenta[i][c];
+                    }
+                }
+                if (i < clusters->getNumberOfElements()) {
+                    EVENT::Cluster* cluster = static_cast<EVENT::Cluster*>(clusters->getElementAt(i));
+                    particle->addCluster(cluster);
+                    if (charge == 0.) {
+                        const float* position = cluster->getPosition();
+                        double r = sqrt(position[0] * position[0] + position[1] * position[1]
+                                        + position[2] * position[2]);
+                        for (int c = 0; c < 3; c++) {
+                            p[c] = cluster->getEnergy() * position[c] / r;
+                        }
+                    }
+                }
+                double mass = charge != 0. ? 0.000511 : 0.;
+                float reference[3] = {0., 0., 0.};
+                particle->setType(charge != 0. ? 1 : 0);
+                particle->setMomentum(p);
+                particle->setEnergy(sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2] + mass * mass));
+                particle->setMass(mass);
+                particle->setCharge(charge);
+                particle->setReferencePoint(reference);
+
+                IMPL::ParticleIDImpl* pid = new IMPL::ParticleIDImpl();
+                pid->setPDG(charge < 0. ? 11 : (charge > 0. ? -11 : 22));
+                pid->setLikelihood(random_.Uniform(0., 1.));
+                particle->addParticleID(pid);
+                particle->setParticleIDUsed(pid);
+                particle->setGoodnessOfPID(pid->getLikelihood());
+                coll->addElement(particle);
+            }
+            return coll;
+        }
+
+        /**
+         * Vertices near the target, each with a candidate of two final state particles.
+         */
+        IMPL::LCCollectionVec* createVertices(EVENT::LCCollection* recon, IMPL::LCCollectionVec* candidates) {
+            IMPL::LCCollectionVec* coll = new IMPL::LCCollectionVec(LCIO::VERTEX);
+            int nRecon = recon->getNumberOfElements();
+            for (int i = 0; i < nVertices_; i++) {
+                IMPL::ReconstructedParticleImpl* candidate = new IMPL::ReconstructedParticleImpl();
+                double p[3] = {0., 0., 0.};
+                double energy = 0.;
+                double charge = 0.;
+                for (int d = 0; d < 2 && d < nRecon; d++) {
+                    EVENT::ReconstructedParticle* daughter = static_cast<EVENT::ReconstructedParticle*>(
+                            recon->getElementAt((2 * i + d) % nRecon));
+                    candidate->addParticle(daughter);
+                    for (int c = 0; c < 3; c++) {
+                        p[c] += daughter->getMomentum()[c];
+                    }
+                    energy += daughter->getEnergy();
+                    charge += daughter->getCharge();
+                }
+                double mass2 = energy * energy - p[0] * p[0] - p[1] * p[1] - p[2] * p[2];
+                float reference[3] = {0., 0., 0.};
+                candidate->setType(1);
+                candidate->setMomentum(p);
+                candidate->setEnergy(energy);
+                candidate->setMass(mass2 > 0. ? sqrt(mass2) : 0.);
+                candidate->setCharge(charge);
+                candidate->setReferencePoint(reference);
+
+                IMPL::VertexImpl* vertex = new IMPL::VertexImpl();
+                vertex->setPrimary(false);
+                vertex->setAlgorithmType("UnconstrainedV0");
+                vertex->setChi2(random_.Uniform(0., 10.));
+                vertex->setProbability(random_.Uniform(0., 1.));
+                vertex->setPosition(random_.Gaus(0., 0.2), random_.Gaus(0., 0.1), random_.Gaus(0., 2.));
+                vertex->setAssociatedParticle(candidate);
+                candidate->setStartVertex(vertex);
+
+                candidates->addElement(candidate);
+                coll->addElement(vertex);
+            }
+            return coll;
+        }
+
+    private:
+
+        TRandom3 random_;
+        double bY_;
+
+        // All crystals, of which the first ones are used in the current event
+        std::vector<Crystal> crystals_;
+
+        int nParticles_{30};
+        int nTrackerHits_{100};
+        int nCalHits_{40};
+        int nTracks_{4};
+        int nClusters_{3};
+        int nRecon_{6};
+        int nVertices_{2};
+};
+
+int main(int argc, char **argv) {
+
+    std::string gdmlFile;
+    std::string detectorName = "HPS-Bench-v1";
+    int nEvents = 1000;
+    unsigned int seed = 12345;
+    int run = 1;
+    double bY = 1.034;
+    int nParticles = 30;
+    int nTrackerHits = 100;
+    int nCalHits = 40;
+    int nTracks = 4;
+    int nClusters = 3;
+    int nRecon = 6;
+    int nVertices = 2;
+    int delayMillis = -1;
+
+    int c = 0;
+    while ((c = getopt(argc, argv, "hg:d:n:s:i:b:p:k:c:t:l:f:v:w:")) != -1) {
+        switch (c) {
+            case 'g':
+                gdmlFile = optarg;
+                break;
+            case 'd':
+                detectorName = optarg;
+                break;
+            case 'n':
+                nEvents = atoi(optarg);
+                break;
+            case 's':
+                seed = atoi(optarg);
+                break;
+            case 'i':
+                run = atoi(optarg);
+                break;
+            case 'b':
+                bY = std::stod(optarg);
+                break;
+            case 'p':
+                nParticles = atoi(optarg);
+                break;
+            case 'k':
+                nTrackerHits = atoi(optarg);
+                break;
+            case 'c':
+                nCalHits = atoi(optarg);
+                break;
+            case 't':
+                nTracks = atoi(optarg);
+                break;
+            case 'l':
+                nClusters = atoi(optarg);
+                break;
+            case 'f':
+                nRecon = atoi(optarg);
+                break;
+            case 'v':
+                nVertices = atoi(optarg);
+                break;
+            case 'w':
+                delayMillis = atoi(optarg);
+                break;
+            default:
+                print_usage();
+        }
+    }
+
+    if (optind != argc - 1) {
+        print_usage();
+    }
+    std::string lcioFile = argv[optind];
+
+    if (gdmlFile.length() > 0) {
+        write_gdml(gdmlFile);
+        std::cout << "Wrote geometry to: " << gdmlFile << std::endl;
+    }
+
+    EventGenerator generator(seed, bY);
+    generator.setMultiplicities(nParticles, nTrackerHits, nCalHits, nTracks, nClusters, nRecon, nVertices);
+
+    IO::LCWriter* writer = IOIMPL::LCFactory::getInstance()->createLCWriter();
+    writer->open(lcioFile, LCIO::WRITE_NEW);
+
+    IMPL::LCRunHeaderImpl runHeader;
+    runHeader.setRunNumber(run);
+    runHeader.setDetectorName(detectorName);
+    runHeader.setDescription("Synthetic events of hps-eve-gen-events");
+    writer->writeRunHeader(&runHeader);
+
+    for (int i = 0; i < nEvents; i++) {
+        IMPL::LCEventImpl* event = generator.generate(run, i, detectorName);
+        writer->writeEvent(event);
+        delete event;
+
+        // Each event is on disk before the next one is written, like a run being taken.
+        if (delayMillis >= 0) {
+            writer->flush();
+            usleep(delayMillis * 1000);
+        }
+    }
+
+    writer->close();
+    delete writer;
+
+    std::cout << "Wrote " << nEvents << " events to: " << lcioFile << std::endl;
+
+    return 0;
+}
@@ -1,12 +1,22 @@
 // HPS
+#include "DetectorGeometry.h"
 #include "EventDisplay.h"
+#include "EventIndex.h"
+#include "FileCache.h"
+#include "SceneExporter.h"
 
 // ROOT
 #include "TRint.h"
 #include "TEveBrowser.h"
+#include "TROOT.h"
 
 // C++ standard library
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 #include <set>
 #include <iostream>
@@ -21,8 +31,22 @@ void print_usage(const char* msg = 0, bool doExit = true, int returnCode = 1) {
     std::cout << "    -e [collection] : Exclude LCIO collection by name" << std::endl;
     std::cout << "    -t [type]       : Exclude LCIO collections by type" << std::endl;
     std::cout << "    -c [directory]  : Path to local cache directory" << std::endl;
-#if !defined(HAVE_CURL) || !defined(HAVE_LIBXML2)
-    std::cout << "GDML file is required (curl or libxml2 was not enabled)." << std::endl;
+    std::cout << "    -m [url]        : Base URL or local directory of detector files (mirror)" << std::endl;
+    std::cout << "    -r [depth]      : Number of events to read ahead (0 to disable)" << std::endl;
+    std::cout << "    -s [MB]         : Memory limit of the event scene cache (0 to disable)" << std::endl;
+    std::cout << "    -j [threads]    : Number of threads building collections (0 to disable)" << std::endl;
+    std::cout << "    -f              : Keep the full geometry instead of only the displayed volumes" << std::endl;
+    std::cout << "    -p [count]      : Most MCParticles drawn as tracks, others collapsed (0 for all)" << std::endl;
+    std::cout << "    -E [GeV]        : Collapse MCParticles below this energy" << std::endl;
+    std::cout << "    -D [depth]      : Collapse MCParticles deeper in the decay tree (-1 for any)" << std::endl;
+    std::cout << "    -a [events/s]   : Start auto play at this rate" << std::endl;
+    std::cout << "    -w              : Follow the input files as they are written" << std::endl;
+    std::cout << "    -x [directory]  : Export event scenes to JSON files without the GUI" << std::endl;
+    std::cout << "    -n [events]     : Events to export, e.g. 0-99 or 1,5,10-20 (default all)" << std::endl;
+#if !defined(HAVE_LIBXML2)
+    std::cout << "GDML file is required (libxml2 was not enabled)." << std::endl;
+#elif !defined(HAVE_CURL)
+    std::cout << "GDML file or local mirror is required (curl was not enabled)." << std::endl;
 #endif
     std::cout << "One or more LCIO files are required as extra arguments." << std::endl;
     if (msg) {
@@ -33,6 +57,37 @@ void print_usage(const char* msg = 0, bool doExit = true, int returnCode = 1) {
     }
 }
 
+/**
+ * Parse a list of event numbers and ranges, e.g. "1,5,10-20", or return all
+ * events if it is empty.
+ */
+std::vector<int> parse_events(const std::string& spec, int nEvents) {
+    std::vector<int> events;
+    if (spec.empty()) {
+        for (int i = 0; i < nEvents; i++) {
+            events.push_back(i);
+        }
+        return events;
+    }
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t dash = item.find('-', 1);
+        int first = std::stoi(item.substr(0, dash));
+        int last = dash != std::string::npos ? std::stoi(item.substr(dash + 1)) : first;
+        if (last < first) {
+            throw std::invalid_argument("Reversed range of events: " + item);
+        }
+        if (first < 0 || last >= nEvents) {
+            throw std::invalid_argument("Events out of range 0-" + std::to_string(nEvents - 1) + ": " + item);
+        }
+        for (int i = first; i <= last; i++) {
+            events.push_back(i);
+        }
+    }
+    return events;
+}
+
 int main (int argc, char **argv) {
 
     std::string geometryFile;
@@ -40,11 +95,23 @@ int main (int argc, char **argv) {
     std::set<std::string> excludeCollectionNames;
     std::set<std::string> excludeCollectionTypes;
     std::string cacheDir(".cache");
+    std::string detectorUrl;
     int logLevel = hps::ERROR;
     double bY = 0.0;
+    int readAheadDepth = 0;
+    int sceneCacheSize = 256;
+    int buildThreads = 0;
+    bool pruneGeometry = true;
+    int mcMaxParticles = 1000;
+    double mcMinEnergy = 0.;
+    int mcMaxDepth = -1;
+    double autoPlayRate = 0.;
+    bool follow = false;
+    std::string exportDir;
+    std::string exportEvents;
 
     int c = 0;
-    while ((c = getopt (argc, argv, "hb:e:g:l:c:t:")) != -1) {
+    while ((c = getopt (argc, argv, "hb:e:g:l:c:m:t:r:s:j:fp:E:D:a:wx:n:")) != -1) {
         switch (c) {
             case 'g':
                 geometryFile = std::string(optarg);
@@ -64,6 +131,42 @@ int main (int argc, char **argv) {
             case 'c':
                 cacheDir = std::string(optarg);
                 break;
+            case 'm':
+                detectorUrl = std::string(optarg);
+                break;
+            case 'r':
+                readAheadDepth = atoi(optarg);
+                break;
+            case 's':
+                sceneCacheSize = atoi(optarg);
+                break;
+            case 'j':
+                buildThreads = atoi(optarg);
+                break;
+            case 'f':
+                pruneGeometry = false;
+                break;
+            case 'p':
+                mcMaxParticles = atoi(optarg);
+                break;
+            case 'E':
+                mcMinEnergy = std::stod(optarg);
+                break;
+            case 'D':
+                mcMaxDepth = atoi(optarg);
+                break;
+            case 'a':
+                autoPlayRate = std::stod(optarg);
+                break;
+            case 'w':
+                follow = true;
+                break;
+            case 'x':
+                exportDir = std::string(optarg);
+                break;
+            case 'n':
+                exportEvents = std::string(optarg);
+                break;
             case 'h':
                 print_usage();
                 break;
@@ -77,10 +180,17 @@ int main (int argc, char **argv) {
         lcioFileList.push_back (std::string (argv[index]));
     }
 
-    // If curl and libxml2 were not both enabled, a GDML file must be provided on the command line.
-#if !defined(HAVE_CURL) || !defined(HAVE_LIBXML2)
+    // If libxml2 was not enabled, a GDML file must be provided on the command line.
+#if !defined(HAVE_LIBXML2)
     if (geometryFile.length () == 0) {
-        print_usage("ERROR: Missing path to geometry file (provide with '-g' switch or enable curl and libxml2)");
+        print_usage("ERROR: Missing path to geometry file (provide with '-g' switch or enable libxml2)");
+    }
+#elif !defined(HAVE_CURL)
+    // Without curl, detector files can only be copied from a local mirror.
+    bool localMirror = detectorUrl.length() > 0
+            && (detectorUrl.compare(0, 7, "file://") == 0 || detectorUrl.find("://") == std::string::npos);
+    if (geometryFile.length () == 0 && !localMirror) {
+        print_usage("ERROR: Missing path to geometry file (provide with '-g' switch, a local mirror with '-m' or enable curl)");
     }
 #endif
 
@@ -88,6 +198,52 @@ int main (int argc, char **argv) {
         print_usage("ERROR: Missing one or more LCIO files (provide as extra arguments)");
     }
 
+    // Export scenes without the GUI, each event built on one of the threads.
+    if (exportDir.length() > 0) {
+        ROOT::EnableThreadSafety();
+
+        hps::FileCache cache(cacheDir);
+        cache.setLogLevel(logLevel);
+        cache.createCacheDir();
+
+        hps::EventIndex index(&cache, lcioFileList);
+        index.setLogLevel(logLevel);
+        index.load();
+
+        hps::DetectorGeometry det(&cache);
+        det.setLogLevel(logLevel);
+        det.setPruneGeometry(pruneGeometry);
+        if (detectorUrl.length() > 0) {
+            det.setDetectorUrl(detectorUrl);
+        }
+        if (geometryFile.length() > 0) {
+            det.loadDetectorFile(geometryFile);
+        } else {
+            det.loadDetector(index.getDetectorName());
+        }
+
+        std::vector<int> events;
+        try {
+            events = parse_events(exportEvents, index.getNumberOfEvents());
+        } catch (std::exception& e) {
+            print_usage(("ERROR: Invalid list of events to export (" + std::string(e.what()) + ")").c_str());
+        }
+
+        int nThreads = buildThreads > 0 ? buildThreads : std::max(1, (int) std::thread::hardware_concurrency());
+        hps::SceneExporter exporter(&index, &det, bY, nThreads);
+        exporter.setLogLevel(logLevel);
+        exporter.setExcludedCollections(excludeCollectionNames, excludeCollectionTypes);
+        exporter.setMCDetail(mcMinEnergy, mcMaxDepth, mcMaxParticles);
+
+        auto start = std::chrono::steady_clock::now();
+        int nWritten = exporter.run(events, exportDir);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Exported " << nWritten << " events in " << seconds << " s ("
+                << (seconds > 0. ? nWritten / seconds : 0.) << " events/s) on "
+                << nThreads << " threads" << std::endl;
+        return nWritten == (int) events.size() ? 0 : 1;
+    }
+
     // Create ROOT interpreter.
     TRint *app = 0;
     app = new TRint("XXX", 0, 0);
@@ -110,6 +266,14 @@ int main (int argc, char **argv) {
     ed->addExcludeCollectionNames(excludeCollectionNames);
     ed->addExcludeCollectionTypes(excludeCollectionTypes);
     ed->setMagFieldY(bY);
+    ed->setReadAheadDepth(readAheadDepth);
+    ed->setSceneCacheSize(sceneCacheSize);
+    ed->setBuildThreads(buildThreads);
+    ed->setPruneGeometry(pruneGeometry);
+    ed->setMCDetail(mcMinEnergy, mcMaxDepth, mcMaxParticles);
+    ed->setAutoPlayRate(autoPlayRate);
+    ed->setFollow(follow);
+    ed->setDetectorUrl(detectorUrl);
     ed->initialize();
 
     // Post-initialization of the Eve components.
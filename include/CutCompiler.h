@@ -0,0 +1,52 @@
+#ifndef HPS_CUTCOMPILER_H_
+#define HPS_CUTCOMPILER_H_ 1
+
+// HPS
+#include "CutTable.h"
+#include "Logger.h"
+
+// C++ standard library
+#include <map>
+#include <string>
+#include <vector>
+
+namespace hps {
+
+    /**
+     * Compiles cut expressions with the interpreter into functions that scan
+     * the columns of a cut table or of other per-row variables.
+     *
+     * Expressions are C++ conditions on the column names, e.g.
+     * "p > 0.5 && abs(pdg) == 11". Compiled functions are kept for the
+     * session, because the interpreter cannot remove them again.
+     */
+    class CutCompiler : public Logger {
+
+        public:
+
+            CutCompiler();
+
+            virtual ~CutCompiler();
+
+            /**
+             * Get the function of an expression, which is compiled on first use.
+             * Returns null and logs an error if the expression does not compile,
+             * also when it is used again.
+             */
+            CutTable::CutFunction compile(const std::string& expression);
+
+            /**
+             * Get the function of an expression on the given variables, whose
+             * values are passed as columns in the same order.
+             */
+            CutTable::CutFunction compile(const std::string& expression,
+                                          const std::vector<std::string>& variables);
+
+        private:
+
+            // Functions by variables and expression
+            std::map<std::string, CutTable::CutFunction> functions_;
+    };
+}
+
+#endif
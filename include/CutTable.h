@@ -0,0 +1,117 @@
+#ifndef HPS_CUTTABLE_H_
+#define HPS_CUTTABLE_H_ 1
+
+// ROOT
+#include "TEveElement.h"
+
+// C++ standard library
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace hps {
+
+    /**
+     * Columns of the cut variables of the elements built from one LCIO type
+     * in an event.
+     *
+     * Each cut has a bit in a mask per element, and an element is drawn if
+     * it passes all cuts. Range cuts look up the elements whose result changes
+     * in the values sorted by their column, and only elements whose visibility
+     * changes are touched.
+     */
+    class CutTable {
+
+        public:
+
+            enum Column {
+                P,
+                PT,
+                CHI2,
+                CHARGE,
+                PDG,
+                ENERGY,
+                NHITS,
+                TIME,
+                NCOLUMNS
+            };
+
+            /** Values of all columns of a row */
+            struct Values {
+                double values[NCOLUMNS]{};
+            };
+
+            /**
+             * Compiled cut, which sets pass[i] to 0 or 1 for the values
+             * columns[column][i] of the n rows.
+             */
+            typedef void (*CutFunction)(unsigned long n, const double* const* columns, char* pass);
+
+        public:
+
+            /**
+             * Add a row for an element, which can be called from any thread
+             * while the event is built. Rows added after cuts were set, e.g.
+             * for expanded MCParticles, are cut right away.
+             */
+            void addRow(TEveElement* element, const Values& values);
+
+            /**
+             * Cut elements with a value of the column outside of [min, max].
+             * Returns the number of elements whose visibility changed.
+             */
+            int setRange(int cut, Column column, double min, double max);
+
+            /**
+             * Cut elements with a compiled function, or remove the cut if it is null.
+             * Returns the number of elements whose visibility changed.
+             */
+            int setFunction(int cut, CutFunction function);
+
+            int getNumberOfRows();
+
+            /**
+             * Name of a column in cut expressions.
+             */
+            static const char* getColumnName(Column column);
+
+        private:
+
+            struct Range {
+                Column column;
+                double min;
+                double max;
+            };
+
+            /**
+             * Set whether a row passes a cut and draw its element accordingly.
+             */
+            int setPass(size_t row, int cut, bool pass);
+
+            /**
+             * Add the rows with a value in [lo, hi), or in (lo, hi] if upper is set.
+             */
+            void findRows(Column column, double lo, double hi, bool upper, std::vector<int>& rows);
+
+            const std::vector<int>& getSorted(Column column);
+
+        private:
+
+            std::vector<TEveElement*> elements_;
+            std::vector<double> columns_[NCOLUMNS];
+
+            // Rows sorted by each column, made on first use
+            std::vector<int> sorted_[NCOLUMNS];
+
+            // Bit mask of failed cuts of each row
+            std::vector<unsigned int> failed_;
+
+            std::map<int, Range> ranges_;
+            std::map<int, CutFunction> functions_;
+
+            std::mutex mutex_;
+    };
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef HPS_DEFERREDSTAMP_H_
+#define HPS_DEFERREDSTAMP_H_ 1
+
+// HPS
+#include "ThreadPool.h"
+
+namespace hps {
+
+    /**
+     * Eve element that can be built on a worker thread.
+     *
+     * Changes of an element are registered with the global TEveManager,
+     * which is not thread safe. On a worker they are only recorded in the
+     * element, which is redrawn in full once it is added to a scene on the
+     * GUI thread. Elements built on a worker are not in a scene yet, so their
+     * scenes do not need to be notified of changes either.
+     */
+    template<class T>
+    class DeferredStamp : public T {
+
+        public:
+
+            using T::T;
+
+            virtual void AddStamp(UChar_t bits) {
+                if (ThreadPool::isWorkerThread()) {
+                    this->fChangeBits |= bits;
+                } else {
+                    T::AddStamp(bits);
+                }
+            }
+
+            virtual void ElementChanged(Bool_t updateScenes = kTRUE, Bool_t redraw = kFALSE) {
+                if (!ThreadPool::isWorkerThread()) {
+                    T::ElementChanged(updateScenes, redraw);
+                }
+            }
+    };
+}
+
+#endif
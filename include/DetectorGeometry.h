@@ -6,12 +6,18 @@
 
 // ROOT
 #include "TGeoManager.h"
+#include "TGeoMatrix.h"
 #include "TEveManager.h"
 #include "TEveGeoNode.h"
 #include "TEveElement.h"
+#include "TEveGeoShapeExtract.h"
 
 // C++ standard library
+#include <future>
 #include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #ifdef HAVE_LIBXML2
 
@@ -26,10 +32,32 @@ namespace hps {
 
     class DetectorGeometry : public Logger {
 
+        public:
+
+            /**
+             * ECAL crystal with its global transform, looked up by cell ID.
+             */
+            struct Crystal {
+                TGeoNode* node{nullptr};
+                TGeoVolume* volume{nullptr};
+                TGeoShape* shape{nullptr};
+                TGeoHMatrix matrix;
+
+                // Corners in global coordinates for drawing as a box, if the shape has 8 of them
+                bool hasVertices{false};
+                Float_t vertices[24];
+            };
+
         public:
 
             DetectorGeometry(EventDisplay* app, FileCache* cache);
 
+            /**
+             * Create the geometry without Eve elements, e.g. for building
+             * events without the display.
+             */
+            DetectorGeometry(FileCache* cache);
+
             ~DetectorGeometry();
 
             TGeoManager* getGeoManager();
@@ -39,40 +67,134 @@ namespace hps {
              */
             static TEveElement* toEveElement(TGeoManager* mgr, TGeoNode* node);
 
+            /**
+             * Find the ECAL crystal of a calorimeter hit from its cell ID, or from
+             * its position in cm if the cell ID was not seen before. Returns null
+             * if the position is not inside a crystal. This can be called from
+             * worker threads once setMaxThreads() was called.
+             */
+            const Crystal* findCrystal(long long cellID, const double* pos);
+
+            /**
+             * Combine the two LCIO cell ID words into one key.
+             */
+            static long long cellID(int cellID0, int cellID1) {
+                return ((long long) cellID1 << 32) | (unsigned int) cellID0;
+            }
+
+            /**
+             * Load a detector by name from the cached geometry if it was saved
+             * from the same LCDD file, or else download the LCDD file, extract
+             * and import its GDML and save it to the cache.
+             */
             void loadDetector(const std::string& detName);
 
+            /**
+             * Start fetching the LCDD file of a detector into the cache, whose
+             * future is ready once loadDetector() does not need to wait for it.
+             */
+            std::shared_future<void> fetchDetector(const std::string& detName);
+
+            /**
+             * Set the base URL of detector files, which may be a file:// URL
+             * or a local directory of a mirror.
+             */
+            void setDetectorUrl(const std::string& url);
+
+            /**
+             * Load a GDML file, or the cached geometry if it was saved from a
+             * file with the same contents.
+             */
             void loadDetectorFile(const std::string& gdmlName);
 
+            /**
+             * Keep only the volumes that are displayed or used for finding ECAL
+             * crystals in the geometry and its cache (on by default).
+             */
+            void setPruneGeometry(bool prune);
+
             bool isInitialized();
 
+            /**
+             * Enable navigation from this many threads besides the GUI thread,
+             * which each get their own navigator.
+             */
+            void setMaxThreads(int nThreads);
+
         private:
 
             void buildDetector();
 
             /**
-             * Create a list of Eve geometry elements from the children of a
-             * single volume specified by a path.
+             * Import a GDML file, save it with its extracts to the cache and
+             * read it back if it was pruned.
+             */
+            void importGeometry(const std::string& gdmlName,
+                                const std::string& name,
+                                const std::string& hash);
+
+            /**
+             * Read the geometry and the extracts from the cache, if they were
+             * saved from a source file with this hash.
              */
-            static TEveElementList* createGeoElements(TGeoManager*,
-                                                      const char* name,
-                                                      const char* path,
-                                                      const char* patt,
-                                                      Char_t transparency = 100);
+            bool readGeometryCache(const std::string& name, const std::string& hash);
+
+            bool writeGeometryCache(const std::string& name, const std::string& hash);
+
+            std::string getGeometryCacheName(const std::string& name);
 
             /**
-             * Add the SVT to Eve.
+             * Remove the volumes which are neither displayed nor ECAL crystals.
              */
-            void addTracker(Char_t transparency = 50);
+            void pruneGeometry();
 
             /**
-             * Add the Hodoscope to Eve.
+             * Create an extract of the shapes of the children of a single
+             * volume specified by a path.
              */
-            void addHodoscope(Char_t transparency = 50);
+            static TEveGeoShapeExtract* createGeoExtract(TGeoManager*,
+                                                         const char* name,
+                                                         const char* path,
+                                                         const char* patt,
+                                                         Char_t transparency = 100);
 
             /**
-             * Add the ECAL to Eve.
+             * Create an extract of the shape of the current volume.
              */
-            void addEcal(Char_t transparency = 50);
+            static TEveGeoShapeExtract* createShapeExtract(TGeoManager*,
+                                                           const char* name,
+                                                           Char_t transparency);
+
+            /**
+             * Create an extract of the SVT sensors.
+             */
+            TEveGeoShapeExtract* createTrackerExtract(Char_t transparency = 50);
+
+            /**
+             * Create the extracts of the SVT, ECAL and Hodoscope.
+             */
+            void createExtracts();
+
+            void clearExtracts();
+
+            /**
+             * Create a list of Eve geometry elements from an extract, which
+             * hands its shapes over to them.
+             */
+            static TEveElementList* createElements(TEveGeoShapeExtract* extract);
+
+            /**
+             * Build the table of ECAL crystals and the grid of their centers.
+             */
+            void buildCrystalTable();
+
+            /**
+             * Find the index of the crystal containing a position in cm, first
+             * from the crystals with nearby centers and then by navigation.
+             */
+            int findCrystalIndex(const double* pos);
+
+            long long gridKey(double x, double y);
 
         private:
 
@@ -83,6 +205,26 @@ namespace hps {
                 "https://raw.githubusercontent.com/JeffersonLab/hps-java/master/detector-data/detectors"};
 
             FileCache* fileCache_;
+
+            bool prune_{true};
+
+            // Shapes of the displayed volumes, which are saved with the geometry
+            TEveGeoShapeExtract* trackerExtract_{nullptr};
+            TEveGeoShapeExtract* ecalExtract_{nullptr};
+            TEveGeoShapeExtract* hodoExtract_{nullptr};
+
+            std::vector<Crystal> crystals_; //!
+
+            // Cell ID to crystal index
+            std::unordered_map<long long, int> cellIdMap_; //!
+            std::mutex cellIdMutex_; //!
+
+            // Grid cell of the crystal center in x and y to crystal indices
+            std::unordered_map<long long, std::vector<int>> crystalGrid_; //!
+            double gridSize_{0.}; //!
+
+            // Crystal node to crystal index, for lookups by navigation
+            std::map<TGeoNode*, int> nodeMap_; //!
     };
 }
 
@@ -5,9 +5,12 @@
 #include "Logger.h"
 
 // ROOT
+#include "TGButton.h"
 #include "TGFrame.h"
 #include "TEveManager.h"
+#include "TGLabel.h"
 #include "TGNumberEntry.h"
+#include "TGTextEntry.h"
 
 // LCIO
 #include "EVENT/LCCollection.h"
@@ -21,6 +24,7 @@ namespace hps {
     class EventManager;
     class DetectorGeometry;
     class FileCache;
+    class PropagatorRegistry;
 
     class EventDisplay : public TGMainFrame, public Logger {
 
@@ -46,17 +50,70 @@ namespace hps {
 
             void addExcludeCollectionTypes(std::set<std::string>);
 
+            /**
+             * Set the field, which propagates the tracks again if they were built.
+             */
             void setMagFieldY(double);
 
+            /**
+             * Set number of events to read ahead on a worker thread (0 to disable).
+             */
+            void setReadAheadDepth(int);
+
+            /**
+             * Set memory limit in MB for cached event scenes (0 to disable).
+             */
+            void setSceneCacheSize(int);
+
+            /**
+             * Set number of threads building collections (0 to build on the GUI thread).
+             */
+            void setBuildThreads(int);
+
+            /**
+             * Set whether volumes that are not displayed are removed from the
+             * geometry and its cache.
+             */
+            void setPruneGeometry(bool);
+
+            /**
+             * Set the limits of the MCParticles drawn as tracks of their own, below
+             * which they are collapsed (see EventObjects::setMCDetail).
+             */
+            void setMCDetail(double minEnergy, int maxDepth, int maxParticles);
+
+            /**
+             * Set the rate in events per second of auto play, which starts once
+             * the GUI is shown if it is positive.
+             */
+            void setAutoPlayRate(double);
+
+            /**
+             * Set whether the input files are followed as they are written,
+             * which starts once the GUI is shown.
+             */
+            void setFollow(bool);
+
+            /**
+             * Set the base URL of detector files, e.g. of a local mirror (empty for the default).
+             */
+            void setDetectorUrl(std::string);
+
             EventManager* getEventManager();
 
             TEveManager* getEveManager();
 
             DetectorGeometry* getDetectorGeometry();
 
+            FileCache* getFileCache();
+
+            PropagatorRegistry* getPropagatorRegistry();
+
             const std::vector<std::string>& getLcioFiles();
 
-            bool excludeCollection(const std::string& collName, EVENT::LCCollection* collection);
+            const std::set<std::string>& getExcludeCollectionNames();
+
+            const std::set<std::string>& getExcludeCollectionTypes();
 
             /**
              * Get current event number from GUI component.
@@ -65,12 +122,94 @@ namespace hps {
 
             double getMagFieldY();
 
+            /**
+             * Get field value from GUI component.
+             */
+            double getMagFieldEntry();
+
+            int getReadAheadDepth();
+
+            int getSceneCacheSize();
+
+            int getBuildThreads();
+
+            double getMCMinEnergy();
+
+            int getMCMaxDepth();
+
+            int getMCMaxParticles();
+
             double getMCPCut();
 
             double getTrackPCut();
 
             double getChi2Cut();
 
+            /**
+             * Get cut expression from GUI component.
+             */
+            std::string getCutExpression();
+
+            /**
+             * Get skim selection from GUI component.
+             */
+            std::string getSkimExpression();
+
+            /**
+             * Show the progress of the skim in the GUI.
+             */
+            void setSkimStatus(const std::string& status);
+
+            /**
+             * Get whether auto play is enabled from GUI component.
+             */
+            bool isAutoPlayEnabled();
+
+            /**
+             * Check or uncheck auto play in the GUI without starting or stopping it.
+             */
+            void setAutoPlayEnabled(bool enabled);
+
+            /**
+             * Get target rate of auto play in events per second from GUI component.
+             */
+            double getAutoPlayRate();
+
+            /**
+             * Show the actual rate and the dropped frames of auto play in the GUI.
+             */
+            void setAutoPlayStatus(const std::string& status);
+
+            /**
+             * Get whether following the input files is enabled from GUI component.
+             */
+            bool isFollowEnabled();
+
+            /**
+             * Check or uncheck follow in the GUI without starting or stopping it.
+             */
+            void setFollowEnabled(bool enabled);
+
+            /**
+             * Show the appended events and the latency of follow mode in the GUI.
+             */
+            void setFollowStatus(const std::string& status);
+
+            /**
+             * Update the range of the event number entry, e.g. after events were appended.
+             */
+            void setNumberOfEvents(int nEvents);
+
+            /**
+             * Get whether stage timing is enabled from GUI component.
+             */
+            bool isTimingEnabled();
+
+            /**
+             * Show the timings of stages in the GUI.
+             */
+            void setTimingStatus(const std::string& status);
+
         private:
 
             void buildGUI();
@@ -86,6 +225,8 @@ namespace hps {
 
             FileCache* cache_{nullptr};
 
+            PropagatorRegistry* propagators_{nullptr};
+
             TEveManager* eveManager_{nullptr};
             EventManager* eventManager_{nullptr};
             DetectorGeometry* det_{nullptr};
@@ -96,10 +237,39 @@ namespace hps {
 
             double bY_{0.};
 
+            int readAheadDepth_{0};
+
+            int sceneCacheSize_{0};
+
+            int buildThreads_{0};
+
+            bool pruneGeometry_{true};
+
+            double mcMinEnergy_{0.};
+            int mcMaxDepth_{-1};
+            int mcMaxParticles_{0};
+
+            double autoPlayRate_{0.};
+
+            bool follow_{false};
+
+            std::string detectorUrl_;
+
             TGNumberEntry* eventNumberEntry_{nullptr};
             TGNumberEntry* MCParticlePCutEntry_{nullptr};
             TGNumberEntry* trackPCutEntry_{nullptr};
             TGNumberEntry* chi2CutEntry_{nullptr};
+            TGNumberEntry* magFieldEntry_{nullptr};
+            TGTextEntry* cutExpressionEntry_{nullptr};
+            TGTextEntry* skimEntry_{nullptr};
+            TGLabel* skimStatusLabel_{nullptr};
+            TGCheckButton* autoPlayButton_{nullptr};
+            TGNumberEntry* autoPlayRateEntry_{nullptr};
+            TGLabel* autoPlayStatusLabel_{nullptr};
+            TGCheckButton* followButton_{nullptr};
+            TGLabel* followStatusLabel_{nullptr};
+            TGCheckButton* timingButton_{nullptr};
+            TGLabel* timingLabel_{nullptr};
 
             ClassDef(EventDisplay, 1);
     };
@@ -0,0 +1,119 @@
+#ifndef HPS_EVENTFOLLOWER_H_
+#define HPS_EVENTFOLLOWER_H_ 1
+
+// HPS
+#include "EventStore.h"
+#include "Logger.h"
+
+// C++ standard library
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+namespace hps {
+
+    class EventIndex;
+
+    /**
+     * Follows input files that are still being written, e.g. by the online
+     * reconstruction, and decodes the newest event on a worker thread.
+     *
+     * The worker waits for the files to change, with inotify if it is
+     * available or else by polling, and appends the complete events written
+     * since to the event index. Only the last appended event is decoded, so
+     * a burst of events costs one decode and the display shows the newest.
+     */
+    class EventFollower : public Logger {
+
+        public:
+
+            typedef std::chrono::steady_clock::time_point TimePoint;
+
+        public:
+
+            /**
+             * Follow the files of the index, checking them at least every
+             * pollMillis if changes cannot be watched.
+             */
+            EventFollower(EventIndex* index, int pollMillis = 250);
+
+            /**
+             * Stop the worker thread.
+             */
+            virtual ~EventFollower();
+
+            /**
+             * Skip collections with these names or types when decoding events.
+             */
+            void setExcludedCollections(const std::set<std::string>& names,
+                                        const std::set<std::string>& types);
+
+            /**
+             * Start the worker thread.
+             */
+            void start();
+
+            /**
+             * Stop the worker thread, which finishes the update in progress.
+             */
+            void stop();
+
+            bool isActive();
+
+            /**
+             * Get the store of the newest event that was not taken yet, with its
+             * ordinal position and the time its file was seen to change, or null
+             * if no event was appended since the last call.
+             */
+            std::shared_ptr<const EventStore> takeNewest(int& i, TimePoint& changed);
+
+            /**
+             * Get the number of events appended since the follower was started.
+             */
+            int getNumberOfAppended();
+
+        private:
+
+            void run();
+
+            /**
+             * Wait until a file may have changed or the poll period is over.
+             * Returns false if the follower was stopped.
+             */
+            bool wait();
+
+            void openWatches();
+
+            void closeWatches();
+
+        private:
+
+            EventIndex* index_;
+            int pollMillis_;
+
+            std::set<std::string> excludeCollectionNames_;
+            std::set<std::string> excludeCollectionTypes_;
+
+            // Newest decoded event, which is replaced by later ones until it is taken
+            std::shared_ptr<const EventStore> newest_;
+            int newestIndex_{-1};
+            TimePoint newestChanged_;
+
+            std::atomic<int> appended_{0};
+
+            // Descriptor of the inotify instance, or -1 if files are polled
+            int watchFd_{-1};
+
+            std::mutex mutex_;
+            std::condition_variable cond_;
+            std::thread worker_;
+            bool stop_{false};
+    };
+}
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef HPS_EVENTINDEX_H_
+#define HPS_EVENTINDEX_H_ 1
+
+// HPS
+#include "Logger.h"
+
+// LCIO
+#include "EVENT/LCEvent.h"
+#include "IO/LCReader.h"
+
+// C++ standard library
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace hps {
+
+    class FileCache;
+
+    /**
+     * Index of the events in a set of LCIO files by ordinal position.
+     *
+     * For every event the file, the offset of its SIO header record, the run
+     * and event numbers and the collection sizes are kept. LCIO readers cannot
+     * seek to a byte offset, so events are read by their numbers, and the
+     * offsets are used to check the index and to scan followed files from the
+     * last known event. The index is saved
+     * in the file cache directory and reused as long as the size and
+     * modification time of each file are unchanged.
+     *
+     * A direct-access reader still builds the table of event records of a file
+     * without one each time it is opened, which costs a pass over the file.
+     * The read ahead thus keeps one reader per file, while each worker of the
+     * skim and the export opens its own.
+     *
+     * Files that are still being written can be followed with update, which
+     * appends the complete events written since, while other threads read
+     * the index. Entries are never moved, so references to them stay valid.
+     */
+    class EventIndex : public Logger {
+
+        public:
+
+            struct Entry {
+                int file{-1};
+                long long offset{-1};
+                int run{-1};
+                int event{-1};
+                std::vector<int> sizes;
+            };
+
+            /**
+             * Called with the ordinal position and the event of the last event
+             * appended to a file by update, which is only valid during the call.
+             */
+            typedef std::function<void(int i, EVENT::LCEvent* event)> AppendFunction;
+
+        public:
+
+            EventIndex(FileCache* cache, const std::vector<std::string>& lcioFiles);
+
+            virtual ~EventIndex();
+
+            /**
+             * Load the index from the cache, indexing files which are new
+             * or have changed, and save it again if anything was indexed.
+             */
+            void load();
+
+            /**
+             * Index the complete events appended to the files since they were
+             * indexed, at the end of the ordinal positions. Only the appended
+             * bytes are scanned, and the events are read by a sequential reader
+             * per file that is kept open. Returns the number of new events.
+             */
+            int update(const AppendFunction& appended = AppendFunction());
+
+            int getNumberOfEvents();
+
+            const Entry& getEntry(int i);
+
+            /**
+             * Get the ordinal position of an event or -1 if it is not in the index.
+             */
+            int find(int run, int event);
+
+            const std::string& getFile(int file);
+
+            int getNumberOfFiles();
+
+            /**
+             * Get the detector name from the first event.
+             */
+            std::string getDetectorName();
+
+            std::vector<std::string> getCollectionNames();
+
+            /**
+             * Get size of a collection in event i or -1 if it does not exist.
+             */
+            int getCollectionSize(int i, const std::string& collectionName);
+
+            /**
+             * Find the offsets of the event header records in an SIO file
+             * from the record framing, without decoding any records. Only
+             * events whose records were written completely are found, from
+             * offset from on, and end is set to the offset to continue at.
+             */
+            static std::vector<long long> scanEventRecords(const std::string& path, long long from = 0,
+                                                           long long* end = nullptr);
+
+        private:
+
+            struct FileInfo {
+                std::string path;
+                long long size{-1};
+                long long mtime{-1};
+                std::string detector;
+                std::deque<Entry> entries;
+
+                // Offset to continue scanning at and reader of appended events
+                long long scanned{-1};
+                IO::LCReader* tail{nullptr};
+            };
+
+            bool read(const std::string& path);
+
+            void write(const std::string& path);
+
+            /**
+             * Read all events of a file to fill its entries.
+             */
+            void indexFile(FileInfo& info);
+
+            /**
+             * Read the events at these offsets, which were appended to file f.
+             */
+            int appendEvents(int f, const std::vector<long long>& offsets, const AppendFunction& appended);
+
+            /**
+             * Open the reader of appended events after the indexed events of a file.
+             */
+            void openTail(FileInfo& info);
+
+            /**
+             * Create the entry of an event with its collection sizes.
+             */
+            Entry createEntry(EVENT::LCEvent* event, long long offset);
+
+            /**
+             * Add entry e of file f at the next ordinal position.
+             */
+            void addPosition(int f, int e);
+
+            int getCollectionIndex(const std::string& collectionName);
+
+            std::string getIndexName();
+
+            static bool stat(const std::string& path, long long& size, long long& mtime);
+
+        private:
+
+            FileCache* cache_;
+
+            std::vector<FileInfo> files_;
+
+            // Ordinal position to file and entry in file
+            std::deque<std::pair<int, int>> events_;
+
+            // Run and event numbers to ordinal position
+            std::map<std::pair<int, int>, int> positions_;
+
+            std::vector<std::string> collectionNames_;
+            std::map<std::string, int> collectionIndex_;
+
+            // Guards the entries and collections, which update appends to.
+            std::recursive_mutex mutex_;
+    };
+}
+
+#endif
@@ -3,21 +3,30 @@
 
 // HPS
 #include "EventObjects.h"
+#include "SceneCache.h"
 
 // C++ standard library
+#include <chrono>
+#include <future>
 #include <iostream>
 
 // ROOT
 #include "TEveEventManager.h"
+#include "TTimer.h"
 
 // LCIO
 #include "EVENT/LCIO.h"
-#include "IO/LCReader.h"
 
 namespace hps {
 
+    class CutCompiler;
     class EventDisplay;
+    class EventFollower;
+    class EventIndex;
     class EventObjects;
+    class EventPrebuilder;
+    class EventReadAhead;
+    class EventSkim;
 
     class EventManager : public TEveEventManager, public Logger {
 
@@ -29,17 +38,28 @@ namespace hps {
 
             void Open();
 
+            /**
+             * Go to the event at ordinal position i in the input files.
+             */
             void GotoEvent(Int_t i);
+
+            /**
+             * Go to the next or previous event, or the next or previous event
+             * passing the skim if one was started.
+             */
             void NextEvent();
             void PrevEvent();
 
             /**
-             * Set event number from EventDisplay GUI.
+             * Set event number from EventDisplay GUI, which goes to the first
+             * event passing the skim from there if one was started.
              */
             void SetEventNumber();
 
             void setLogLevel(int verbosity);
 
+            int getNumberOfEvents();
+
             /**
              * Modify the MCParticle P cut according to GUI setting.
              */
@@ -52,6 +72,86 @@ namespace hps {
 
             void modifyChi2Cut();
 
+            /**
+             * Modify the cut expression according to GUI setting.
+             */
+            void modifyCutExpression();
+
+            /**
+             * Start a skim with the selection from the GUI, or stop it if the
+             * selection is blank.
+             */
+            void modifySkim();
+
+            /**
+             * Show the progress of the skim in the GUI.
+             */
+            void updateSkimStatus();
+
+            /**
+             * Start or stop auto play according to GUI setting.
+             */
+            void toggleAutoPlay();
+
+            /**
+             * Change the target rate of auto play according to GUI setting.
+             */
+            void modifyAutoPlayRate();
+
+            /**
+             * Show the next event of auto play once it is due, which is called
+             * from a timer while the next event is built on a worker.
+             */
+            void autoPlayStep();
+
+            /**
+             * Start or stop following the input files according to GUI setting.
+             */
+            void toggleFollow();
+
+            /**
+             * Show the newest appended event, which is called from a timer while
+             * the files are followed. With auto play it is shown at its frame times.
+             */
+            void followStep();
+
+            /**
+             * Enable or disable the timing of stages according to GUI setting.
+             */
+            void toggleTiming();
+
+            /**
+             * Show the timings of stages and the sizes of collections in the GUI.
+             */
+            void updateTimingStatus();
+
+            /**
+             * Load the detector once its files were fetched in the background.
+             */
+            void checkDetector();
+
+            /**
+             * Build the next slice of the heavy collections of the current event,
+             * which is called from a timer so that the GUI stays responsive.
+             */
+            void continueLoading();
+
+            /**
+             * Change the field according to GUI setting, which propagates
+             * the tracks again.
+             */
+            void modifyMagField();
+
+            /**
+             * Set the title of a highlighted or selected element from its LCIO object.
+             */
+            void updateElementTitle(TEveElement* element);
+
+            /**
+             * Expand the collapsed MCParticles below a selected element.
+             */
+            void expandElement(TEveElement* element);
+
             /*
             void Close();
             void AfterNewEventLoaded();
@@ -62,16 +162,123 @@ namespace hps {
 
         private:
 
-            void loadEvent(EVENT::LCEvent* event);
+            void loadEvent(std::shared_ptr<const EventStore> store);
+
+            /**
+             * Load the detector if this has not been done already, waiting for
+             * its files if they are still being fetched. Returns false if it
+             * could not be loaded, which is logged, since this is called from
+             * timer slots whose exceptions would end the GUI.
+             */
+            bool loadDetector();
+
+            /**
+             * Move the elements of the current event into the scene cache, or
+             * destroy them if the cache is disabled or the event is still being
+             * loaded, whose pending collections are then dropped.
+             */
+            void stashEvent();
+
+            /**
+             * Replace the current event with its scene from the cache.
+             */
+            void restoreEvent(Int_t i);
+
+            /**
+             * Add the elements of a cached or prebuilt scene to the current
+             * event, which takes ownership of the scene.
+             */
+            void showScene(SceneCache::Scene* scene);
+
+            /**
+             * Stop auto play and uncheck it in the GUI, e.g. on manual navigation.
+             */
+            void stopAutoPlay();
+
+            /**
+             * Start building the event after event i for auto play, unless its
+             * scene is cached. Wraps around at the last event.
+             */
+            void prebuildNext(int i);
+
+            /**
+             * Show the actual rate and the dropped frames of auto play in the GUI.
+             */
+            void updateAutoPlayStatus();
+
+            /**
+             * Build the newest event decoded by the follower, if there is one
+             * that was not shown yet. Returns whether an event was shown.
+             */
+            bool showNewestEvent();
+
+            /**
+             * Stop following the files and uncheck it in the GUI, e.g. on manual navigation.
+             */
+            void stopFollow();
+
+            /**
+             * Show the appended events and the latency of follow mode in the GUI.
+             */
+            void updateFollowStatus();
+
+            /**
+             * Apply the cuts from the GUI to the current event.
+             */
+            void applyCuts();
+
+            /**
+             * Redraw the 3D views after the current event changed.
+             */
+            void redraw();
 
         private:
 
-            IO::LCReader* reader_;
+            // Index of events in the input files by ordinal position.
+            EventIndex* index_{nullptr};
+
+            // Reads events, optionally ahead of the current one on a worker.
+            EventReadAhead* readAhead_{nullptr};
+
+            // Optional cache of the scenes of recently displayed events.
+            SceneCache* sceneCache_{nullptr};
+
+            // Scan for events passing a selection, which navigation steps through.
+            EventSkim* skim_{nullptr};
+            CutCompiler* skimCompiler_{nullptr};
+            TTimer* skimTimer_{nullptr};
+
+            // Builds the heavy collections of the current event after the others.
+            TTimer* loadTimer_{nullptr};
+
+            // Auto play, which builds the next event while the current one is shown.
+            EventPrebuilder* prebuilder_{nullptr};
+            TTimer* autoPlayTimer_{nullptr};
+            bool autoPlaying_{false};
+            int autoPlayNext_{-1};
+            std::chrono::steady_clock::time_point autoPlayStart_; //!
+            std::chrono::steady_clock::time_point nextFrame_; //!
+            int framesShown_{0};
+            int framesDropped_{0};
+
+            // Follow mode, which shows the newest event appended to the files.
+            EventFollower* follower_{nullptr};
+            TTimer* followTimer_{nullptr};
+            bool following_{false};
+            int knownEvents_{0};
+            double followLatency_{-1.};
+
+            // Updates the timings shown in the GUI while they are enabled.
+            TTimer* timingTimer_{nullptr};
+
+            // Files of the detector, which are fetched while the GUI starts.
+            std::string detName_;
+            std::shared_future<void> detectorFetch_; //!
+            TTimer* detectorTimer_{nullptr};
 
             EventDisplay* app_;
             EventObjects* event_;
 
-            int runNumber_{-1};
             int eventNum_{-1};
             //int maxEvents_{999999};
 
@@ -2,6 +2,9 @@
 #define HPS_EVENTOBJECTS_H_ 1
 
 // HPS
+#include "CutTable.h"
+#include "EventStore.h"
+#include "PropagatorRegistry.h"
 #include "EVENT/LCEvent.h"
 
 // ROOT
@@ -9,26 +12,119 @@
 #include "TStyle.h"
 #include "TDatabasePDG.h"
 #include "TEveTrack.h"
+#include "TVector3.h"
 
-// LCIO
-#include "EVENT/LCObject.h"
-#include "EVENT/SimTrackerHit.h"
 #include "Logger.h"
 
+// C++ standard library
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
 namespace hps {
 
+    class CutCompiler;
     class DetectorGeometry;
-    class EventDisplay;
+    class LCBoxSet;
+    class ThreadPool;
+    class TrackMaker;
 
     class EventObjects : public Logger {
 
         public:
 
-            EventObjects(EventDisplay* app);
+            /** Map of LCIO types to Eve element lists */
+            typedef std::map<std::string, std::vector<TEveElementList*>> TypeMap;
+
+            /** Map of LCIO types to the cut variables of their elements */
+            typedef std::map<std::string, std::shared_ptr<CutTable>> CutTables;
+
+            /** Map of LCIO types to the seconds spent creating their elements */
+            typedef std::map<std::string, double> BuildTimes;
+
+        public:
+
+            /**
+             * Create the builders of events, which build the collections of an
+             * event on this many worker threads or on the calling thread if 0.
+             */
+            EventObjects(DetectorGeometry* det, PropagatorRegistry* propagators, int buildThreads = 0);
 
             virtual ~EventObjects();
 
-            void build(TEveManager* manager, EVENT::LCEvent* event);
+            void setLogLevel(int level);
+
+            /**
+             * Skip collections with these names or types when building events.
+             */
+            void setExcludedCollections(const std::set<std::string>& names,
+                                        const std::set<std::string>& types);
+
+            /**
+             * Limit the MCParticles drawn as tracks of their own to those with at
+             * least minEnergy in GeV and at most maxDepth generations below the
+             * top (any if negative), and to the maxParticles most energetic ones
+             * (all if 0). The others are collapsed into groups below the closest
+             * drawn particle they descend from.
+             */
+            void setMCDetail(double minEnergy, int maxDepth, int maxParticles);
+
+            /**
+             * Expand the group of collapsed MCParticles below an element into
+             * tracks of the particles at its top and groups of their daughters.
+             * Returns false if the element has no such group.
+             */
+            bool expandMCParticles(TEveElement* element);
+
+            /**
+             * Decode an event into a new event store and build the elements of
+             * its collections from the store, which are added to the manager in
+             * the order of the collections. Without a manager they are only
+             * returned, and the caller has to destroy them.
+             */
+            std::vector<TEveElementList*> build(TEveManager* manager, EVENT::LCEvent* event);
+
+            /**
+             * Build all collections of an event that was already decoded like build,
+             * e.g. by the read ahead.
+             */
+            std::vector<TEveElementList*> build(TEveManager* manager, std::shared_ptr<const EventStore> store);
+
+            /**
+             * Decode an event and build only its cheap collections like build,
+             * queueing the heavy ones (MCParticles and SimCalorimeterHits) to be
+             * built with buildNext. Returns the elements that were added.
+             */
+            std::vector<TEveElementList*> startBuild(TEveManager* manager, EVENT::LCEvent* event);
+
+            /**
+             * Build the cheap collections of an event that was already decoded,
+             * e.g. on another thread, and queue the heavy ones like startBuild.
+             */
+            std::vector<TEveElementList*> startBuild(TEveManager* manager,
+                                                     std::shared_ptr<const EventStore> store);
+
+            /**
+             * Continue building the queued collections for about this many seconds,
+             * which creates the objects of the next collection and makes its tracks
+             * in slices.
+             * Returns the elements of a collection once they were added, else null.
+             */
+            TEveElementList* buildNext(TEveManager* manager, double seconds);
+
+            /**
+             * Whether queued collections remain to be built.
+             */
+            bool isBuilding();
+
+            /**
+             * Drop the queued collections, e.g. when going to another event, and
+             * destroy the elements of the one that is being built.
+             */
+            void cancelBuild();
 
             void setMCPCut(double cut);
 
@@ -36,23 +132,224 @@ namespace hps {
 
             void setChi2Cut(double cut);
 
+            /**
+             * Cut the elements that can be cut with a C++ expression of their
+             * cut variables, or remove the cut if it is blank.
+             */
+            void setCutExpression(const std::string& expression);
+
+            /**
+             * Get the element lists of the current event by LCIO type.
+             */
+            const TypeMap& getTypeMap();
+
+            /**
+             * Replace the element lists of the current event, e.g. when a cached
+             * scene is restored.
+             */
+            void setTypeMap(const TypeMap& typeMap);
+
+            const CutTables& getCutTables();
+
+            /**
+             * Replace the cut tables of the current event together with its element lists.
+             */
+            void setCutTables(const CutTables& cutTables);
+
+            /**
+             * Get the seconds spent in the builders of each type in the last
+             * event, summed over its collections.
+             */
+            const BuildTimes& getBuildTimes();
+
+            /**
+             * Get the seconds spent making the points of all tracks in the last event.
+             */
+            double getMakeTracksTime();
+
+            /**
+             * Get the seconds spent decoding the last event into its store.
+             */
+            double getDecodeTime();
+
+            /**
+             * Get the store of the current event, which is shared with its elements.
+             */
+            std::shared_ptr<const EventStore> getStore();
+
+            /**
+             * Replace the store of the current event together with its element lists.
+             */
+            void setStore(std::shared_ptr<const EventStore> store);
+
+            /**
+             * Record the number of objects in each collection of the current
+             * event that has elements, e.g. when a cached scene is shown.
+             */
+            void recordCounts();
+
         private:
 
-            TEveElementList* createSimTrackerHits(EVENT::LCCollection*);
+            /** Bits of the cuts in the cut tables */
+            enum Cut {
+                P_CUT,
+                CHI2_CUT,
+                EXPRESSION_CUT
+            };
+
+            /** Step through the palette between the colors of consecutive particles */
+            static const int PARTICLE_COLOR_STRIDE = 17;
+
+            /** Most tracks made at once while building a collection in slices */
+            static const size_t TRACKS_PER_SLICE = 256;
+
+            /** Most objects created at once while building a collection in slices */
+            static const int OBJECTS_PER_SLICE = 512;
+
+            /**
+             * MCParticles of a collection in breadth-first order, and the tracks
+             * of those that are drawn as tracks of their own.
+             */
+            struct MCParticleTree {
+                std::vector<int> order;
+                std::vector<char> drawn;
+                std::vector<TEveTrack*> tracks;
+                int nDrawn{0};
+            };
+
+            /**
+             * Whether collections of a type are heavy enough to be queued by startBuild.
+             */
+            static bool isDeferred(const std::string& typeName);
+
+            /**
+             * Decode an event into a new store and reset the elements and timings.
+             */
+            void decode(EVENT::LCEvent* event);
+
+            /**
+             * Make a decoded store current and reset the elements and timings.
+             */
+            void reset(std::shared_ptr<const EventStore> store);
+
+            /**
+             * Build all collections of the current store and make their tracks.
+             */
+            std::vector<TEveElementList*> buildAll(TEveManager* manager);
+
+            /**
+             * Build the cheap collections of the current store and queue the heavy ones.
+             */
+            std::vector<TEveElementList*> startCollections(TEveManager* manager);
+
+            /**
+             * Build the collections at these indices in the store, concurrently
+             * if there are workers, and add the time spent on each to its type.
+             */
+            std::vector<TEveElementList*> buildCollections(const std::vector<size_t>& indices);
+
+            /**
+             * Record the build time of each type and of making the tracks, once
+             * all collections of the event are built.
+             */
+            void recordTimes();
+
+            /**
+             * Make the first maxTracks queued tracks, or all if 0.
+             */
+            void makeTracks(size_t maxTracks);
+
+            /**
+             * Add the elements of collection i in the store to the manager, if
+             * there is one, and to the type map.
+             */
+            void addElements(TEveManager* manager, size_t i, TEveElementList* elements);
+
+            /**
+             * Create the elements of a collection in the store by its type, which
+             * may run on a worker thread. Returns null for unsupported types.
+             */
+            TEveElementList* createElements(const EventStore::Collection& collection);
+
+            /**
+             * Get the indices of the objects of a collection in the store.
+             */
+            static std::vector<int> getIndices(const EventStore::Collection& collection);
 
-            TEveElementList* createSimCalorimeterHits(EVENT::LCCollection*);
+            TEveElementList* createSimTrackerHits(const EventStore::Collection&);
 
-            TEveElementList* createMCParticles(EVENT::LCCollection*);
+            TEveElementList* createSimCalorimeterHits(const EventStore::Collection&);
 
-            TEveElementList* createCalClusters(EVENT::LCCollection*);
+            /**
+             * Add a box for each of the hits from begin to end of a collection.
+             */
+            void addSimCalorimeterHits(LCBoxSet* boxes, const EventStore::Collection& coll, int begin, int end);
 
-            TEveElementList* createReconTracks(EVENT::LCCollection*);
+            /**
+             * Refit the boxes of the hits once they were all added and put them in a list.
+             */
+            TEveElementList* finishSimCalorimeterHits(LCBoxSet* boxes);
 
-            TEveElementList* createTrackerHits(EVENT::LCCollection*);
+            TEveElementList* createMCParticles(const EventStore::Collection&, CutTable* cuts);
 
-            TEveElementList* createReconstructedParticles(EVENT::LCCollection*);
+            /**
+             * Order the particles of a collection and select those that are drawn
+             * as tracks within the limits of the level of detail.
+             */
+            void selectMCParticles(const EventStore::Collection& coll, MCParticleTree& tree);
 
-            TEveElementList* createVertices(EVENT::LCCollection*);
+            /**
+             * Create the tracks of the drawn particles from begin to end of a collection.
+             */
+            void createMCParticleTracks(const EventStore::Collection& coll, MCParticleTree& tree,
+                                        int begin, int end, CutTable* cuts);
+
+            /**
+             * Hang the tracks of the drawn particles from their parents, collapse the
+             * others into groups and return the list of the top-level elements.
+             */
+            TEveElementList* linkMCParticles(const EventStore::Collection& coll, MCParticleTree& tree);
+
+            /**
+             * Create the next objects of the collection being built in slices.
+             * Returns true once its elements are complete and set as building.
+             */
+            bool buildSlice();
+
+            /**
+             * Create the track of MCParticle i of a store, which is queued to be made
+             * with the propagator for its charge, with a row in the cut table if it is given.
+             */
+            TEveTrack* createMCParticle(const std::shared_ptr<const EventStore>& store, int i,
+                                        TEveTrackPropagator* propsetCharged,
+                                        TEveTrackPropagator* propsetNeutral,
+                                        CutTable* cuts);
+
+            /**
+             * Create the clusters at these indices in the store with colors from
+             * the cluster palette or all in the given color.
+             */
+            TEveElementList* createCalClusters(const std::vector<int>& indices, int color = -1);
+
+            /**
+             * Create the tracks at these indices in the store, with rows in the
+             * cut table if it is given.
+             */
+            TEveElementList* createReconTracks(const std::vector<int>& indices, CutTable* cuts = nullptr);
+
+            TEveElementList* createReconstructedParticles(const EventStore::Collection&, CutTable* cuts);
+
+            TEveElementList* createVertices(const std::vector<int>& indices);
+
+            /**
+             * Get the settings of the propagator for charged or neutral tracks.
+             */
+            static PropagatorRegistry::Settings getPropagatorSettings(bool charged);
+
+            /**
+             * Get the shared propagator for charged or neutral tracks.
+             */
+            TEveTrackPropagator* getPropagator(bool charged);
 
             /*
             static void findSimTrackerHits(std::vector<EVENT::SimTrackerHit*>& list,
@@ -60,22 +357,61 @@ namespace hps {
                                            EVENT::MCParticle* p);
             */
 
+            /**
+             * Titles of the objects at an index in the store, which are created
+             * when an element is highlighted or picked.
+             */
+            static TString simTrackerHitTitle(const EventStore& store, int i);
+
+            static TString vertexTitle(const EventStore& store, int i);
+
+            static TString clusterTitle(const EventStore& store, int i);
+
+            static TString simCalorimeterHitTitle(const EventStore& store, int i);
+
+            static TString calorimeterHitTitle(const EventStore& store, int i);
+
+            static TString mcParticleTitle(const EventStore& store, int i);
+
+            static TString reconTrackTitle(const EventStore& store, int i);
+
+            static TString reconstructedParticleTitle(const EventStore& store, int i);
+
+            /**
+             * Get the momentum of track state i of the store in the detector frame.
+             */
+            static TVector3 getTrackMomentum(const EventStore::TrackStates& states, int i, double bY);
+
             static TStyle createClusStyle();
 
+            /**
+             * Copy the colors of a palette, which is global in ROOT.
+             */
+            static std::vector<Color_t> getPaletteColors(TStyle& style);
+
             // static TStyle createParticleStyle();
 
             const std::vector<TEveElementList*> getElementsByType(const std::string& typeName);
 
             /**
-             * Recursively process a set of TEveTrack objects to apply a P cut.
+             * Get the cut table of a type in the current event, or null if it cannot be cut.
              */
-            void applyPCut(TEveElement* element, double& cut);
+            CutTable* getCutTable(const std::string& typeName);
 
-            void applyChi2Cut(TEveElementList* trackList);
+            /**
+             * Apply a range cut to the elements of a type.
+             */
+            void applyRange(const std::string& typeName, int cut, CutTable::Column column,
+                            double min, double max);
 
         private:
 
-            EventDisplay* app_;
+            DetectorGeometry* det_;
+
+            PropagatorRegistry* propagators_;
+
+            std::set<std::string> excludeCollectionNames_;
+            std::set<std::string> excludeCollectionTypes_;
 
             // P cut for MCParticles
             double mcPCut{0.0};
@@ -86,10 +422,51 @@ namespace hps {
             // chi2 cut for Recon Tracks
             double chi2Cut_{9999.0};
 
+            // Limits of the MCParticles drawn as tracks
+            double mcMinEnergy_{0.};
+            int mcMaxDepth_{-1};
+            int mcMaxParticles_{0};
+
             // Map of LCIO types to Eve element lists.
-            std::map<std::string, std::vector<TEveElementList*>> typeMap_;
+            TypeMap typeMap_;
+
+            // Cut variables of the current event by LCIO type
+            CutTables cutTables_;
+
+            std::string cutExpression_;
+
+            // Objects of the current event, which the builders read
+            std::shared_ptr<const EventStore> store_;
+
+            // Time spent decoding and building the last event
+            double decodeTime_{0.};
+            BuildTimes buildTimes_;
+            double makeTracksTime_{0.};
+
+            CutCompiler* compiler_{nullptr};
 
             TDatabasePDG* pdgdb_;
+
+            // Colors of the ECAL hit energy and cluster palettes
+            std::vector<Color_t> ecalPalette_;
+            std::vector<Color_t> clusPalette_;
+            std::vector<Color_t> particlePalette_;
+
+            // Workers building collections, if enabled
+            ThreadPool* pool_{nullptr};
+
+            // Tracks are made once all collections were built.
+            TrackMaker* trackMaker_{nullptr};
+
+            // Collections queued by startBuild, the one whose objects are being
+            // created in slices and then the one whose tracks are being made
+            std::deque<size_t> pendingCollections_;
+            bool slicing_{false};
+            int nextObject_{0};
+            LCBoxSet* slicedHits_{nullptr};
+            MCParticleTree slicedParticles_;
+            TEveElementList* building_{nullptr};
+            size_t buildingIndex_{0};
     };
 }
 
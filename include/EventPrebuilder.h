@@ -0,0 +1,125 @@
+#ifndef HPS_EVENTPREBUILDER_H_
+#define HPS_EVENTPREBUILDER_H_ 1
+
+// HPS
+#include "Logger.h"
+#include "SceneCache.h"
+
+// C++ standard library
+#include <atomic>
+#include <future>
+#include <set>
+#include <string>
+
+namespace hps {
+
+    class DetectorGeometry;
+    class EventObjects;
+    class EventReadAhead;
+    class PropagatorRegistry;
+    class ThreadPool;
+
+    /**
+     * Reads and builds the scene of the next event on a worker thread while
+     * the current one is on screen, e.g. for auto play.
+     *
+     * Like the workers of the scene exporter it has its own builder and
+     * propagators, so tracks are stepped without touching the ones of the
+     * display. The scene is then swapped in on the GUI thread like a cached
+     * one, and its tracks keep the propagators of the prebuilder.
+     */
+    class EventPrebuilder : public Logger {
+
+        public:
+
+            EventPrebuilder(EventReadAhead* readAhead, DetectorGeometry* det, double bY);
+
+            /**
+             * Wait for the build and destroy a scene that was not taken.
+             */
+            virtual ~EventPrebuilder();
+
+            void setLogLevel(int level);
+
+            /**
+             * Skip collections with these names or types when building events.
+             */
+            void setExcludedCollections(const std::set<std::string>& names,
+                                        const std::set<std::string>& types);
+
+            /**
+             * Set the limits of the MCParticles drawn as tracks (see EventObjects::setMCDetail).
+             */
+            void setMCDetail(double minEnergy, int maxDepth, int maxParticles);
+
+            /**
+             * Start reading and building event i on the worker, dropping the
+             * scene of the previous build if it was not taken.
+             */
+            void start(int i);
+
+            /**
+             * Whether a build was started and its scene was not taken yet.
+             */
+            bool isStarted();
+
+            /**
+             * Whether the started build is done, so that take does not wait.
+             */
+            bool isReady();
+
+            /**
+             * Get the event of the started build.
+             */
+            int getEventNumber();
+
+            /**
+             * Wait for the started build and give its scene to the caller, which
+             * is null if the event could not be read.
+             */
+            SceneCache::Scene* take();
+
+            /**
+             * Wait for the started build and destroy its scene.
+             */
+            void cancel();
+
+            /**
+             * Change the field of the propagators of prebuilt tracks, which
+             * waits for the started build.
+             */
+            void setMagFieldY(double bY);
+
+            /**
+             * Get the seconds spent reading and building the last event.
+             */
+            double getBuildTime();
+
+        private:
+
+            void build(int i);
+
+            void wait();
+
+        private:
+
+            EventReadAhead* readAhead_;
+
+            PropagatorRegistry* propagators_;
+
+            EventObjects* builder_;
+
+            ThreadPool* pool_;
+
+            std::future<void> future_;
+
+            int eventNum_{-1};
+
+            SceneCache::Scene* scene_{nullptr};
+
+            // Written by the worker and read by the GUI thread
+            std::atomic<double> buildTime_{0.};
+    };
+}
+
+#endif
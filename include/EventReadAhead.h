@@ -0,0 +1,160 @@
+#ifndef HPS_EVENTREADAHEAD_H_
+#define HPS_EVENTREADAHEAD_H_ 1
+
+// HPS
+#include "EventIndex.h"
+#include "EventStore.h"
+#include "Logger.h"
+
+// LCIO
+#include "IO/LCReader.h"
+
+// C++ standard library
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hps {
+
+    /**
+     * Reads and decodes events around the one on screen on a worker thread so
+     * that navigation does not stall on reading or decoding.
+     *
+     * Events are addressed by their ordinal position in the event index. Each
+     * file is read through one direct-access reader, so LCIO builds its table
+     * of event records once per file. An LCIO event is deleted by the next read
+     * of its reader, so it is decoded into an event store right away, which is
+     * shared with the caller for as long as it needs it.
+     *
+     * With a depth of zero no worker is started and events are only read
+     * on demand.
+     */
+    class EventReadAhead : public Logger {
+
+        public:
+
+            /**
+             * Get the event navigation goes to from event i in direction dir
+             * (+1 or -1), or -1 if there is none.
+             */
+            typedef std::function<int(int i, int dir)> StepFunction;
+
+        public:
+
+            EventReadAhead(EventIndex* index, int depth);
+
+            virtual ~EventReadAhead();
+
+            /**
+             * Start the worker thread.
+             */
+            void start();
+
+            /**
+             * Stop the worker thread and close all readers.
+             */
+            void stop();
+
+            /**
+             * Skip collections with these names or types when decoding events.
+             */
+            void setExcludedCollections(const std::set<std::string>& names,
+                                        const std::set<std::string>& types);
+
+            /**
+             * Get the store of event i, from the buffer if it was already read
+             * or otherwise by reading and decoding it on the calling thread.
+             * Returns null if the event could not be read.
+             */
+            std::shared_ptr<const EventStore> take(int i);
+
+            /**
+             * Move the read ahead to event i without reading it, e.g. because
+             * its scene was restored from the cache.
+             */
+            void skip(int i);
+
+            int getDepth();
+
+            /**
+             * Set how navigation steps between events, e.g. through the events
+             * of a skim. By default it steps to the adjacent events.
+             */
+            void setStepFunction(const StepFunction& step);
+
+        private:
+
+            struct Slot {
+                std::shared_ptr<const EventStore> store;
+                int index{-1};
+                bool busy{false};
+            };
+
+            void run();
+
+            /**
+             * Read and decode event i, or return null if it could not be read.
+             * Called without holding the mutex, for a slot the caller marked busy.
+             */
+            std::shared_ptr<const EventStore> read(int i);
+
+            /**
+             * Events that should be buffered, in order of priority.
+             */
+            std::vector<int> predict();
+
+            /**
+             * Record a navigation step to event i.
+             */
+            void addStep(int i);
+
+            /**
+             * Direction of travel from recent navigation steps (+1 or -1).
+             */
+            int direction();
+
+            Slot* findSlot(int i);
+
+            Slot* findFreeSlot(const std::vector<int>& keep);
+
+        private:
+
+            EventIndex* index_;
+            int depth_;
+
+            std::vector<Slot> slots_;
+
+            // Reader of each file, which is only used under the read mutex
+            std::vector<IO::LCReader*> readers_;
+            std::mutex readMutex_;
+
+            std::set<std::string> excludeCollectionNames_;
+            std::set<std::string> excludeCollectionTypes_;
+
+            StepFunction step_;
+
+            // Event the read ahead is centered on.
+            int center_{-1};
+
+            // Recent navigation steps, newest last.
+            std::deque<int> steps_;
+
+            // Events that could not be read, which are not read ahead again until
+            // the index changes, but are read again when they are taken.
+            std::set<int> failed_;
+            int indexedEvents_{0};
+
+            std::mutex mutex_;
+            std::condition_variable cond_;
+            std::thread worker_;
+            bool stop_{false};
+    };
+}
+
+#endif
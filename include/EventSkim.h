@@ -0,0 +1,179 @@
+#ifndef HPS_EVENTSKIM_H_
+#define HPS_EVENTSKIM_H_ 1
+
+// HPS
+#include "CutTable.h"
+#include "EventIndex.h"
+#include "Logger.h"
+
+// LCIO
+#include "EVENT/LCEvent.h"
+#include "IO/LCReader.h"
+
+// C++ standard library
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace hps {
+
+    class ThreadPool;
+
+    /**
+     * Scans the input files for events passing a selection, so that navigation
+     * can step through the passing events only.
+     *
+     * The events are split into chunks of consecutive events in one file,
+     * and every worker thread scans its own range of consecutive chunks with
+     * about the same number of bytes, from the record offsets in the index.
+     * Each worker has a direct access reader, which goes to the first event
+     * of its range and of each file by its number and then reads on. The
+     * selection is a compiled cut on the variables of an event, which are
+     * filled from the collections that are not excluded.
+     *
+     * Passing events are available while the scan is still running.
+     */
+    class EventSkim : public Logger {
+
+        public:
+
+            enum Variable {
+                NTRACKS,
+                NPOS,
+                NNEG,
+                NVERTICES,
+                NCLUSTERS,
+                E1,
+                E2,
+                ESUM,
+                NPARTICLES,
+                NMCPARTICLES,
+                NVARIABLES
+            };
+
+        public:
+
+            EventSkim(EventIndex* index, int nThreads);
+
+            virtual ~EventSkim();
+
+            /**
+             * Skip collections with these names or types when filling the variables.
+             */
+            void setExcludedCollections(const std::set<std::string>& names,
+                                        const std::set<std::string>& types);
+
+            /**
+             * Start a scan of all events in the index with a selection, stopping
+             * the one that is running.
+             */
+            void start(CutTable::CutFunction selection);
+
+            /**
+             * Stop the scan and forget the passing events.
+             */
+            void clear();
+
+            /**
+             * Whether a selection was started, even if it is still running.
+             */
+            bool isActive();
+
+            bool isFinished();
+
+            int getNumberOfScanned();
+
+            int getNumberOfPassed();
+
+            /**
+             * Get the first passing event after i or -1 if there is none (yet).
+             */
+            int next(int i);
+
+            /**
+             * Get the last passing event before i or -1 if there is none (yet).
+             */
+            int previous(int i);
+
+            static const char* getVariableName(Variable variable);
+
+            static std::vector<std::string> getVariableNames();
+
+        private:
+
+            struct Chunk {
+                int first;
+                int last;
+            };
+
+            struct Worker {
+                IO::LCReader* reader{nullptr};
+                int file{-1};
+                // Event the reader reads next without going to it first
+                int next{-1};
+                // Chunks of the worker, [firstChunk, endChunk)
+                size_t firstChunk{0};
+                size_t endChunk{0};
+            };
+
+            /**
+             * Stop the workers and close their readers.
+             */
+            void stop();
+
+            /**
+             * Split the events of the index into chunks and give each worker a
+             * range of them with about the same number of bytes.
+             */
+            void split();
+
+            /**
+             * Get the bytes of the records of event i, or 0 if they are not known.
+             */
+            long long getEventBytes(int i);
+
+            /**
+             * Scan the chunks of a worker until the scan is stopped.
+             */
+            void work(Worker& worker);
+
+            void scan(Worker& worker, const Chunk& chunk, CutTable::CutFunction selection);
+
+            /**
+             * Read event i with the reader of a worker, going to it by its number
+             * unless it is the event after the one read before.
+             */
+            EVENT::LCEvent* read(Worker& worker, int i);
+
+            /**
+             * Fill the variables of an event from its collections.
+             */
+            void fill(EVENT::LCEvent* event, double* values);
+
+        private:
+
+            EventIndex* index_;
+
+            std::set<std::string> excludeCollectionNames_;
+            std::set<std::string> excludeCollectionTypes_;
+
+            std::vector<Chunk> chunks_;
+            std::vector<Worker> workers_;
+            ThreadPool* pool_{nullptr};
+
+            // Set on the GUI thread and read by the read ahead, guarded by the mutex
+            CutTable::CutFunction selection_{nullptr};
+
+            std::atomic<int> running_{0};
+            std::atomic<int> scanned_{0};
+            std::atomic<bool> stop_{false};
+
+            // Passing events by ordinal position, guarded by the mutex
+            std::set<int> passed_;
+            std::mutex mutex_;
+    };
+}
+
+#endif
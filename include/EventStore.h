@@ -0,0 +1,229 @@
+#ifndef HPS_EVENTSTORE_H_
+#define HPS_EVENTSTORE_H_ 1
+
+// LCIO
+#include "EVENT/LCEvent.h"
+#include "EVENT/LCObject.h"
+
+// C++ standard library
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace EVENT {
+    class CalorimeterHit;
+    class Cluster;
+    class Track;
+    class Vertex;
+}
+
+namespace hps {
+
+    /**
+     * Compact copy of the objects of an LCIO event that are drawn, with one
+     * contiguous array per variable of each type.
+     *
+     * Each collection is decoded in a single pass over its LCIO objects, after
+     * which the builders, their cut tables and the titles of picked elements
+     * only use the store. It stays valid when the reader deletes the LCIO event,
+     * so cached scenes keep the store instead of the LCIO objects.
+     *
+     * Positions are in cm and momenta in GeV. Objects refer to each other by
+     * their index in the arrays of their type, or -1 if there is none.
+     */
+    class EventStore {
+
+        public:
+
+            /** Objects of a collection, which are [begin, end) in the arrays of its type */
+            struct Collection {
+                std::string name;
+                std::string typeName;
+                int begin{0};
+                int end{0};
+
+                // Range of the energies of the objects, if they have one
+                float minEnergy{0.f};
+                float maxEnergy{0.f};
+
+                int size() const {
+                    return end - begin;
+                }
+            };
+
+            /** Three components per object, e.g. positions or momenta */
+            struct Vectors {
+                std::vector<float> x;
+                std::vector<float> y;
+                std::vector<float> z;
+
+                template <typename T>
+                void add(const T* v, float scale = 1.f) {
+                    x.push_back(v[0] * scale);
+                    y.push_back(v[1] * scale);
+                    z.push_back(v[2] * scale);
+                }
+
+                size_t bytes() const {
+                    return (x.capacity() + y.capacity() + z.capacity()) * sizeof(float);
+                }
+            };
+
+            struct SimTrackerHits {
+                Vectors position;
+                std::vector<float> time;
+                std::vector<float> edep;
+            };
+
+            /** Simulated hits and the hits of clusters, of which only the former have contributions */
+            struct CalorimeterHits {
+                Vectors position;
+                std::vector<float> energy;
+                std::vector<float> time;
+                std::vector<long long> cellID;
+                std::vector<int> contributions;
+            };
+
+            struct MCParticles {
+                Vectors vertex;
+                Vectors endpoint;
+                Vectors momentum;
+                std::vector<float> charge;
+                std::vector<float> energy;
+                std::vector<float> time;
+                std::vector<int> pdg;
+                std::vector<int> parent;
+            };
+
+            /** Clusters, whose hits are [firstHit, firstHit + nHits) in the cluster hits */
+            struct Clusters {
+                Vectors position;
+                std::vector<float> energy;
+                std::vector<int> firstHit;
+                std::vector<int> nHits;
+            };
+
+            /** Track states with their parameters in LCIO units, i.e. mm */
+            struct TrackStates {
+                std::vector<float> d0;
+                std::vector<float> phi;
+                std::vector<float> omega;
+                std::vector<float> z0;
+                std::vector<float> tanLambda;
+                Vectors referencePoint;
+            };
+
+            /**
+             * Tracks, whose states are [firstState, firstState + nStates) in the
+             * track states, where ipState is the one at the IP or else the first.
+             */
+            struct Tracks {
+                Vectors referencePoint;
+                std::vector<float> chi2;
+                std::vector<int> nHits;
+                std::vector<int> firstState;
+                std::vector<int> nStates;
+                std::vector<int> ipState;
+            };
+
+            struct Vertices {
+                Vectors position;
+                std::vector<float> chi2;
+                std::vector<float> probability;
+            };
+
+            /**
+             * Reconstructed particles, starting at their start vertex or else at
+             * their reference point. Their tracks and clusters are indices in the
+             * lists of particle tracks and clusters.
+             */
+            struct ReconstructedParticles {
+                Vectors start;
+                Vectors momentum;
+                std::vector<float> charge;
+                std::vector<float> energy;
+                std::vector<int> pdg;
+                std::vector<int> startVertex;
+                std::vector<int> endVertex;
+                std::vector<int> firstTrack;
+                std::vector<int> nTracks;
+                std::vector<int> firstCluster;
+                std::vector<int> nClusters;
+            };
+
+        public:
+
+            /**
+             * Decode the collections of the supported types in an event, except
+             * the ones with excluded names or types.
+             */
+            void decode(EVENT::LCEvent* event,
+                        const std::set<std::string>& excludeNames = std::set<std::string>(),
+                        const std::set<std::string>& excludeTypes = std::set<std::string>());
+
+            /**
+             * Get the decoded collections in the order of the event.
+             */
+            const std::vector<Collection>& getCollections() const;
+
+            /**
+             * Approximate number of bytes used by the arrays of the store.
+             */
+            size_t getSize() const;
+
+        public:
+
+            SimTrackerHits simTrackerHits;
+            CalorimeterHits simCalorimeterHits;
+            CalorimeterHits clusterHits;
+            MCParticles mcParticles;
+            Clusters clusters;
+            TrackStates trackStates;
+            Tracks tracks;
+            Vertices vertices;
+            ReconstructedParticles particles;
+
+            // Indices of the tracks and clusters of reconstructed particles
+            std::vector<int> particleTracks;
+            std::vector<int> particleClusters;
+
+        private:
+
+            typedef std::unordered_map<const EVENT::LCObject*, int> IndexMap;
+
+            void decodeCollection(EVENT::LCCollection* collection, Collection& decoded);
+
+            void decodeSimTrackerHits(EVENT::LCCollection* collection, Collection& decoded);
+
+            void decodeSimCalorimeterHits(EVENT::LCCollection* collection, Collection& decoded);
+
+            void decodeMCParticles(EVENT::LCCollection* collection, Collection& decoded);
+
+            void decodeReconstructedParticles(EVENT::LCCollection* collection, Collection& decoded);
+
+            /**
+             * Add an object and return its index. With reuse, an object that was
+             * added before, e.g. by its collection, is not added again. Objects of
+             * a collection are always added, because subset collections share them.
+             */
+            int addCluster(EVENT::Cluster* cluster, bool reuse = false);
+
+            int addTrack(EVENT::Track* track, bool reuse = false);
+
+            int addVertex(EVENT::Vertex* vertex, bool reuse = false);
+
+            void addCalorimeterHit(CalorimeterHits& hits, EVENT::CalorimeterHit* hit);
+
+        private:
+
+            std::vector<Collection> collections_;
+
+            // Indices of the objects that can be shared, which are only used while decoding
+            IndexMap clusterIndices_;
+            IndexMap trackIndices_;
+            IndexMap vertexIndices_;
+    };
+}
+
+#endif
@@ -5,38 +5,109 @@
 #include "Logger.h"
 
 // C++ standard library
+#include <atomic>
+#include <future>
+#include <map>
+#include <mutex>
 #include <string>
-
-#ifdef HAVE_CURL
-
-static size_t _write_data(void *ptr, size_t size, size_t nmemb, void *stream);
-
-static void _download(const char* url, const char* filename);
-
-#endif
+#include <thread>
+#include <vector>
 
 namespace hps {
 
+    /**
+     * Directory of files that are downloaded once and reused, e.g. detector
+     * descriptions, and of files written by the display, e.g. the event index.
+     *
+     * Downloaded files are fetched on a background thread into a partial file,
+     * which is resumed if it was interrupted and renamed into place once it is
+     * complete. Their size, hash and HTTP validators are kept next to them, so
+     * that a truncated or changed file is fetched again.
+     */
     class FileCache : public Logger {
 
         public:
 
             FileCache(std::string cacheDir);
 
+            /**
+             * Abort the fetches that are running and wait for their threads.
+             */
             virtual ~FileCache();
 
             void createCacheDir();
 
+            /**
+             * Whether a file is in the cache, with the size it was fetched with
+             * if it was fetched.
+             */
             bool isCached(const std::string& fileName);
 
             std::string getCachedPath(const std::string& fileName);
 
+            /**
+             * Fetch a file into the cache, waiting until it is complete.
+             */
             void cache(const char* url, const char* outfile);
 
+            /**
+             * Fetch a file into the cache on a background thread from a URL,
+             * a file:// URL or a local path, e.g. of a mirror. If the file is
+             * cached already, the future is ready at once and the file is only
+             * revalidated in the background. A changed file is kept next to
+             * the cached one, which it replaces at the next fetch of a later
+             * launch, so a file is not replaced while it is used. A file is
+             * fetched at most once by the same cache.
+             */
+            std::shared_future<void> fetch(const std::string& url, const std::string& fileName);
+
+            /**
+             * Hash of the contents of a file.
+             */
+            static std::string hashFile(const std::string& path);
+
+        private:
+
+            /** Size, hash and HTTP validators of a fetched file */
+            struct Metadata {
+                long long size{-1};
+                std::string hash;
+                std::string etag;
+                std::string lastModified;
+            };
+
+            /**
+             * Replace a cached file with the changed version that was fetched
+             * when it was revalidated, unless another process is fetching it.
+             */
+            void promote(const std::string& fileName);
+
+            /**
+             * Fetch a file, or only revalidate it if it is cached. A changed file
+             * that is in use is kept to replace the cached one at the next launch.
+             */
+            void download(const std::string& url, const std::string& fileName, bool inUse);
+
+            /**
+             * Rename a complete partial file into place, or next to the cached
+             * file to replace it later, and save its metadata.
+             */
+            void commit(const std::string& fileName, Metadata& metadata, bool next);
+
+            bool readMetadata(const std::string& path, Metadata& metadata);
+
+            void writeMetadata(const std::string& path, const Metadata& metadata);
+
         private:
 
             std::string cacheDir_;
 
+            // Fetches of this cache by file name
+            std::map<std::string, std::shared_future<void>> fetches_;
+            std::vector<std::thread> threads_;
+            std::mutex mutex_;
+
+            std::atomic<bool> abort_{false};
     };
 }
 
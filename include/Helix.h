@@ -0,0 +1,81 @@
+#ifndef HPS_HELIX_H_
+#define HPS_HELIX_H_ 1
+
+// HPS
+#include "EventStore.h"
+
+// ROOT
+#include "TVector3.h"
+
+namespace hps {
+
+    /**
+     * Helix of a track state in a constant field, which is evaluated in
+     * closed form instead of being stepped through the field.
+     *
+     * The path length is measured in the bending plane from the point of
+     * closest approach to the reference point of the track state. Positions
+     * are in cm in the detector frame, where the field points along Y.
+     */
+    class Helix {
+
+        public:
+
+            /**
+             * Create the helix of track state i of an event store.
+             */
+            Helix(const EventStore::TrackStates& states, int i);
+
+            /**
+             * Get the position at a path length in cm.
+             */
+            TVector3 getPosition(double s) const;
+
+            /**
+             * Get the path length in cm at which the helix comes closest to a
+             * point in the bending plane, within half a turn of the start.
+             */
+            double getPathLength(const TVector3& point) const;
+
+            /**
+             * Get the longest path length in cm over which the chord deviates
+             * less than the tolerance in cm from the helix.
+             */
+            double getStep(double tolerance) const;
+
+            /**
+             * Get the path length in cm at which the helix leaves the cylinder
+             * of the given radius and half length around the beam axis, which is
+             * at most maxLength.
+             */
+            double getExitPathLength(double maxR, double maxZ, double maxLength, double tolerance) const;
+
+            /**
+             * Get the path length in cm of one full turn, or zero for a line.
+             */
+            double getTurnLength() const;
+
+        private:
+
+            bool isLine() const;
+
+            bool isInside(double s, double maxR, double maxZ) const;
+
+        private:
+
+            // Point of closest approach in cm in the tracking frame, where the
+            // field points along w and the beam along u
+            double u0_;
+            double v0_;
+            double w0_;
+
+            double phi0_;
+
+            // Signed curvature in 1/cm
+            double omega_;
+
+            double tanLambda_;
+    };
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef HPS_HELIXTRACK_H_
+#define HPS_HELIXTRACK_H_ 1
+
+// HPS
+#include "Helix.h"
+#include "LCObjectElement.h"
+
+// ROOT
+#include "TEveTrack.h"
+
+// C++ standard library
+#include <vector>
+
+namespace hps {
+
+    /**
+     * Track drawn as helix segments between its stored track states.
+     *
+     * The points are computed in closed form when the track is made, so the
+     * propagator is only used for the bounds of a track that has a single
+     * segment without an end.
+     */
+    class HelixTrack : public LCObjectElement<TEveTrack> {
+
+        public:
+
+            HelixTrack(TEveRecTrack* recTrack, TEveTrackPropagator* propagator);
+
+            virtual ~HelixTrack();
+
+            /**
+             * Add a segment from the start of the helix to a path length in cm.
+             */
+            void addSegment(const Helix& helix, double length);
+
+            /**
+             * Add a segment from the start of the helix to where it leaves the
+             * bounds of the propagator.
+             */
+            void addOpenSegment(const Helix& helix);
+
+            /**
+             * Set the largest distance in cm between the drawn line and the helix.
+             */
+            void setTolerance(double tolerance);
+
+            virtual void MakeTrack(Bool_t recurse = kTRUE);
+
+        private:
+
+            struct Segment {
+                Helix helix;
+                double length;
+                bool open;
+            };
+
+            void addPoints(const Helix& helix, double length);
+
+        private:
+
+            std::vector<Segment> segments_;
+
+            double tolerance_{0.01};
+    };
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef HPS_LCBOXSET_H_
+#define HPS_LCBOXSET_H_ 1
+
+// HPS
+#include "DeferredStamp.h"
+#include "LCObjectUserData.h"
+
+// ROOT
+#include "TEveBoxSet.h"
+
+namespace hps {
+
+    /**
+     * Box set drawing a whole LCIO collection with one box per object, e.g.
+     * the ECAL crystals of calorimeter hits, each with its own color.
+     *
+     * The index of each box refers to its object in the event store, which is
+     * used for the tooltip of the box under the mouse and when a box is picked.
+     */
+    class LCBoxSet : public DeferredStamp<TEveBoxSet> {
+
+        public:
+
+            LCBoxSet(const char* name, std::shared_ptr<const EventStore> store,
+                     LCObjectListUserData::TitleFunction titleFunction);
+
+            virtual ~LCBoxSet();
+
+            /**
+             * Add a box from its 8 corners in global coordinates for the object
+             * at an index in the store.
+             */
+            void addBox(int index, const Float_t* vertices, Color_t color);
+
+            LCObjectListUserData* getObjects();
+
+            int getNumberOfBoxes();
+
+            /**
+             * Get the 8 corners and the RGBA color of box i.
+             */
+            void getBox(int i, Float_t* vertices, UChar_t* rgba);
+
+            virtual void DigitSelected(Int_t idx);
+
+        private:
+
+            static TString tooltip(TEveDigitSet* digits, Int_t idx);
+    };
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef HPS_LCOBJECTELEMENT_H_
+#define HPS_LCOBJECTELEMENT_H_ 1
+
+// HPS
+#include "DeferredStamp.h"
+#include "LCObjectUserData.h"
+
+namespace hps {
+
+    /**
+     * Eve element drawing one object decoded from LCIO, which owns its user data.
+     *
+     * Eve does not delete the user data of an element, which holds the event
+     * store, so it is deleted with the element like that of point and box sets.
+     */
+    template<class T>
+    class LCObjectElement : public DeferredStamp<T> {
+
+        public:
+
+            using DeferredStamp<T>::DeferredStamp;
+
+            virtual ~LCObjectElement() {
+                delete getObject();
+            }
+
+            LCObjectUserData* getObject() {
+                return static_cast<LCObjectUserData*>(this->GetUserData());
+            }
+    };
+}
+
+#endif
@@ -1,32 +1,65 @@
 #ifndef HPS_LCOBJECTUSERDATA_H_
 #define HPS_LCOBJECTUSERDATA_H_ 1
 
-#include "EVENT/LCObject.h"
-#include "EVENT/MCParticle.h"
+// HPS
+#include "EventStore.h"
 
-using EVENT::LCObject;
-using EVENT::MCParticle;
+// ROOT
+#include "TString.h"
+
+// C++ standard library
+#include <memory>
+#include <vector>
 
 namespace hps {
 
+    /**
+     * User data of an element drawing an object decoded from LCIO, which is
+     * referred to by its index in the event store.
+     *
+     * The store is shared by the elements of an event, so it stays alive as
+     * long as they do, e.g. in the scene cache after the reader deleted the
+     * LCIO event.
+     */
     class LCObjectUserData {
 
         public:
 
-            LCObjectUserData(LCObject* object) : object_(object) {
+            typedef TString (*TitleFunction)(const EventStore& store, int index);
+
+            LCObjectUserData(std::shared_ptr<const EventStore> store, int index,
+                             TitleFunction titleFunction = nullptr) :
+                store_(store), index_(index), titleFunction_(titleFunction) {
+            }
+
+            virtual ~LCObjectUserData() {
             }
 
-            ~LCObjectUserData() {
+            /**
+             * Get the index of the object in the arrays of its type in the store.
+             */
+            inline int getIndex() {
+                return index_;
             }
 
-            inline LCObject* getLCObject() {
-                return object_;
+            /**
+             * Get the title of the element from its object, which is created on
+             * demand when the element is highlighted or picked.
+             */
+            virtual TString getTitle() {
+                if (index_ >= 0 && titleFunction_ != nullptr) {
+                    return titleFunction_(*store_, index_);
+                }
+                return TString();
             }
 
         protected:
 
-            LCObject* object_;
+            std::shared_ptr<const EventStore> store_;
 
+            int index_;
+
+            TitleFunction titleFunction_;
     };
 
 
@@ -34,18 +67,67 @@ namespace hps {
 
         public:
 
-            TrackUserData(LCObject* object, double p) :
-                LCObjectUserData(object), p_(p) {
+            TrackUserData(std::shared_ptr<const EventStore> store, int index, double p, double chi2 = 0.,
+                          TitleFunction titleFunction = nullptr) :
+                LCObjectUserData(store, index, titleFunction), p_(p), chi2_(chi2) {
             }
 
             double p() {
                 return p_;
             }
 
+            double chi2() {
+                return chi2_;
+            }
+
         private:
 
             double p_{0.};
 
+            double chi2_{0.};
+
+    };
+
+    /**
+     * User data of an element drawing many objects, e.g. one point per hit,
+     * which creates the title of each object on demand.
+     */
+    class LCObjectListUserData : public LCObjectUserData {
+
+        public:
+
+            LCObjectListUserData(std::shared_ptr<const EventStore> store, TitleFunction titleFunction) :
+                LCObjectUserData(store, -1, titleFunction) {
+            }
+
+            using LCObjectUserData::getIndex;
+            using LCObjectUserData::getTitle;
+
+            void add(int index) {
+                indices_.push_back(index);
+            }
+
+            int size() {
+                return indices_.size();
+            }
+
+            /**
+             * Get the index in the store of the object at index i, or -1 if there is none.
+             */
+            int getIndex(int i) {
+                return i >= 0 && i < (int) indices_.size() ? indices_[i] : -1;
+            }
+
+            TString getTitle(int i) {
+                if (i < 0 || i >= (int) indices_.size() || titleFunction_ == nullptr) {
+                    return TString();
+                }
+                return titleFunction_(*store_, indices_[i]);
+            }
+
+        private:
+
+            std::vector<int> indices_;
     };
 
 }
@@ -0,0 +1,43 @@
+#ifndef HPS_LCPOINTSET_H_
+#define HPS_LCPOINTSET_H_ 1
+
+// HPS
+#include "DeferredStamp.h"
+#include "LCObjectUserData.h"
+
+// ROOT
+#include "TEvePointSet.h"
+
+namespace hps {
+
+    /**
+     * Point set drawing a whole LCIO collection with one point per object.
+     *
+     * The index of each point refers to its object in the event store, so
+     * picking a point sets the title of the set to the description of that object.
+     *
+     * Unlike digit sets, the GL renderer of point sets does not select single
+     * points under the mouse, so hovering shows the title of the last picked
+     * point rather than the one under the mouse.
+     */
+    class LCPointSet : public DeferredStamp<TEvePointSet> {
+
+        public:
+
+            LCPointSet(const char* name, Int_t nPoints, std::shared_ptr<const EventStore> store,
+                       LCObjectListUserData::TitleFunction titleFunction);
+
+            virtual ~LCPointSet();
+
+            /**
+             * Add a point for the object at an index in the store.
+             */
+            void addPoint(int index, Float_t x, Float_t y, Float_t z);
+
+            LCObjectListUserData* getObjects();
+
+            virtual void PointSelected(Int_t id);
+    };
+}
+
+#endif
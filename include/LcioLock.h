@@ -0,0 +1,59 @@
+#ifndef HPS_LCIOLOCK_H_
+#define HPS_LCIOLOCK_H_ 1
+
+// LCIO
+#include "lcio.h"
+
+// C++ standard library
+#include <mutex>
+
+namespace hps {
+
+    /**
+     * Scoped lock that must be held around every call into an LCIO reader
+     * when readers are used from more than one thread.
+     *
+     * The SIO layer of LCIO releases before 2.13 keeps global stream and
+     * record managers, so independent readers still share state. For newer
+     * releases the lock does nothing.
+     */
+    class LcioLock {
+
+        public:
+
+            LcioLock() {
+                if (isRequired()) {
+                    mutex().lock();
+                }
+            }
+
+            ~LcioLock() {
+                if (isRequired()) {
+                    mutex().unlock();
+                }
+            }
+
+            /**
+             * True if calls into LCIO readers need to be serialized.
+             */
+            static bool isRequired() {
+#if defined(LCIO_VERSION_GE)
+                return !LCIO_VERSION_GE(2, 13);
+#else
+                return true;
+#endif
+            }
+
+        private:
+
+            LcioLock(const LcioLock&);
+            LcioLock& operator=(const LcioLock&);
+
+            static std::mutex& mutex() {
+                static std::mutex m;
+                return m;
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef HPS_LOGSINK_H_
+#define HPS_LOGSINK_H_ 1
+
+// C++ standard library
+#include <iosfwd>
+#include <string>
+
+namespace hps {
+
+    /**
+     * Writes log messages from a background thread, so that logging from the
+     * GUI thread or a builder does not wait on the terminal.
+     *
+     * Messages are pushed to a lock-free queue from any thread and written in
+     * the order they were pushed. The writer is started with the first message,
+     * and the queue is drained when the program exits.
+     */
+    class LogSink {
+
+        public:
+
+            /**
+             * Queue text to be written to a stream.
+             */
+            static void write(std::ostream* stream, std::string text);
+
+            /**
+             * Have the messages queued so far written and their streams flushed,
+             * without waiting for the writer.
+             */
+            static void flush();
+
+            /**
+             * Wait until the messages queued so far are written and their streams
+             * flushed, e.g. when the program exits or before a fatal error.
+             */
+            static void drain();
+    };
+}
+
+#endif
@@ -5,9 +5,29 @@
 #include <iostream>
 #include <fstream>
 #include <map>
+#include <memory>
+#include <sstream>
 
 #include "TObject.h"
 
+#include "LogSink.h"
+
+/**
+ * Most verbose level of messages logged with HPS_LOG, so that more verbose
+ * ones are compiled out, e.g. with -DHPS_LOG_MAX_LEVEL=3 for INFO.
+ */
+#ifndef HPS_LOG_MAX_LEVEL
+#define HPS_LOG_MAX_LEVEL 6
+#endif
+
+/**
+ * Log a message from a member of a Logger, e.g.
+ * HPS_LOG(FINEST) << "Hit at: " << x << std::endl, where the message is not
+ * evaluated at all if the level is not logged.
+ */
+#define HPS_LOG(level) \
+    if ((level) > HPS_LOG_MAX_LEVEL || !isLogEnabled(level)) {} else log(level)
+
 namespace hps {
 
     static const int OFF = 0;
@@ -43,20 +63,21 @@ namespace hps {
                 return logErr_;
             }
 
-            static LogHandler* getDefault() {
-                if (HANDLERS_.find(DEFAULT) == HANDLERS_.end()) {
-                    HANDLERS_[DEFAULT] = new LogHandler(DEFAULT);
-                }
-                return HANDLERS_[DEFAULT];
-            }
+            static LogHandler* getDefault();
 
+            /**
+             * Have the messages logged so far written soon, without waiting.
+             */
             static void flushAll() {
-                for (LogHandlerMapIter it = HANDLERS_.begin();
-                        it != HANDLERS_.end();
-                        it++) {
-                    it->second->getOutputStream()->flush();
-                    it->second->getErrorStream()->flush();
-                }
+                LogSink::flush();
+            }
+
+            /**
+             * Wait until the messages logged so far are written, e.g. before
+             * a fatal error.
+             */
+            static void drainAll() {
+                LogSink::drain();
             }
 
         private:
@@ -70,6 +91,61 @@ namespace hps {
             static LogHandlerMap HANDLERS_;
     };
 
+    /**
+     * Message that is queued to the log sink once it is complete, or nothing
+     * if its level is not logged.
+     */
+    class LogMessage {
+
+        public:
+
+            LogMessage(std::ostream* stream = nullptr) : stream_(stream) {
+                if (stream_ != nullptr) {
+                    out_.reset(new std::ostringstream);
+                }
+            }
+
+            LogMessage(LogMessage&& msg) :
+                    stream_(msg.stream_),
+                    out_(std::move(msg.out_)) {
+            }
+
+            ~LogMessage() {
+                if (out_) {
+                    LogSink::write(stream_, out_->str());
+                }
+            }
+
+            template<typename T> LogMessage& operator<<(const T& value) {
+                if (out_) {
+                    (*out_) << value;
+                }
+                return *this;
+            }
+
+            LogMessage& operator<<(std::ostream& (*manip)(std::ostream&)) {
+                if (out_) {
+                    manip(*out_);
+                }
+                return *this;
+            }
+
+            LogMessage& operator<<(std::ios_base& (*manip)(std::ios_base&)) {
+                if (out_) {
+                    manip(*out_);
+                }
+                return *this;
+            }
+
+        private:
+
+            LogMessage(const LogMessage&);
+            LogMessage& operator=(const LogMessage&);
+
+            std::ostream* stream_;
+            std::unique_ptr<std::ostringstream> out_;
+    };
+
     class Logger {
 
         public:
@@ -93,30 +169,27 @@ namespace hps {
                 log(level) << msg << std::endl;
             }
 
-            inline std::ostream& log(int level = INFO) {
-                std::ostream* logMsg = handler_->getOutputStream();
-                if (level < INFO) {
-                    logMsg = handler_->getErrorStream();
-                }
-                logMsg->flush();
-                logMsg->clear();
-                if (checkLevel(level)) {
-                    (*logMsg) << name_ << ":" << levelName(level) << " ";
-                } else {
-                    logMsg->setstate(std::ios::failbit);
+            /**
+             * Start a message, which is written by the log sink at the end
+             * of the statement. Use HPS_LOG to also skip building it when
+             * the level is not logged.
+             */
+            inline LogMessage log(int level = INFO) {
+                if (!isLogEnabled(level)) {
+                    return LogMessage();
                 }
-                return *logMsg;
+                LogMessage msg(level < INFO ? handler_->getErrorStream() : handler_->getOutputStream());
+                msg << name_ << ":" << levelName(level) << " ";
+                return msg;
             }
 
-            static Logger* getLogger(std::string& name) {
-                return LOGGERS_[name];
+            inline bool isLogEnabled(int level) const {
+                return level_ >= level;
             }
 
-        private:
+            static Logger* getLogger(std::string& name);
 
-            inline bool checkLevel(int level) {
-                return level_ >= level;
-            }
+        private:
 
             inline static const std::string& levelName(int level) {
                 static std::string off = "OFF";
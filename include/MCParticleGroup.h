@@ -0,0 +1,68 @@
+#ifndef HPS_MCPARTICLEGROUP_H_
+#define HPS_MCPARTICLEGROUP_H_ 1
+
+// HPS
+#include "LCPointSet.h"
+
+// C++ standard library
+#include <vector>
+
+namespace hps {
+
+    /**
+     * Collapsed subtrees of MCParticles below a drawn particle, or at the top
+     * of the collection, which are drawn as one point per particle at its
+     * vertex instead of as propagated tracks.
+     *
+     * Particles are kept in breadth-first order, so that a parent always comes
+     * before its daughters, and can be expanded into tracks level by level.
+     */
+    class MCParticleGroup : public LCPointSet {
+
+        public:
+
+            /**
+             * Create the group of particles at these indices in the store that
+             * hang from the drawn particle owner, or -1 for the top level, whose
+             * element is parent. Picked points are described by the title function.
+             */
+            MCParticleGroup(std::shared_ptr<const EventStore> store,
+                            int owner,
+                            TEveElement* parent,
+                            const std::vector<int>& particles,
+                            LCObjectListUserData::TitleFunction titleFunction);
+
+            virtual ~MCParticleGroup();
+
+            std::shared_ptr<const EventStore> getStore();
+
+            /**
+             * Get the index of the drawn particle the group hangs from, or -1.
+             */
+            int getOwner();
+
+            /**
+             * Get the element the group was added to.
+             */
+            TEveElement* getParent();
+
+            const std::vector<int>& getParticles();
+
+            /**
+             * Get the particles of the group whose parent is the owner.
+             */
+            std::vector<int> getRoots();
+
+        private:
+
+            std::shared_ptr<const EventStore> store_;
+
+            int owner_;
+
+            TEveElement* parent_;
+
+            std::vector<int> particles_;
+    };
+}
+
+#endif
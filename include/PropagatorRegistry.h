@@ -0,0 +1,87 @@
+#ifndef HPS_PROPAGATORREGISTRY_H_
+#define HPS_PROPAGATORREGISTRY_H_ 1
+
+// HPS
+#include "Logger.h"
+
+// ROOT
+#include "TEveTrackPropagator.h"
+
+// C++ standard library
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace hps {
+
+    /**
+     * Track propagators shared by all events, keyed by the field and the
+     * propagation settings, so that builders do not create new ones for
+     * every collection.
+     *
+     * The registry holds a reference to each propagator, which keeps it
+     * alive for the session even when no track uses it.
+     */
+    class PropagatorRegistry : public Logger {
+
+        public:
+
+            struct Settings {
+                bool charged{true};
+                double delta{0.01};
+                double maxR{150.};
+                double maxZ{200.};
+                double maxOrbs{2.};
+
+                // What tracks are fit to, which all are by default in Eve
+                bool fitDaughters{true};
+                bool fitReferences{true};
+                bool fitDecay{true};
+                bool fitCluster2Ds{true};
+                bool fitLineSegments{true};
+
+                bool operator<(const Settings& rhs) const;
+            };
+
+        public:
+
+            PropagatorRegistry(double bY);
+
+            virtual ~PropagatorRegistry();
+
+            /**
+             * Get the propagator with these settings for the current field,
+             * which is created on first use. This can be called from any thread.
+             */
+            TEveTrackPropagator* getPropagator(const Settings& settings);
+
+            /**
+             * Create a private propagator with the same settings as a registered
+             * one, e.g. to step tracks on another thread. It is not deleted when
+             * its last track lets go of it, so the caller must delete it.
+             */
+            TEveTrackPropagator* copyPropagator(TEveTrackPropagator* propagator);
+
+            /**
+             * Change the field of all propagators and propagate their
+             * tracks again in place.
+             */
+            void setMagFieldY(double bY);
+
+            double getMagFieldY();
+
+        private:
+
+            typedef std::pair<double, Settings> Key;
+
+            static TEveTrackPropagator* createPropagator(const Settings& settings, double bY);
+
+            double bY_;
+
+            std::map<Key, TEveTrackPropagator*> propagators_;
+
+            std::mutex mutex_;
+    };
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef HPS_SCENECACHE_H_
+#define HPS_SCENECACHE_H_ 1
+
+// HPS
+#include "EventObjects.h"
+#include "Logger.h"
+
+// ROOT
+#include "TEveElement.h"
+
+// C++ standard library
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace hps {
+
+    /**
+     * Memory bounded LRU cache of the Eve elements built for recently
+     * displayed events, so that going back to one of them is a scene swap.
+     *
+     * Cached elements keep the compact event store they were built from,
+     * which is counted in the size of their scene, and not the LCIO objects
+     * that the reader deletes when the next event is read.
+     */
+    class SceneCache : public Logger {
+
+        public:
+
+            /** Run and event number */
+            typedef std::pair<int, int> Key;
+
+            struct Scene {
+                std::vector<TEveElement*> elements;
+                EventObjects::TypeMap typeMap;
+                EventObjects::CutTables cutTables;
+                std::shared_ptr<const EventStore> store;
+                size_t size{0};
+            };
+
+        public:
+
+            SceneCache(size_t maxSize);
+
+            virtual ~SceneCache();
+
+            bool contains(const Key& key);
+
+            /**
+             * Add the scene to the cache, which takes ownership of it. Least
+             * recently used scenes are destroyed until it fits the limit.
+             */
+            void put(const Key& key, Scene* scene);
+
+            /**
+             * Remove a scene from the cache and give ownership back to the caller.
+             * Returns null if the scene was not cached.
+             */
+            Scene* take(const Key& key);
+
+            size_t getMaxSize();
+
+            size_t getSize();
+
+            /**
+             * Rough estimate of the memory used by an element and its children.
+             */
+            static size_t estimateSize(TEveElement* element);
+
+            /**
+             * Destroy the elements of a scene that is not in the cache.
+             */
+            static void destroy(Scene* scene);
+
+        private:
+
+            typedef std::list<std::pair<Key, Scene*>> SceneList;
+
+            size_t maxSize_;
+            size_t size_{0};
+
+            // Most recently used first.
+            SceneList scenes_;
+            std::map<Key, SceneList::iterator> index_;
+    };
+}
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef HPS_SCENEEXPORTER_H_
+#define HPS_SCENEEXPORTER_H_ 1
+
+// HPS
+#include "EventIndex.h"
+#include "Logger.h"
+
+// ROOT
+#include "TEveElement.h"
+
+// LCIO
+#include "IO/LCReader.h"
+
+// C++ standard library
+#include <atomic>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace hps {
+
+    class DetectorGeometry;
+    class EventObjects;
+    class PropagatorRegistry;
+
+    /**
+     * Builds the scenes of events without the display and writes each to a
+     * JSON file, which can be loaded by a web or offline viewer.
+     *
+     * Every worker thread reads, builds and writes whole events with its own
+     * reader, builders and propagators, taking the next event to export from
+     * a shared counter. A scene refers to the detector by name, and holds the
+     * points of tracks and hits and the corners of calorimeter boxes in cm.
+     */
+    class SceneExporter : public Logger {
+
+        public:
+
+            SceneExporter(EventIndex* index, DetectorGeometry* det, double bY, int nThreads);
+
+            virtual ~SceneExporter();
+
+            void setLogLevel(int level);
+
+            /**
+             * Skip collections with these names or types when building events.
+             */
+            void setExcludedCollections(const std::set<std::string>& names,
+                                        const std::set<std::string>& types);
+
+            /**
+             * Set the limits of the MCParticles drawn as tracks (see EventObjects::setMCDetail).
+             */
+            void setMCDetail(double minEnergy, int maxDepth, int maxParticles);
+
+            /**
+             * Export the events at these ordinal positions to the directory, which
+             * is created if needed. Returns the number of scenes that were written.
+             */
+            int run(const std::vector<int>& events, const std::string& outputDir);
+
+            /**
+             * Write a scene from the element lists of its collections with their LCIO types.
+             */
+            static void writeScene(std::ostream& out,
+                                   const EventIndex::Entry& entry,
+                                   const std::string& detectorName,
+                                   const std::vector<TEveElementList*>& elementLists,
+                                   const std::vector<std::string>& typeNames);
+
+            /**
+             * Destroy the elements of a scene that were built without the Eve manager.
+             */
+            static void destroy(TEveElement* element);
+
+        private:
+
+            struct Worker {
+                IO::LCReader* reader{nullptr};
+                int file{-1};
+                PropagatorRegistry* propagators{nullptr};
+                EventObjects* builder{nullptr};
+            };
+
+            /**
+             * Export events until there are none left.
+             */
+            void work(Worker& worker, const std::vector<int>& events, const std::string& outputDir);
+
+            EVENT::LCEvent* read(Worker& worker, int i);
+
+            static void writeElement(std::ostream& out, TEveElement* element);
+
+            static void writePoints(std::ostream& out, const Float_t* points, int n);
+
+            static void writeColor(std::ostream& out, const UChar_t* rgba);
+
+            static void writeString(std::ostream& out, const std::string& str);
+
+        private:
+
+            EventIndex* index_;
+
+            std::string detectorName_;
+
+            std::vector<Worker> workers_;
+
+            std::atomic<size_t> next_{0};
+            std::atomic<int> written_{0};
+    };
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef HPS_STAGETIMER_H_
+#define HPS_STAGETIMER_H_ 1
+
+// C++ standard library
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace hps {
+
+    /**
+     * Timings of the stages of showing an event, e.g. reading, building a type
+     * or redrawing, and the number of objects per collection of the last event.
+     *
+     * Stages are recorded from any thread, but only while timing is enabled,
+     * so that a disabled span costs one load of a flag.
+     */
+    class StageTimer {
+
+        public:
+
+            /** Statistics of the recorded durations of a stage in seconds */
+            struct Stats {
+                double last{0.};
+                double mean{0.};
+                double p95{0.};
+                int count{0};
+            };
+
+            /**
+             * Time the scope of a span as a stage, optionally with the name of
+             * what was processed, e.g. the LCIO type of a builder.
+             */
+            class Span {
+
+                public:
+
+                    Span(const char* stage, const std::string* name = nullptr) :
+                            enabled_(isEnabled()) {
+                        if (enabled_) {
+                            stage_ = stage;
+                            name_ = name;
+                            start_ = std::chrono::steady_clock::now();
+                        }
+                    }
+
+                    ~Span() {
+                        if (enabled_) {
+                            double seconds = std::chrono::duration<double>(
+                                    std::chrono::steady_clock::now() - start_).count();
+                            record(name_ != nullptr ? std::string(stage_) + " " + *name_ : stage_, seconds);
+                        }
+                    }
+
+                private:
+
+                    Span(const Span&);
+                    Span& operator=(const Span&);
+
+                    bool enabled_;
+                    const char* stage_{nullptr};
+                    const std::string* name_{nullptr};
+                    std::chrono::steady_clock::time_point start_;
+            };
+
+        public:
+
+            static void setEnabled(bool enabled);
+
+            static bool isEnabled() {
+                return enabled_.load(std::memory_order_relaxed);
+            }
+
+            static void record(const std::string& stage, double seconds);
+
+            /**
+             * Set the number of objects in a collection of the current event.
+             */
+            static void setCount(const std::string& collection, int count);
+
+            /**
+             * Forget the counts of the collections of the previous event.
+             */
+            static void clearCounts();
+
+            /**
+             * Forget all timings and counts.
+             */
+            static void clear();
+
+            /**
+             * Get the statistics of the stages in the order they were first recorded.
+             */
+            static std::vector<std::pair<std::string, Stats>> getStats();
+
+            static std::vector<std::pair<std::string, int>> getCounts();
+
+        private:
+
+            static std::atomic<bool> enabled_;
+    };
+}
+
+#endif
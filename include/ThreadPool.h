@@ -0,0 +1,60 @@
+#ifndef HPS_THREADPOOL_H_
+#define HPS_THREADPOOL_H_ 1
+
+// HPS
+#include "Logger.h"
+
+// C++ standard library
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hps {
+
+    /**
+     * Fixed set of worker threads running tasks in the order they were submitted.
+     */
+    class ThreadPool : public Logger {
+
+        public:
+
+            ThreadPool(int nThreads);
+
+            /**
+             * Finish the queued tasks and join the workers.
+             */
+            virtual ~ThreadPool();
+
+            /**
+             * Queue a task, whose future rethrows any exception of the task.
+             */
+            std::future<void> submit(const std::function<void()>& task);
+
+            int getNumberOfThreads();
+
+            /**
+             * Whether the calling thread is a worker of any pool.
+             */
+            static bool isWorkerThread();
+
+        private:
+
+            void run();
+
+        private:
+
+            std::vector<std::thread> threads_;
+
+            std::deque<std::packaged_task<void()>> tasks_;
+
+            std::mutex mutex_;
+            std::condition_variable cond_;
+            bool stop_{false};
+    };
+}
+
+#endif
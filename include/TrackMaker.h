@@ -0,0 +1,89 @@
+#ifndef HPS_TRACKMAKER_H_
+#define HPS_TRACKMAKER_H_ 1
+
+// HPS
+#include "Logger.h"
+
+// ROOT
+#include "TEveTrack.h"
+#include "TEveTrackPropagator.h"
+
+// C++ standard library
+#include <mutex>
+#include <vector>
+
+namespace hps {
+
+    class PropagatorRegistry;
+    class ThreadPool;
+
+    /**
+     * Makes the points of queued tracks, split over the workers of a pool
+     * when there are enough of them.
+     *
+     * Propagators keep the state of the track being stepped, so every task
+     * steps its tracks with its own copies of the shared propagators. Once
+     * all tasks are done the shared propagators are set on the tracks again
+     * on the calling thread.
+     */
+    class TrackMaker : public Logger {
+
+        public:
+
+            TrackMaker(PropagatorRegistry* propagators, ThreadPool* pool = nullptr);
+
+            virtual ~TrackMaker();
+
+            /**
+             * Queue a track with the shared propagator to make it with, which
+             * can be called from any thread. Children of the track are not made.
+             */
+            void addTrack(TEveTrack* track, TEveTrackPropagator* propagator);
+
+            /**
+             * Make the points of the first maxTracks queued tracks, or of all if 0,
+             * and remove them from the queue. Tracks may be queued meanwhile.
+             */
+            void makeTracks(size_t maxTracks = 0);
+
+            /**
+             * Drop the queued tracks without making them, e.g. when their
+             * elements are destroyed before they were drawn.
+             */
+            void clear();
+
+            int getNumberOfTracks();
+
+            /**
+             * Set the smallest number of tracks worth a task of their own.
+             */
+            void setMinTracksPerTask(int minTracksPerTask);
+
+        private:
+
+            struct PendingTrack {
+                TEveTrack* track{nullptr};
+                TEveTrackPropagator* propagator{nullptr};
+            };
+
+            /**
+             * Make a range of tracks with private propagators, which are added
+             * to the copies.
+             */
+            void makeTracks(std::vector<PendingTrack>& tracks, size_t begin, size_t end,
+                            std::vector<TEveTrackPropagator*>& copies);
+
+        private:
+
+            PropagatorRegistry* propagators_;
+
+            ThreadPool* pool_;
+
+            int minTracksPerTask_{64};
+
+            std::vector<PendingTrack> pending_;
+            std::mutex mutex_;
+    };
+}
+
+#endif
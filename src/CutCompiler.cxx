@@ -0,0 +1,77 @@
+#include "CutCompiler.h"
+
+// ROOT
+#include "TInterpreter.h"
+
+// C++ standard library
+#include <sstream>
+
+namespace hps {
+
+    CutCompiler::CutCompiler() : Logger("CutCompiler") {
+    }
+
+    CutCompiler::~CutCompiler() {
+    }
+
+    CutTable::CutFunction CutCompiler::compile(const std::string& expression) {
+        std::vector<std::string> variables;
+        for (int c = 0; c < CutTable::NCOLUMNS; c++) {
+            variables.push_back(CutTable::getColumnName((CutTable::Column) c));
+        }
+        return compile(expression, variables);
+    }
+
+    CutTable::CutFunction CutCompiler::compile(const std::string& expression,
+                                               const std::vector<std::string>& variables) {
+        std::stringstream key;
+        for (size_t c = 0; c < variables.size(); c++) {
+            key << variables[c] << ",";
+        }
+        key << expression;
+        std::map<std::string, CutTable::CutFunction>::iterator it = functions_.find(key.str());
+        if (it != functions_.end()) {
+            // Failed expressions are not compiled again, but reported every time.
+            if (it->second == nullptr) {
+                log(ERROR) << "Cut expression does not compile: " << expression << std::endl;
+            }
+            return it->second;
+        }
+
+        // The interpreter has one namespace for all compilers, and failed
+        // expressions use up their names too, so names are never reused.
+        static int nFunctions = 0;
+        std::stringstream name;
+        name << "hps_cut_" << nFunctions++;
+        functions_[key.str()] = nullptr;
+
+        std::stringstream code;
+        code << "#pragma cling optimize(2)" << std::endl
+                << "#include <cmath>" << std::endl
+                << "void " << name.str()
+                << "(unsigned long n, const double* const* columns, char* pass) {" << std::endl
+                << "    using namespace std;" << std::endl
+                << "    for (unsigned long i = 0; i < n; i++) {" << std::endl;
+        for (size_t c = 0; c < variables.size(); c++) {
+            code << "        const double " << variables[c] << " = columns[" << c << "][i];" << std::endl;
+        }
+        code << "        pass[i] = (" << expression << ") ? 1 : 0;" << std::endl
+                << "    }" << std::endl
+                << "}" << std::endl;
+        HPS_LOG(FINEST) << "Compiling cut:" << std::endl << code.str();
+
+        if (!gInterpreter->Declare(code.str().c_str())) {
+            log(ERROR) << "Failed to compile cut expression: " << expression << std::endl;
+            return nullptr;
+        }
+        CutTable::CutFunction function =
+                (CutTable::CutFunction) gInterpreter->Calc(("(long) &" + name.str()).c_str());
+        if (function == nullptr) {
+            log(ERROR) << "Failed to get compiled cut: " << name.str() << std::endl;
+            return nullptr;
+        }
+        HPS_LOG(FINE) << "Compiled cut expression: " << expression << std::endl;
+        functions_[key.str()] = function;
+        return function;
+    }
+}
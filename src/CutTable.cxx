@@ -0,0 +1,135 @@
+#include "CutTable.h"
+
+// C++ standard library
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace hps {
+
+    void CutTable::addRow(TEveElement* element, const Values& values) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        elements_.push_back(element);
+        for (int c = 0; c < NCOLUMNS; c++) {
+            // Missing values would break the sort order.
+            columns_[c].push_back(std::isnan(values.values[c]) ? 0. : values.values[c]);
+        }
+        failed_.push_back(0);
+
+        size_t row = elements_.size() - 1;
+        for (std::map<int, Range>::const_iterator it = ranges_.begin(); it != ranges_.end(); it++) {
+            double value = columns_[it->second.column][row];
+            setPass(row, it->first, value >= it->second.min && value <= it->second.max);
+        }
+        for (std::map<int, CutFunction>::const_iterator it = functions_.begin(); it != functions_.end(); it++) {
+            const double* columns[NCOLUMNS];
+            for (int c = 0; c < NCOLUMNS; c++) {
+                columns[c] = &columns_[c][row];
+            }
+            char pass = 1;
+            it->second(1, columns, &pass);
+            setPass(row, it->first, pass != 0);
+        }
+    }
+
+    int CutTable::setRange(int cut, Column column, double min, double max) {
+        std::vector<int> rows;
+        std::map<int, Range>::iterator it = ranges_.find(cut);
+        if (it != ranges_.end() && it->second.column != column) {
+            for (size_t i = 0; i < elements_.size(); i++) {
+                rows.push_back(i);
+            }
+        } else {
+            // Only rows between the old and the new limits change.
+            double oldMin = it != ranges_.end() ? it->second.min : -std::numeric_limits<double>::infinity();
+            double oldMax = it != ranges_.end() ? it->second.max : std::numeric_limits<double>::infinity();
+            if (oldMin != min) {
+                findRows(column, std::min(oldMin, min), std::max(oldMin, min), false, rows);
+            }
+            if (oldMax != max) {
+                findRows(column, std::min(oldMax, max), std::max(oldMax, max), true, rows);
+            }
+        }
+        Range range = {column, min, max};
+        ranges_[cut] = range;
+
+        int changed = 0;
+        const std::vector<double>& values = columns_[column];
+        for (std::vector<int>::const_iterator row = rows.begin(); row != rows.end(); row++) {
+            changed += setPass(*row, cut, values[*row] >= min && values[*row] <= max);
+        }
+        return changed;
+    }
+
+    int CutTable::setFunction(int cut, CutFunction function) {
+        int changed = 0;
+        if (function == nullptr) {
+            functions_.erase(cut);
+            for (size_t i = 0; i < elements_.size(); i++) {
+                changed += setPass(i, cut, true);
+            }
+            return changed;
+        }
+        functions_[cut] = function;
+        const double* columns[NCOLUMNS];
+        for (int c = 0; c < NCOLUMNS; c++) {
+            columns[c] = columns_[c].data();
+        }
+        std::vector<char> pass(elements_.size(), 1);
+        function(elements_.size(), columns, pass.data());
+        for (size_t i = 0; i < elements_.size(); i++) {
+            changed += setPass(i, cut, pass[i] != 0);
+        }
+        return changed;
+    }
+
+    int CutTable::getNumberOfRows() {
+        return elements_.size();
+    }
+
+    const char* CutTable::getColumnName(Column column) {
+        static const char* names[NCOLUMNS] = {"p", "pt", "chi2", "charge", "pdg", "energy", "nhits", "time"};
+        return names[column];
+    }
+
+    int CutTable::setPass(size_t row, int cut, bool pass) {
+        unsigned int bit = 1u << cut;
+        unsigned int failed = pass ? failed_[row] & ~bit : failed_[row] | bit;
+        bool wasVisible = failed_[row] == 0;
+        failed_[row] = failed;
+        if (wasVisible != (failed == 0)) {
+            elements_[row]->SetRnrSelf(failed == 0);
+            return 1;
+        }
+        return 0;
+    }
+
+    void CutTable::findRows(Column column, double lo, double hi, bool upper, std::vector<int>& rows) {
+        const std::vector<int>& sorted = getSorted(column);
+        const std::vector<double>& values = columns_[column];
+        std::vector<int>::const_iterator begin, end;
+        if (upper) {
+            auto compare = [&values](double value, int row) { return value < values[row]; };
+            begin = std::upper_bound(sorted.begin(), sorted.end(), lo, compare);
+            end = std::upper_bound(begin, sorted.end(), hi, compare);
+        } else {
+            auto compare = [&values](int row, double value) { return values[row] < value; };
+            begin = std::lower_bound(sorted.begin(), sorted.end(), lo, compare);
+            end = std::lower_bound(begin, sorted.end(), hi, compare);
+        }
+        rows.insert(rows.end(), begin, end);
+    }
+
+    const std::vector<int>& CutTable::getSorted(Column column) {
+        std::vector<int>& sorted = sorted_[column];
+        if (sorted.size() != elements_.size()) {
+            const std::vector<double>& values = columns_[column];
+            sorted.resize(elements_.size());
+            for (size_t i = 0; i < sorted.size(); i++) {
+                sorted[i] = i;
+            }
+            std::sort(sorted.begin(), sorted.end(), [&values](int a, int b) { return values[a] < values[b]; });
+        }
+        return sorted;
+    }
+}
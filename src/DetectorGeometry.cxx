@@ -5,9 +5,14 @@
 #include "FileCache.h"
 
 // C++ standard library
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
 #include <iostream>
 #include <stdexcept>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <fstream>
 #include <sstream>
 
@@ -18,48 +23,106 @@
 #include "TEveTrans.h"
 #include "TEveEventManager.h"
 #include "TEveScene.h"
+#include "TColor.h"
+#include "TDirectory.h"
+#include "TFile.h"
+#include "TGeoBBox.h"
+#include "TGeoMatrix.h"
+#include "TList.h"
+#include "TROOT.h"
 
 #ifdef HAVE_LIBXML2
 
 #include <libxml/xmlreader.h>
+#include <libxml/xmlwriter.h>
+
+/*
+ * Copy the current node of the reader, which is inside the gdml element, to the writer.
+ */
+static int copyGdmlNode(xmlTextReaderPtr reader, xmlTextWriterPtr writer) {
+    switch (xmlTextReaderNodeType(reader)) {
+        case XML_READER_TYPE_ELEMENT: {
+            bool empty = xmlTextReaderIsEmptyElement(reader);
+            if (xmlTextWriterStartElement(writer, xmlTextReaderConstName(reader)) < 0) {
+                return -1;
+            }
+            while (xmlTextReaderMoveToNextAttribute(reader) == 1) {
+                if (xmlTextWriterWriteAttribute(writer,
+                                                xmlTextReaderConstName(reader),
+                                                xmlTextReaderConstValue(reader)) < 0) {
+                    return -1;
+                }
+            }
+            xmlTextReaderMoveToElement(reader);
+            return empty ? xmlTextWriterEndElement(writer) : 0;
+        }
+        case XML_READER_TYPE_END_ELEMENT:
+            return xmlTextWriterFullEndElement(writer);
+        case XML_READER_TYPE_TEXT:
+        case XML_READER_TYPE_WHITESPACE:
+        case XML_READER_TYPE_SIGNIFICANT_WHITESPACE:
+            return xmlTextWriterWriteString(writer, xmlTextReaderConstValue(reader));
+        case XML_READER_TYPE_CDATA:
+            return xmlTextWriterWriteCDATA(writer, xmlTextReaderConstValue(reader));
+        case XML_READER_TYPE_COMMENT:
+            return xmlTextWriterWriteComment(writer, xmlTextReaderConstValue(reader));
+        default:
+            return 0;
+    }
+}
 
+/*
+ * Stream the gdml element of an LCDD file to a GDML file, so that only the
+ * current node of either file is held in memory.
+ */
 void extractGdmlFile(const char* lcddName, const char* gdmlName) {
 
-    xmlDocPtr doc = xmlParseFile(lcddName);
-    if (doc == NULL) {
+    xmlTextReaderPtr reader = xmlReaderForFile(lcddName, NULL, XML_PARSE_HUGE);
+    if (reader == NULL) {
         throw std::runtime_error("Failed to open LCDD file.");
     }
-    xmlNode *root = xmlDocGetRootElement(doc);
 
-    xmlNode *cur = NULL;
-    xmlNode *gdml = NULL;
-    for (cur = root->children; cur; cur = cur->next) {
-        if (cur->type == XML_ELEMENT_NODE) {
-            if (xmlStrEqual(cur->name, BAD_CAST "gdml")) {
-                gdml = cur;
-                break;
+    xmlTextWriterPtr writer = xmlNewTextWriterFilename(gdmlName, 0);
+    if (writer == NULL) {
+        xmlFreeTextReader(reader);
+        throw std::runtime_error("Failed to create new GDML file.");
+    }
+    xmlTextWriterStartDocument(writer, NULL, NULL, NULL);
+
+    // Depth of the gdml element, or -1 before it was found
+    int gdmlDepth = -1;
+    bool done = false;
+    int status = 0;
+    int ret = 0;
+    while (!done && status >= 0 && (ret = xmlTextReaderRead(reader)) == 1) {
+        int depth = xmlTextReaderDepth(reader);
+        int type = xmlTextReaderNodeType(reader);
+        if (gdmlDepth < 0) {
+            if (type == XML_READER_TYPE_ELEMENT && depth == 1
+                    && xmlStrEqual(xmlTextReaderConstLocalName(reader), BAD_CAST "gdml")) {
+                gdmlDepth = depth;
+                status = copyGdmlNode(reader, writer);
+                done = xmlTextReaderIsEmptyElement(reader);
             }
+        } else {
+            status = copyGdmlNode(reader, writer);
+            done = type == XML_READER_TYPE_END_ELEMENT && depth == gdmlDepth;
         }
     }
 
-    xmlDocPtr gdmlDoc = xmlNewDoc(BAD_CAST "1.0");
-    xmlDocSetRootElement(gdmlDoc, gdml);
-
-    FILE* gdmlFile = fopen(gdmlName, "wb");
+    xmlTextWriterEndDocument(writer);
+    xmlFreeTextWriter(writer);
+    xmlFreeTextReader(reader);
+    xmlCleanupParser();
 
-    if (gdmlFile) {
-        xmlDocDump(gdmlFile, gdmlDoc);
-    } else {
-        throw std::runtime_error("Failed to create new GDML file.");
+    if (ret < 0 || status < 0) {
+        std::remove(gdmlName);
+        throw std::runtime_error("Failed to extract GDML from LCDD file.");
     }
-
-    fclose(gdmlFile);
-
-    if (doc) {
-        xmlFreeDoc(doc);
+    if (gdmlDepth < 0) {
+        std::remove(gdmlName);
+        throw std::runtime_error("No gdml element in LCDD file.");
     }
-
-    xmlCleanupParser();
 }
 
 
@@ -67,6 +130,45 @@ void extractGdmlFile(const char* lcddName, const char* gdmlName) {
 
 namespace hps {
 
+    // Version of the geometry cache format, which is written again if this changes.
+    static const int GEOMETRY_CACHE_VERSION = 1;
+
+    /*
+     * Remove the daughters of a volume whose names contain none of the patterns
+     * and return how many were removed.
+     */
+    static int pruneDaughters(TGeoVolume* volume, const std::vector<std::string>& keep) {
+        int removed = 0;
+        for (int i = volume->GetNdaughters() - 1; i >= 0; i--) {
+            TGeoNode* node = volume->GetNode(i);
+            std::string name(node->GetName());
+            bool used = false;
+            for (size_t k = 0; k < keep.size() && !used; k++) {
+                used = name.find(keep[k]) != std::string::npos;
+            }
+            if (!used) {
+                volume->RemoveNode(node);
+                removed++;
+            }
+        }
+        return removed;
+    }
+
+    /*
+     * Get the distinct volumes of the daughters of a volume whose names contain a pattern.
+     */
+    static std::vector<TGeoVolume*> getDaughterVolumes(TGeoVolume* volume, const char* patt) {
+        std::vector<TGeoVolume*> volumes;
+        for (int i = 0; i < volume->GetNdaughters(); i++) {
+            TGeoNode* node = volume->GetNode(i);
+            if (std::string(node->GetName()).find(patt) != std::string::npos
+                    && std::find(volumes.begin(), volumes.end(), node->GetVolume()) == volumes.end()) {
+                volumes.push_back(node->GetVolume());
+            }
+        }
+        return volumes;
+    }
+
     DetectorGeometry::DetectorGeometry(EventDisplay* app, FileCache* cache) :
             Logger("DetectorGeometry"),
             geo_(nullptr),
@@ -75,40 +177,67 @@ namespace hps {
         setLogLevel(app->getLogLevel());
     }
 
+    DetectorGeometry::DetectorGeometry(FileCache* cache) :
+            Logger("DetectorGeometry"),
+            geo_(nullptr),
+            eve_(nullptr),
+            fileCache_(cache) {
+    }
+
     DetectorGeometry::~DetectorGeometry() {
+        clearExtracts();
     }
 
-    TEveElementList* DetectorGeometry::createGeoElements(TGeoManager* geo,
-                                                         const char* name,
-                                                         const char* path,
-                                                         const char* patt,
-                                                         Char_t transparency) {
-        auto elements = new TEveElementList(name);
+    TEveGeoShapeExtract* DetectorGeometry::createShapeExtract(TGeoManager* geo,
+                                                              const char* name,
+                                                              Char_t transparency) {
+        TGeoVolume* vol = geo->GetCurrentVolume();
+        TEveGeoShapeExtract* extract = new TEveGeoShapeExtract(name, vol->GetMaterial()->GetName());
+        TEveTrans trans;
+        trans.SetFrom(*geo->GetCurrentMatrix());
+        extract->SetTrans(trans.Array());
+        Float_t rgba[4] = {1.f, 1.f, 1.f, 1.f - transparency / 100.f};
+        TColor* color = gROOT->GetColor(vol->GetLineColor());
+        if (color != nullptr) {
+            color->GetRGB(rgba[0], rgba[1], rgba[2]);
+        }
+        extract->SetRGBA(rgba);
+        // The fill color of the volume is kept as the line color of the extract.
+        color = gROOT->GetColor(vol->GetFillColor());
+        if (color != nullptr) {
+            color->GetRGB(rgba[0], rgba[1], rgba[2]);
+        }
+        extract->SetRGBALine(rgba);
+        extract->SetShape((TGeoShape*) vol->GetShape()->Clone());
+        return extract;
+    }
+
+    TEveGeoShapeExtract* DetectorGeometry::createGeoExtract(TGeoManager* geo,
+                                                            const char* name,
+                                                            const char* path,
+                                                            const char* patt,
+                                                            Char_t transparency) {
+        TEveGeoShapeExtract* extract = new TEveGeoShapeExtract(name);
+        TList* shapes = new TList();
+        shapes->SetOwner(kTRUE);
         geo->cd(path);
         auto ndau = geo->GetCurrentNode()->GetNdaughters();
         for (int i=0; i<ndau; i++) {
             geo->CdDown(i);
             TGeoNode* node = geo->GetCurrentNode();
             if (std::string(node->GetName()).find(patt) != std::string::npos) {
-                auto nodeName = node->GetName();
-                TGeoVolume* vol = geo->GetCurrentVolume();
-                TEveGeoShape* shape = new TEveGeoShape(node->GetName(), vol->GetMaterial()->GetName());
-                shape->SetShape((TGeoShape*) vol->GetShape()->Clone());
-                shape->SetMainColor(vol->GetLineColor());
-                shape->SetFillColor(vol->GetFillColor());
-                //shape->SetMainTransparency(vol->GetTransparency());
-                shape->SetMainTransparency(transparency);
-                shape->RefMainTrans().SetFrom(*geo->GetCurrentMatrix());
-                elements->AddElement(shape);
+                shapes->Add(createShapeExtract(geo, node->GetName(), transparency));
             }
             geo->CdUp();
         }
-        return elements;
+        extract->SetElements(shapes);
+        return extract;
     }
 
-    void DetectorGeometry::addTracker(Char_t transparency) {
-        log("Adding tracker...", INFO);
-        auto tracker = new TEveElementList("SVT");
+    TEveGeoShapeExtract* DetectorGeometry::createTrackerExtract(Char_t transparency) {
+        TEveGeoShapeExtract* tracker = new TEveGeoShapeExtract("SVT");
+        TList* shapes = new TList();
+        shapes->SetOwner(kTRUE);
         std::string basePath("/world_volume_1/tracking_volume_0/base_volume_0");
         geo_->cd(basePath.c_str());
         auto base = geo_->GetCurrentNode();
@@ -124,48 +253,78 @@ namespace hps {
                         std::stringstream ss;
                         ss << basePath << "/" << module->GetName() << "/" << moduleDauName;
                         geo_->cd(ss.str().c_str());
-                        TGeoNode* node = geo_->GetCurrentNode();
-                        TGeoVolume* volume = geo_->GetCurrentVolume();
-                        std::string sensorName(node->GetName());
+                        std::string sensorName(geo_->GetCurrentNode()->GetName());
                         sensorName.replace(sensorName.find("_volume_0"), sizeof("_volume_0") - 1, "");
-                        TEveGeoShape* shape = new TEveGeoShape(sensorName.c_str(), volume->GetMaterial()->GetName());
-                        shape->SetShape((TGeoShape*) volume->GetShape()->Clone());
-                        shape->SetMainColor(volume->GetLineColor());
-                        shape->SetFillColor(volume->GetFillColor());
-                        shape->SetMainTransparency(transparency);
-                        shape->RefMainTrans().SetFrom(*geo_->GetCurrentMatrix());
-                        tracker->AddElement(shape);
-                        log(FINE) << "Added SVT volume: " << volume->GetName() << std::endl;
+                        shapes->Add(createShapeExtract(geo_, sensorName.c_str(), transparency));
+                        HPS_LOG(FINE) << "Added SVT volume: " << geo_->GetCurrentVolume()->GetName() << std::endl;
                     }
                 }
             }
         }
-        eve_->AddGlobalElement(tracker);
-        log("Done adding tracker!", INFO);
+        tracker->SetElements(shapes);
+        return tracker;
     }
 
-    void DetectorGeometry::addEcal(Char_t transparency) {
-        log("Adding ECAL...", INFO);
-        auto cal = createGeoElements(geo_,
-                                     "ECAL",
-                                     "/world_volume_1",
-                                     "crystal_volume",
-                                     transparency);
-        cal->SetDrawOption("w");
-        eve_->AddGlobalElement(cal);
-        log("Done adding ECAL!", INFO);
+    void DetectorGeometry::createExtracts() {
+        clearExtracts();
+        log("Creating extracts of SVT, ECAL and Hodoscope...", INFO);
+        trackerExtract_ = createTrackerExtract();
+        ecalExtract_ = createGeoExtract(geo_,
+                                        "ECAL",
+                                        "/world_volume_1",
+                                        "crystal_volume",
+                                        50);
+        hodoExtract_ = createGeoExtract(geo_,
+                                        "Hodoscope",
+                                        "/world_volume_1/tracking_volume_0",
+                                        "hodo_vol_L",
+                                        50);
     }
 
-    void DetectorGeometry::addHodoscope(Char_t transparency) {
-        log("Adding Hodoscope...", INFO);
-        auto hodo = createGeoElements(geo_,
-                                     "Hodoscope",
-                                     "/world_volume_1/tracking_volume_0",
-                                     "hodo_vol_L",
-                                     transparency);
-        //hodo->SetDrawOption("w");
-        eve_->AddGlobalElement(hodo);
-        log("Done adding Hodoscope!", INFO);
+    void DetectorGeometry::clearExtracts() {
+        delete trackerExtract_;
+        delete ecalExtract_;
+        delete hodoExtract_;
+        trackerExtract_ = nullptr;
+        ecalExtract_ = nullptr;
+        hodoExtract_ = nullptr;
+    }
+
+    TEveElementList* DetectorGeometry::createElements(TEveGeoShapeExtract* extract) {
+        TEveElementList* elements = new TEveElementList(extract->GetName());
+        TIter next(extract->GetElements());
+        while (TEveGeoShapeExtract* child = (TEveGeoShapeExtract*) next()) {
+            TEveGeoShape* shape = new TEveGeoShape(child->GetName(), child->GetTitle());
+            shape->SetShape(child->GetShape());
+            child->SetShape(nullptr);
+            const Float_t* rgba = child->GetRGBA();
+            shape->SetMainColor(TColor::GetColor(rgba[0], rgba[1], rgba[2]));
+            shape->SetMainAlpha(rgba[3]);
+            const Float_t* fill = child->GetRGBALine();
+            shape->SetFillColor(TColor::GetColor(fill[0], fill[1], fill[2]));
+            shape->RefMainTrans().SetFromArray(child->GetTrans());
+            elements->AddElement(shape);
+        }
+        return elements;
+    }
+
+    void DetectorGeometry::pruneGeometry() {
+        log("Pruning volumes that are not displayed...", INFO);
+        TGeoVolume* world = geo_->GetTopVolume();
+        int removed = pruneDaughters(world, {"crystal_volume", "tracking_volume"});
+        std::vector<TGeoVolume*> tracking = getDaughterVolumes(world, "tracking_volume");
+        for (size_t t = 0; t < tracking.size(); t++) {
+            removed += pruneDaughters(tracking[t], {"base_volume", "hodo_vol_L"});
+            std::vector<TGeoVolume*> bases = getDaughterVolumes(tracking[t], "base_volume");
+            for (size_t b = 0; b < bases.size(); b++) {
+                removed += pruneDaughters(bases[b], {"module_L"});
+                std::vector<TGeoVolume*> modules = getDaughterVolumes(bases[b], "module_L");
+                for (size_t m = 0; m < modules.size(); m++) {
+                    removed += pruneDaughters(modules[m], {"sensor"});
+                }
+            }
+        }
+        log(INFO) << "Removed " << removed << " volume placements from the geometry" << std::endl;
     }
 
     TEveElement* DetectorGeometry::toEveElement(TGeoManager* geo, TGeoNode* node) {
@@ -179,10 +338,250 @@ namespace hps {
         return shape;
     }
 
+    void DetectorGeometry::buildCrystalTable() {
+        HPS_LOG(FINE) << "Building ECAL crystal table..." << std::endl;
+        crystals_.clear();
+        cellIdMap_.clear();
+        crystalGrid_.clear();
+        nodeMap_.clear();
+        gridSize_ = 0.;
+
+        geo_->cd("/world_volume_1");
+        auto ndau = geo_->GetCurrentNode()->GetNdaughters();
+        for (int i=0; i<ndau; i++) {
+            geo_->CdDown(i);
+            TGeoNode* node = geo_->GetCurrentNode();
+            if (std::string(node->GetName()).find("crystal_volume") != std::string::npos) {
+                Crystal crystal;
+                crystal.node = node;
+                crystal.volume = geo_->GetCurrentVolume();
+                crystal.shape = crystal.volume->GetShape();
+                crystal.matrix = *geo_->GetCurrentMatrix();
+                if (crystal.shape->GetNmeshVertices() == 8) {
+                    Double_t local[24];
+                    crystal.shape->SetPoints(local);
+                    for (int v = 0; v < 8; v++) {
+                        Double_t master[3];
+                        crystal.matrix.LocalToMaster(&local[3 * v], master);
+                        for (int c = 0; c < 3; c++) {
+                            crystal.vertices[3 * v + c] = master[c];
+                        }
+                    }
+                    crystal.hasVertices = true;
+                }
+                nodeMap_[node] = crystals_.size();
+                crystals_.push_back(crystal);
+                if (gridSize_ <= 0.) {
+                    // Grid spacing of the largest transverse crystal dimension
+                    TGeoBBox* box = (TGeoBBox*) crystal.shape;
+                    gridSize_ = 2. * std::max(box->GetDX(), box->GetDY());
+                }
+            }
+            geo_->CdUp();
+        }
+
+        for (size_t i = 0; i < crystals_.size(); i++) {
+            const Double_t* center = crystals_[i].matrix.GetTranslation();
+            crystalGrid_[gridKey(center[0], center[1])].push_back(i);
+        }
+
+        HPS_LOG(FINE) << "Built ECAL crystal table with " << crystals_.size()
+                << " crystals and grid size " << gridSize_ << " cm" << std::endl;
+    }
+
+    const DetectorGeometry::Crystal* DetectorGeometry::findCrystal(long long cellID, const double* pos) {
+        {
+            std::lock_guard<std::mutex> lock(cellIdMutex_);
+            std::unordered_map<long long, int>::iterator fnd = cellIdMap_.find(cellID);
+            if (fnd != cellIdMap_.end()) {
+                return &crystals_[fnd->second];
+            }
+        }
+        int index = findCrystalIndex(pos);
+        if (index < 0) {
+            return nullptr;
+        }
+        HPS_LOG(FINEST) << "Mapped cell ID " << cellID << " to crystal: "
+                << crystals_[index].node->GetName() << std::endl;
+        std::lock_guard<std::mutex> lock(cellIdMutex_);
+        cellIdMap_[cellID] = index;
+        return &crystals_[index];
+    }
+
+    int DetectorGeometry::findCrystalIndex(const double* pos) {
+        if (gridSize_ > 0.) {
+            for (int dx = -1; dx <= 1; dx++) {
+                for (int dy = -1; dy <= 1; dy++) {
+                    std::unordered_map<long long, std::vector<int>>::iterator cell =
+                            crystalGrid_.find(gridKey(pos[0] + dx * gridSize_, pos[1] + dy * gridSize_));
+                    if (cell == crystalGrid_.end()) {
+                        continue;
+                    }
+                    for (std::vector<int>::iterator it = cell->second.begin(); it != cell->second.end(); it++) {
+                        Double_t local[3];
+                        crystals_[*it].matrix.MasterToLocal(pos, local);
+                        if (crystals_[*it].shape->Contains(local)) {
+                            return *it;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Fall back to navigation from the top volume.
+        if (geo_->IsMultiThread() && geo_->GetCurrentNavigator() == nullptr) {
+            geo_->AddNavigator();
+        }
+        geo_->CdTop();
+        TGeoNode* node = geo_->FindNode(pos[0], pos[1], pos[2]);
+        std::map<TGeoNode*, int>::iterator fnd = nodeMap_.find(node);
+        if (fnd != nodeMap_.end()) {
+            return fnd->second;
+        }
+        return -1;
+    }
+
+    long long DetectorGeometry::gridKey(double x, double y) {
+        long long ix = (long long) std::floor(x / gridSize_);
+        long long iy = (long long) std::floor(y / gridSize_);
+        return (ix << 32) ^ (iy & 0xffffffffLL);
+    }
+
+    void DetectorGeometry::setMaxThreads(int nThreads) {
+        if (geo_ != nullptr && !geo_->IsMultiThread()) {
+            HPS_LOG(FINE) << "Enabling navigation from " << nThreads << " threads" << std::endl;
+            geo_->SetMaxThreads(nThreads);
+        }
+    }
+
     TGeoManager* DetectorGeometry::getGeoManager() {
         return geo_;
     }
 
+    std::shared_future<void> DetectorGeometry::fetchDetector(const std::string& detName) {
+        std::string detUrl = BASE_DETECTOR_URL + "/" + detName + "/" + detName + std::string(".lcdd");
+        return fileCache_->fetch(detUrl, detName + ".lcdd");
+    }
+
+    void DetectorGeometry::setDetectorUrl(const std::string& url) {
+        BASE_DETECTOR_URL = url;
+    }
+
+    void DetectorGeometry::setPruneGeometry(bool prune) {
+        prune_ = prune;
+    }
+
+    std::string DetectorGeometry::getGeometryCacheName(const std::string& name) {
+        return name + (prune_ ? ".pruned" : "") + ".geo.root";
+    }
+
+    bool DetectorGeometry::readGeometryCache(const std::string& name, const std::string& hash) {
+        std::string cacheName = getGeometryCacheName(name);
+        if (!fileCache_->isCached(cacheName)) {
+            return false;
+        }
+        std::string path = fileCache_->getCachedPath(cacheName);
+
+        TDirectory::TContext context;
+        TFile* file = TFile::Open(path.c_str());
+        if (file == nullptr || file->IsZombie()) {
+            log("Ignoring unreadable geometry cache: " + path, WARNING);
+            delete file;
+            return false;
+        }
+
+        TNamed* version = (TNamed*) file->Get("version");
+        TNamed* source = (TNamed*) file->Get("hash");
+        bool valid = version != nullptr && source != nullptr
+                && std::to_string(GEOMETRY_CACHE_VERSION) == version->GetTitle()
+                && hash == source->GetTitle();
+        delete version;
+        delete source;
+        if (!valid) {
+            log("Ignoring geometry cache of a different source file: " + path, INFO);
+            file->Close();
+            delete file;
+            return false;
+        }
+
+        log("Reading geometry cache: " + path, INFO);
+        geo_ = TGeoManager::Import(path.c_str(), "geometry");
+        clearExtracts();
+        trackerExtract_ = (TEveGeoShapeExtract*) file->Get("SVT");
+        ecalExtract_ = (TEveGeoShapeExtract*) file->Get("ECAL");
+        hodoExtract_ = (TEveGeoShapeExtract*) file->Get("Hodoscope");
+        file->Close();
+        delete file;
+
+        if (geo_ == nullptr || trackerExtract_ == nullptr || ecalExtract_ == nullptr || hodoExtract_ == nullptr) {
+            log("Ignoring incomplete geometry cache: " + path, WARNING);
+            delete geo_;
+            geo_ = nullptr;
+            clearExtracts();
+            return false;
+        }
+        return true;
+    }
+
+    bool DetectorGeometry::writeGeometryCache(const std::string& name, const std::string& hash) {
+        std::string path = fileCache_->getCachedPath(getGeometryCacheName(name));
+        std::string tmpPath = path + ".tmp";
+        log("Writing geometry cache: " + path, INFO);
+
+        TDirectory::TContext context;
+        TFile* file = TFile::Open(tmpPath.c_str(), "RECREATE");
+        if (file == nullptr || file->IsZombie()) {
+            log("Failed to write geometry cache: " + path, WARNING);
+            delete file;
+            return false;
+        }
+        geo_->Write("geometry");
+        trackerExtract_->Write("SVT");
+        ecalExtract_->Write("ECAL");
+        hodoExtract_->Write("Hodoscope");
+        TNamed("version", std::to_string(GEOMETRY_CACHE_VERSION).c_str()).Write();
+        TNamed("hash", hash.c_str()).Write();
+        file->Close();
+        delete file;
+
+        // The complete file replaces the old one, so that a reader never sees a partial cache.
+        if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+            log("Failed to write geometry cache: " + path, WARNING);
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    void DetectorGeometry::importGeometry(const std::string& gdmlName,
+                                          const std::string& name,
+                                          const std::string& hash) {
+        log("Importing GDML file: " + gdmlName, INFO);
+        geo_ = TGeoManager::Import(gdmlName.c_str());
+        if (geo_ == nullptr) {
+            throw std::runtime_error("Failed to import GDML file: " + gdmlName);
+        }
+        createExtracts();
+        if (prune_) {
+            pruneGeometry();
+        }
+        bool written = writeGeometryCache(name, hash);
+        if (prune_) {
+            // The pruned geometry is navigated as it was read back, since it was closed before pruning.
+            delete geo_;
+            geo_ = nullptr;
+            clearExtracts();
+            if (!written || !readGeometryCache(name, hash)) {
+                log("Using the unpruned geometry, which could not be cached", WARNING);
+                geo_ = TGeoManager::Import(gdmlName.c_str());
+                if (geo_ == nullptr) {
+                    throw std::runtime_error("Failed to import GDML file: " + gdmlName);
+                }
+                createExtracts();
+            }
+        }
+    }
+
     // Include guards are just here for the compilation.
     // We will never get to this method if curl and libxml2 were not enabled.
     void DetectorGeometry::loadDetector(const std::string& detName) {
@@ -192,46 +591,64 @@ namespace hps {
         std::string lcddName = detName + ".lcdd";
         std::string gdmlName = detName + ".gdml";
 
+        fetchDetector(detName).get();
         if (!fileCache_->isCached(lcddName)) {
-            std::string detUrl = BASE_DETECTOR_URL + "/" + detName + "/" + detName + std::string(".lcdd");
-            fileCache_->cache(detUrl.c_str(), lcddName.c_str());
-            if (!fileCache_->isCached(lcddName)) {
-                log("Failed to cache LCD file.", ERROR);
-                throw new std::runtime_error("Failed to cache LCD file.");
-            }
+            log("Failed to cache LCD file.", ERROR);
+            throw std::runtime_error("Failed to cache LCD file.");
         }
 
-        log("Extracting GDML file from: " + lcddName, INFO);
-        if (!fileCache_->isCached(gdmlName)) {
+        // The GDML file is only extracted and imported if the cache was not saved from this LCDD file.
+        std::string hash = FileCache::hashFile(fileCache_->getCachedPath(lcddName));
+        if (!readGeometryCache(detName, hash)) {
+            // The GDML file is only kept until it was imported, since the geometry cache replaces it.
+            std::string gdmlPath = fileCache_->getCachedPath(gdmlName + "." + std::to_string(getpid()));
+            log("Extracting GDML file from: " + lcddName, INFO);
 #ifdef HAVE_LIBXML2
-            extractGdmlFile(fileCache_->getCachedPath(lcddName).c_str(),
-                            fileCache_->getCachedPath(gdmlName).c_str());
+            extractGdmlFile(fileCache_->getCachedPath(lcddName).c_str(), gdmlPath.c_str());
 #else
             throw std::runtime_error("libxml2 was not enabled!");
 #endif
             log("Done extracting GDML file!", INFO);
-        } else {
-            log("GDML file was already in cache: " + fileCache_->getCachedPath(gdmlName));
+            try {
+                importGeometry(gdmlPath, detName, hash);
+            } catch (...) {
+                std::remove(gdmlPath.c_str());
+                throw;
+            }
+            std::remove(gdmlPath.c_str());
         }
 
-        loadDetectorFile(fileCache_->getCachedPath(gdmlName));
+        HPS_LOG(FINE) << "Building detector..." << std::endl;
+        buildDetector();
+        HPS_LOG(FINE) << "Done building detector!" << std::endl;
 
         log("Done loading detector!", INFO);
     }
 
     void DetectorGeometry::loadDetectorFile(const std::string& gdmlName) {
         log("Loading GDML file: " + gdmlName);
-        geo_ = TGeoManager::Import(gdmlName.c_str());
-        log("Building detector...", FINE);
+        std::string name = gdmlName.substr(gdmlName.find_last_of('/') + 1);
+        name = name.substr(0, name.find_last_of('.'));
+        std::string hash = FileCache::hashFile(gdmlName);
+        if (!readGeometryCache(name, hash)) {
+            importGeometry(gdmlName, name, hash);
+        }
+        HPS_LOG(FINE) << "Building detector..." << std::endl;
         buildDetector();
-        log("Done building detector!", FINE);
-
+        HPS_LOG(FINE) << "Done building detector!" << std::endl;
     }
 
     void DetectorGeometry::buildDetector() {
-        addTracker();
-        addEcal();
-        addHodoscope();
+        buildCrystalTable();
+        if (eve_ != nullptr) {
+            log("Adding SVT, ECAL and Hodoscope...", INFO);
+            eve_->AddGlobalElement(createElements(trackerExtract_));
+            TEveElementList* cal = createElements(ecalExtract_);
+            cal->SetDrawOption("w");
+            eve_->AddGlobalElement(cal);
+            eve_->AddGlobalElement(createElements(hodoExtract_));
+        }
+        clearExtracts();
     }
 
     bool DetectorGeometry::isInitialized() {
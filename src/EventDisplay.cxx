@@ -4,6 +4,7 @@
 #include "DetectorGeometry.h"
 #include "EventManager.h"
 #include "FileCache.h"
+#include "PropagatorRegistry.h"
 
 // ROOT
 #include "TEveManager.h"
@@ -15,6 +16,8 @@
 #include "TGButton.h"
 #include "TGLabel.h"
 #include "TGNumberEntry.h"
+#include "TGTextEntry.h"
+#include "TROOT.h"
 
 // C++ standard library
 #include <unistd.h>
@@ -22,7 +25,6 @@
 #include <stdexcept>
 #include <stdlib.h>
 #include <fstream>
-#include <limits>
 
 ClassImp(hps::EventDisplay);
 
@@ -36,6 +38,7 @@ namespace hps {
     }
 
     EventDisplay::~EventDisplay() {
+        delete propagators_;
         delete cache_;
     }
 
@@ -48,13 +51,25 @@ namespace hps {
             throw std::runtime_error("The Eve manager was not set!");
         }
 
+        // ROOT needs to know before any objects are created on worker threads,
+        // which includes the one prebuilding events for auto play.
+        ROOT::EnableThreadSafety();
+
         // Create the file cache.
         cache_ = new FileCache(cacheDir_);
         cache_->setLogLevel(getLogLevel());
         cache_->createCacheDir();
 
+        // Create the track propagators shared by all events.
+        propagators_ = new PropagatorRegistry(bY_);
+        propagators_->setLogLevel(getLogLevel());
+
         // Initialize the geometry and load detector if GDML was provided.
         det_ = new DetectorGeometry(this, cache_);
+        det_->setPruneGeometry(pruneGeometry_);
+        if (detectorUrl_.size() > 0) {
+            det_->setDetectorUrl(detectorUrl_);
+        }
         if (geometryFile_.size() > 0) {
             log("Opening geometry file: " + geometryFile_, INFO);
             det_->loadDetectorFile(geometryFile_);
@@ -105,17 +120,64 @@ namespace hps {
                                                   TGNumberFormat::kNESInteger,
                                                   TGNumberFormat::kNEAAnyNumber,
                                                   TGNumberFormat::kNELLimitMinMax,
-                                                  0, std::numeric_limits<int>::max());
+                                                  0, eventManager_->getNumberOfEvents() - 1);
             eventNrFrame->AddFrame(eventNrLabel, new TGLayoutHints(kLHintsNormal, 5, 5, 0, 0));
             eventNrFrame->AddFrame(eventNumberEntry_);
             eventNumberEntry_->GetNumberEntry()->Connect(
                     "ReturnPressed()", "hps::EventManager", eventManager_, "SetEventNumber()");
             frmEvent->AddFrame(eventNrFrame);
 
+            // Auto play at a target rate
+            TGVerticalFrame* autoPlayFrame = new TGVerticalFrame(frmEvent);
+            TGHorizontalFrame* autoPlayRateFrame = new TGHorizontalFrame(autoPlayFrame);
+            autoPlayButton_ = new TGCheckButton(autoPlayRateFrame, "Auto play");
+            autoPlayButton_->Connect("Toggled(Bool_t)", "hps::EventManager", eventManager_, "toggleAutoPlay()");
+            autoPlayRateEntry_ = new TGNumberEntry(autoPlayRateFrame, autoPlayRate_ > 0. ? autoPlayRate_ : 1., 5, -1,
+                                                   TGNumberFormat::kNESRealTwo,
+                                                   TGNumberFormat::kNEAPositive,
+                                                   TGNumberFormat::kNELLimitMinMax,
+                                                   0.01, 50.);
+            autoPlayRateEntry_->Connect("ValueSet(Long_t)", "hps::EventManager", eventManager_, "modifyAutoPlayRate()");
+            TGLabel* autoPlayRateLabel = new TGLabel(autoPlayRateFrame, "events/s");
+            autoPlayRateFrame->AddFrame(autoPlayButton_, new TGLayoutHints(kLHintsCenterY, 5, 5, 0, 0));
+            autoPlayRateFrame->AddFrame(autoPlayRateEntry_);
+            autoPlayRateFrame->AddFrame(autoPlayRateLabel, new TGLayoutHints(kLHintsCenterY, 2, 0, 0, 0));
+            autoPlayFrame->AddFrame(autoPlayRateFrame);
+            autoPlayStatusLabel_ = new TGLabel(autoPlayFrame, "Auto play is off");
+            autoPlayStatusLabel_->SetTextJustify(kTextLeft);
+            autoPlayFrame->AddFrame(autoPlayStatusLabel_, new TGLayoutHints(kLHintsExpandX, 5, 2, 2, 2));
+            frmEvent->AddFrame(autoPlayFrame);
+
+            // Follow the input files as they are written
+            TGVerticalFrame* followFrame = new TGVerticalFrame(frmEvent);
+            followButton_ = new TGCheckButton(followFrame, "Follow");
+            followButton_->SetToolTipText("Show the newest event as events are appended to the files");
+            followButton_->Connect("Toggled(Bool_t)", "hps::EventManager", eventManager_, "toggleFollow()");
+            followFrame->AddFrame(followButton_, new TGLayoutHints(kLHintsNormal, 5, 5, 0, 0));
+            followStatusLabel_ = new TGLabel(followFrame, "Follow is off");
+            followStatusLabel_->SetTextJustify(kTextLeft);
+            followFrame->AddFrame(followStatusLabel_, new TGLayoutHints(kLHintsExpandX, 5, 2, 2, 2));
+            frmEvent->AddFrame(followFrame);
+
             // Add event frame
             AddFrame(frmEvent, new TGLayoutHints(kLHintsExpandX | kLHintsExpandY));
         }
 
+        // Skim selection on event variables, which navigation steps through
+        {
+            TGGroupFrame* frmSkim = new TGGroupFrame(this, "Skim", kVerticalFrame);
+            skimEntry_ = new TGTextEntry(frmSkim);
+            skimEntry_->SetToolTipText("C++ condition on ntracks, npos, nneg, nvertices, nclusters, "
+                                       "e1, e2, esum, nparticles and nmcparticles, applied on Enter");
+            skimEntry_->Resize(200, skimEntry_->GetDefaultHeight());
+            frmSkim->AddFrame(skimEntry_, new TGLayoutHints(kLHintsExpandX, 2, 2, 2, 2));
+            skimEntry_->Connect("ReturnPressed()", "hps::EventManager", eventManager_, "modifySkim()");
+            skimStatusLabel_ = new TGLabel(frmSkim, "All events");
+            skimStatusLabel_->SetTextJustify(kTextLeft);
+            frmSkim->AddFrame(skimStatusLabel_, new TGLayoutHints(kLHintsExpandX, 2, 2, 2, 2));
+            AddFrame(frmSkim, new TGLayoutHints(kLHintsExpandX | kLHintsTop));
+        }
+
         // Display cuts
         {
             TGGroupFrame *frmCuts = new TGGroupFrame(this, "Cuts", kHorizontalFrame);
@@ -164,12 +226,59 @@ namespace hps {
             frmChi2Cut->AddFrame(chi2CutEntry_);
             chi2CutEntry_->Connect ("ValueSet(Long_t)", "hps::EventManager", eventManager_, "modifyChi2Cut()");
 
+            // Cut expression on the variables of MCParticles, Tracks and ReconstructedParticles
+            TGGroupFrame* frmCutExpression = new TGGroupFrame(vf, "Cut expression:", kHorizontalFrame);
+            vf->AddFrame(frmCutExpression, new TGLayoutHints(kLHintsLeft | kLHintsExpandX, 2, 2, 2, 2));
+            cutExpressionEntry_ = new TGTextEntry(frmCutExpression);
+            cutExpressionEntry_->SetToolTipText("C++ condition on p, pt, chi2, charge, pdg, energy, nhits "
+                                                "and time, applied on Enter");
+            cutExpressionEntry_->Resize(200, cutExpressionEntry_->GetDefaultHeight());
+            frmCutExpression->AddFrame(cutExpressionEntry_, new TGLayoutHints(kLHintsExpandX));
+            cutExpressionEntry_->Connect("ReturnPressed()", "hps::EventManager", eventManager_, "modifyCutExpression()");
+
             AddFrame(frmCuts, new TGLayoutHints(kLHintsExpandX | kLHintsExpandY | kLHintsTop));
         }
 
+        // Timings of the stages of showing an event
+        {
+            TGGroupFrame* frmTiming = new TGGroupFrame(this, "Timing", kVerticalFrame);
+            timingButton_ = new TGCheckButton(frmTiming, "Time stages");
+            frmTiming->AddFrame(timingButton_, new TGLayoutHints(kLHintsLeft, 2, 2, 2, 2));
+            timingButton_->Connect("Toggled(Bool_t)", "hps::EventManager", eventManager_, "toggleTiming()");
+            timingLabel_ = new TGLabel(frmTiming, "Timing is disabled");
+            timingLabel_->SetTextJustify(kTextLeft | kTextTop);
+            timingLabel_->SetTextFont("-*-courier-medium-r-*-*-12-*-*-*-*-*-iso8859-1");
+            frmTiming->AddFrame(timingLabel_, new TGLayoutHints(kLHintsExpandX, 2, 2, 2, 2));
+            AddFrame(frmTiming, new TGLayoutHints(kLHintsExpandX | kLHintsTop));
+        }
+
+        // Magnetic field
+        {
+            TGGroupFrame* frmMagField = new TGGroupFrame(this, "Magnetic Field", kHorizontalFrame);
+            TGLabel* magFieldLabel = new TGLabel(frmMagField, "bY [T]");
+            magFieldEntry_ = new TGNumberEntry(frmMagField, bY_, 5, -1,
+                                               TGNumberFormat::kNESRealThree,
+                                               TGNumberFormat::kNEAAnyNumber,
+                                               TGNumberFormat::kNELNoLimits);
+            frmMagField->AddFrame(magFieldEntry_);
+            frmMagField->AddFrame(magFieldLabel, new TGLayoutHints(kLHintsBottom, 2, 0, 0, 0));
+            magFieldEntry_->Connect("ValueSet(Long_t)", "hps::EventManager", eventManager_, "modifyMagField()");
+            AddFrame(frmMagField, new TGLayoutHints(kLHintsExpandX | kLHintsTop));
+        }
+
         MapSubwindows();
         Resize(GetDefaultSize());
         MapWindow();
+
+        // Unattended displays start playing right away.
+        if (autoPlayRate_ > 0.) {
+            autoPlayButton_->SetOn(kTRUE);
+            eventManager_->toggleAutoPlay();
+        }
+        if (follow_) {
+            followButton_->SetOn(kTRUE);
+            eventManager_->toggleFollow();
+        }
     }
 
     int EventDisplay::getCurrentEventNumber() {
@@ -188,17 +297,56 @@ namespace hps {
         return det_;
     }
 
+    FileCache* EventDisplay::getFileCache() {
+        return cache_;
+    }
+
+    PropagatorRegistry* EventDisplay::getPropagatorRegistry() {
+        return propagators_;
+    }
+
     double EventDisplay::getMagFieldY() {
         return bY_;
     }
 
+    double EventDisplay::getMagFieldEntry() {
+        return magFieldEntry_->GetNumber();
+    }
+
+    int EventDisplay::getReadAheadDepth() {
+        return readAheadDepth_;
+    }
+
+    int EventDisplay::getSceneCacheSize() {
+        return sceneCacheSize_;
+    }
+
+    double EventDisplay::getMCMinEnergy() {
+        return mcMinEnergy_;
+    }
+
+    int EventDisplay::getMCMaxDepth() {
+        return mcMaxDepth_;
+    }
+
+    int EventDisplay::getMCMaxParticles() {
+        return mcMaxParticles_;
+    }
+
+    int EventDisplay::getBuildThreads() {
+        return buildThreads_;
+    }
+
     const std::vector<std::string>& EventDisplay::getLcioFiles() {
         return lcioFileList_;
     }
 
-    bool EventDisplay::excludeCollection(const std::string& collectionName, EVENT::LCCollection* collection) {
-        return excludeCollectionNames_.find(collectionName) != excludeCollectionNames_.end() ||
-                excludeCollectionTypes_.find(collection->getTypeName()) != excludeCollectionTypes_.end();
+    const std::set<std::string>& EventDisplay::getExcludeCollectionNames() {
+        return excludeCollectionNames_;
+    }
+
+    const std::set<std::string>& EventDisplay::getExcludeCollectionTypes() {
+        return excludeCollectionTypes_;
     }
 
     EventDisplay* EventDisplay::getInstance() {
@@ -220,6 +368,62 @@ namespace hps {
         return chi2CutEntry_->GetNumber();
     }
 
+    std::string EventDisplay::getCutExpression() {
+        return cutExpressionEntry_->GetText();
+    }
+
+    std::string EventDisplay::getSkimExpression() {
+        return skimEntry_->GetText();
+    }
+
+    void EventDisplay::setSkimStatus(const std::string& status) {
+        skimStatusLabel_->SetText(status.c_str());
+        Layout();
+    }
+
+    bool EventDisplay::isAutoPlayEnabled() {
+        return autoPlayButton_->IsOn();
+    }
+
+    void EventDisplay::setAutoPlayEnabled(bool enabled) {
+        autoPlayButton_->SetOn(enabled);
+    }
+
+    double EventDisplay::getAutoPlayRate() {
+        return autoPlayRateEntry_->GetNumber();
+    }
+
+    void EventDisplay::setAutoPlayStatus(const std::string& status) {
+        autoPlayStatusLabel_->SetText(status.c_str());
+        Layout();
+    }
+
+    bool EventDisplay::isFollowEnabled() {
+        return followButton_->IsOn();
+    }
+
+    void EventDisplay::setFollowEnabled(bool enabled) {
+        followButton_->SetOn(enabled);
+    }
+
+    void EventDisplay::setFollowStatus(const std::string& status) {
+        followStatusLabel_->SetText(status.c_str());
+        Layout();
+    }
+
+    void EventDisplay::setNumberOfEvents(int nEvents) {
+        eventNumberEntry_->SetLimitValues(0, nEvents - 1);
+    }
+
+    bool EventDisplay::isTimingEnabled() {
+        return timingButton_->IsOn();
+    }
+
+    void EventDisplay::setTimingStatus(const std::string& status) {
+        timingLabel_->SetText(status.c_str());
+        Layout();
+    }
+
     void EventDisplay::setEveManager(TEveManager* eveManager) {
         eveManager_ = eveManager;
     }
@@ -246,6 +450,43 @@ namespace hps {
 
     void EventDisplay::setMagFieldY(double bY) {
         bY_ = bY;
+        if (propagators_ != nullptr) {
+            propagators_->setMagFieldY(bY);
+        }
+    }
+
+    void EventDisplay::setReadAheadDepth(int readAheadDepth) {
+        readAheadDepth_ = readAheadDepth;
+    }
+
+    void EventDisplay::setSceneCacheSize(int sceneCacheSize) {
+        sceneCacheSize_ = sceneCacheSize;
+    }
+
+    void EventDisplay::setBuildThreads(int buildThreads) {
+        buildThreads_ = buildThreads;
+    }
+
+    void EventDisplay::setPruneGeometry(bool pruneGeometry) {
+        pruneGeometry_ = pruneGeometry;
+    }
+
+    void EventDisplay::setMCDetail(double minEnergy, int maxDepth, int maxParticles) {
+        mcMinEnergy_ = minEnergy;
+        mcMaxDepth_ = maxDepth;
+        mcMaxParticles_ = maxParticles;
+    }
+
+    void EventDisplay::setAutoPlayRate(double autoPlayRate) {
+        autoPlayRate_ = autoPlayRate;
+    }
+
+    void EventDisplay::setFollow(bool follow) {
+        follow_ = follow;
+    }
+
+    void EventDisplay::setDetectorUrl(std::string detectorUrl) {
+        detectorUrl_ = detectorUrl;
     }
 
     void EventDisplay::printConfig() {
@@ -273,6 +514,15 @@ namespace hps {
             std::cout << "      " << *it << std::endl;
         }
         std::cout << "    bY: " << bY_ << std::endl;
+        std::cout << "    read ahead: " << readAheadDepth_ << std::endl;
+        std::cout << "    scene cache: " << sceneCacheSize_ << " MB" << std::endl;
+        std::cout << "    build threads: " << buildThreads_ << std::endl;
+        std::cout << "    prune geometry: " << pruneGeometry_ << std::endl;
+        std::cout << "    detector url: " << detectorUrl_ << std::endl;
+        std::cout << "    auto play rate: " << autoPlayRate_ << std::endl;
+        std::cout << "    follow: " << follow_ << std::endl;
+        std::cout << "    MCParticle detail: " << mcMaxParticles_ << " particles, "
+                << mcMinEnergy_ << " GeV, depth " << mcMaxDepth_ << std::endl;
         std::cout << "  ----------------------------------- " << std::endl;
         std::cout << std::endl;
     }
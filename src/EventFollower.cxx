@@ -0,0 +1,163 @@
+#include "EventFollower.h"
+
+// HPS
+#include "EventIndex.h"
+
+// C++ standard library
+#include <stdexcept>
+#ifdef HAVE_INOTIFY
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace hps {
+
+    EventFollower::EventFollower(EventIndex* index, int pollMillis) :
+            Logger("EventFollower"),
+            index_(index),
+            pollMillis_(pollMillis) {
+        if (pollMillis_ <= 0) {
+            throw std::runtime_error("Poll period of followed files must be positive.");
+        }
+    }
+
+    EventFollower::~EventFollower() {
+        stop();
+    }
+
+    void EventFollower::setExcludedCollections(const std::set<std::string>& names,
+                                               const std::set<std::string>& types) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        excludeCollectionNames_ = names;
+        excludeCollectionTypes_ = types;
+    }
+
+    void EventFollower::start() {
+        if (worker_.joinable()) {
+            return;
+        }
+        log(INFO) << "Following " << index_->getNumberOfFiles() << " files" << std::endl;
+        stop_ = false;
+        appended_ = 0;
+        openWatches();
+        worker_ = std::thread(&EventFollower::run, this);
+    }
+
+    void EventFollower::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+            newest_.reset();
+            newestIndex_ = -1;
+        }
+        cond_.notify_all();
+        if (worker_.joinable()) {
+            worker_.join();
+            HPS_LOG(FINE) << "Stopped follower worker" << std::endl;
+        }
+        closeWatches();
+    }
+
+    bool EventFollower::isActive() {
+        return worker_.joinable();
+    }
+
+    std::shared_ptr<const EventStore> EventFollower::takeNewest(int& i, TimePoint& changed) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::shared_ptr<const EventStore> store;
+        store.swap(newest_);
+        i = newestIndex_;
+        changed = newestChanged_;
+        return store;
+    }
+
+    int EventFollower::getNumberOfAppended() {
+        return appended_;
+    }
+
+    void EventFollower::run() {
+        while (wait()) {
+            TimePoint changed = std::chrono::steady_clock::now();
+            try {
+                int added = index_->update([this, changed](int i, EVENT::LCEvent* event) {
+                    std::set<std::string> names;
+                    std::set<std::string> types;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        names = excludeCollectionNames_;
+                        types = excludeCollectionTypes_;
+                    }
+                    std::shared_ptr<EventStore> store = std::make_shared<EventStore>();
+                    store->decode(event, names, types);
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    newest_ = store;
+                    newestIndex_ = i;
+                    newestChanged_ = changed;
+                });
+                if (added > 0) {
+                    appended_ += added;
+                    HPS_LOG(FINE) << "Appended " << added << " events, newest is "
+                            << index_->getNumberOfEvents() - 1 << std::endl;
+                }
+            } catch (std::exception& e) {
+                log(ERROR) << "Failed to follow files: " << e.what() << std::endl;
+            }
+        }
+    }
+
+    bool EventFollower::wait() {
+#ifdef HAVE_INOTIFY
+        if (watchFd_ >= 0) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stop_) {
+                    return false;
+                }
+            }
+
+            // Changes are drained at once, as the files are checked for all of them.
+            struct pollfd pfd;
+            pfd.fd = watchFd_;
+            pfd.events = POLLIN;
+            if (::poll(&pfd, 1, pollMillis_) > 0 && (pfd.revents & POLLIN) != 0) {
+                char buf[4096];
+                while (::read(watchFd_, buf, sizeof(buf)) > 0) {
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            return !stop_;
+        }
+#endif
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait_for(lock, std::chrono::milliseconds(pollMillis_), [this]() { return stop_; });
+        return !stop_;
+    }
+
+    void EventFollower::openWatches() {
+#ifdef HAVE_INOTIFY
+        watchFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (watchFd_ < 0) {
+            log(WARNING) << "Failed to watch files, polling every " << pollMillis_ << " ms" << std::endl;
+            return;
+        }
+        for (int f = 0; f < index_->getNumberOfFiles(); f++) {
+            if (inotify_add_watch(watchFd_, index_->getFile(f).c_str(), IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+                log(WARNING) << "Failed to watch file: " << index_->getFile(f) << std::endl;
+            }
+        }
+        HPS_LOG(FINE) << "Watching files with inotify" << std::endl;
+#else
+        HPS_LOG(FINE) << "Polling files every " << pollMillis_ << " ms" << std::endl;
+#endif
+    }
+
+    void EventFollower::closeWatches() {
+#ifdef HAVE_INOTIFY
+        if (watchFd_ >= 0) {
+            ::close(watchFd_);
+            watchFd_ = -1;
+        }
+#endif
+    }
+}
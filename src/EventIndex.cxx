@@ -0,0 +1,521 @@
+#include "EventIndex.h"
+
+// HPS
+#include "FileCache.h"
+#include "LcioLock.h"
+
+// LCIO
+#include "EVENT/LCCollection.h"
+#include "EVENT/LCEvent.h"
+#include "EVENT/LCIO.h"
+#include "IOIMPL/LCFactory.h"
+
+// C++ standard library
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace hps {
+
+    // Version of the index file format, which is rebuilt if this changes.
+    static const int INDEX_VERSION = 1;
+
+    EventIndex::EventIndex(FileCache* cache, const std::vector<std::string>& lcioFiles) :
+            Logger("EventIndex"),
+            cache_(cache) {
+        for (std::vector<std::string>::const_iterator it = lcioFiles.begin();
+                it != lcioFiles.end(); it++) {
+            FileInfo info;
+            char resolved[PATH_MAX];
+            info.path = realpath(it->c_str(), resolved) != nullptr ? std::string(resolved) : *it;
+            files_.push_back(info);
+        }
+    }
+
+    EventIndex::~EventIndex() {
+        LcioLock lcioLock;
+        for (std::vector<FileInfo>::iterator it = files_.begin(); it != files_.end(); it++) {
+            if (it->tail != nullptr) {
+                it->tail->close();
+                delete it->tail;
+            }
+        }
+    }
+
+    void EventIndex::load() {
+
+        std::string indexPath = cache_->getCachedPath(getIndexName());
+
+        // Entries of files that were indexed before by path
+        std::map<std::string, FileInfo> cached;
+        if (cache_->isCached(getIndexName())) {
+            log("Reading event index: " + indexPath, INFO);
+            std::vector<FileInfo> files;
+            files.swap(files_);
+            if (read(indexPath)) {
+                for (std::vector<FileInfo>::iterator it = files_.begin(); it != files_.end(); it++) {
+                    cached[it->path] = *it;
+                }
+            } else {
+                log("Ignoring invalid event index: " + indexPath, WARNING);
+                collectionNames_.clear();
+                collectionIndex_.clear();
+            }
+            files_.swap(files);
+        }
+
+        bool changed = false;
+        for (size_t f = 0; f < files_.size(); f++) {
+            FileInfo& info = files_[f];
+            if (!stat(info.path, info.size, info.mtime)) {
+                throw std::runtime_error("Failed to stat LCIO file: " + info.path);
+            }
+            std::map<std::string, FileInfo>::iterator fnd = cached.find(info.path);
+            if (fnd != cached.end() && fnd->second.size == info.size && fnd->second.mtime == info.mtime) {
+                HPS_LOG(FINE) << "Using index of unchanged file: " << info.path << std::endl;
+                info.detector = fnd->second.detector;
+                info.entries.swap(fnd->second.entries);
+            } else {
+                indexFile(info);
+                changed = true;
+            }
+            for (size_t e = 0; e < info.entries.size(); e++) {
+                info.entries[e].file = f;
+                addPosition(f, e);
+            }
+        }
+
+        if (changed) {
+            log("Writing event index: " + indexPath, INFO);
+            write(indexPath);
+        }
+
+        log(INFO) << "Indexed " << events_.size() << " events in "
+                << files_.size() << " files" << std::endl;
+    }
+
+    void EventIndex::indexFile(FileInfo& info) {
+
+        log("Indexing LCIO file: " + info.path, INFO);
+
+        long long end = 0;
+        std::vector<long long> offsets = scanEventRecords(info.path, 0, &end);
+        HPS_LOG(FINE) << "Found " << offsets.size() << " event records in SIO framing" << std::endl;
+
+        info.entries.clear();
+
+        LcioLock lcioLock;
+        IO::LCReader* reader = IOIMPL::LCFactory::getInstance()->createLCReader();
+        reader->open(info.path);
+        EVENT::LCEvent* event = nullptr;
+        while ((event = reader->readNextEvent()) != nullptr) {
+            long long offset = info.entries.size() < offsets.size() ? offsets[info.entries.size()] : -1;
+            Entry entry = createEntry(event, offset);
+            if (info.detector.empty()) {
+                info.detector = event->getDetectorName();
+            }
+            info.entries.push_back(entry);
+            if (info.entries.size() % 1000 == 0) {
+                log(INFO) << "Indexed " << info.entries.size() << " events" << std::endl;
+            }
+        }
+        reader->close();
+        delete reader;
+
+        if (offsets.size() != info.entries.size()) {
+            log(WARNING) << "Number of event records " << offsets.size()
+                    << " does not match number of events " << info.entries.size() << std::endl;
+        } else {
+            info.scanned = end;
+        }
+
+        log(INFO) << "Done indexing " << info.entries.size() << " events" << std::endl;
+    }
+
+    EventIndex::Entry EventIndex::createEntry(EVENT::LCEvent* event, long long offset) {
+        Entry entry;
+        entry.offset = offset;
+        entry.run = event->getRunNumber();
+        entry.event = event->getEventNumber();
+        const std::vector<std::string>* collNames = event->getCollectionNames();
+        for (std::vector<std::string>::const_iterator it = collNames->begin();
+                it != collNames->end(); it++) {
+            size_t idx = getCollectionIndex(*it);
+            if (entry.sizes.size() <= idx) {
+                entry.sizes.resize(idx + 1, -1);
+            }
+            entry.sizes[idx] = event->getCollection(*it)->getNumberOfElements();
+        }
+        return entry;
+    }
+
+    int EventIndex::update(const AppendFunction& appended) {
+        int added = 0;
+        for (size_t f = 0; f < files_.size(); f++) {
+            FileInfo& info = files_[f];
+            long long size = -1;
+            long long mtime = -1;
+            if (!stat(info.path, size, mtime)) {
+                continue;
+            }
+
+            // The files are only scanned without the lock, since the index may be
+            // read or written from other threads meanwhile.
+            long long last = -1;
+            long long scanned = -1;
+            {
+                std::lock_guard<std::recursive_mutex> lock(mutex_);
+                if (size == info.size) {
+                    continue;
+                }
+                if (size < info.size) {
+                    log(WARNING) << "File was truncated and is not followed: " << info.path << std::endl;
+                    info.size = size;
+                    continue;
+                }
+
+                // Events of a cached index are scanned again from the last one.
+                last = info.entries.empty() ? -1 : info.entries.back().offset;
+                if (info.scanned < 0) {
+                    if (!info.entries.empty() && last < 0) {
+                        log(WARNING) << "Offsets of events are unknown, so file is not followed: "
+                                << info.path << std::endl;
+                        info.size = size;
+                        continue;
+                    }
+                    info.scanned = last < 0 ? 0 : last;
+                }
+                scanned = info.scanned;
+            }
+            long long end = scanned;
+            std::vector<long long> offsets = scanEventRecords(info.path, scanned, &end);
+            offsets.erase(std::remove_if(offsets.begin(), offsets.end(), [last](long long offset) {
+                return offset <= last;
+            }), offsets.end());
+            {
+                std::lock_guard<std::recursive_mutex> lock(mutex_);
+                info.scanned = end;
+                info.size = size;
+                info.mtime = mtime;
+            }
+            if (offsets.size() > 0) {
+                HPS_LOG(FINE) << "Found " << offsets.size() << " appended events in: " << info.path << std::endl;
+                added += appendEvents(f, offsets, appended);
+            }
+        }
+        return added;
+    }
+
+    int EventIndex::appendEvents(int f, const std::vector<long long>& offsets, const AppendFunction& appended) {
+        FileInfo& info = files_[f];
+        LcioLock lcioLock;
+
+        // The reader only reads complete events, so it normally does not reach the end
+        // of the file and can go on once more are written. Otherwise it is opened again.
+        bool reopened = false;
+        if (info.tail == nullptr) {
+            openTail(info);
+            reopened = true;
+        }
+
+        int added = 0;
+        EVENT::LCEvent* event = nullptr;
+        for (size_t n = 0; n < offsets.size(); n++) {
+            event = info.tail->readNextEvent();
+            if (event == nullptr && !reopened) {
+                HPS_LOG(FINE) << "Reopening reader of appended events: " << info.path << std::endl;
+                openTail(info);
+                reopened = true;
+                event = info.tail->readNextEvent();
+            }
+            if (event == nullptr) {
+                log(ERROR) << "Failed to read appended event at offset " << offsets[n]
+                        << " of: " << info.path << std::endl;
+
+                // The remaining events are scanned and read again on the next update,
+                // even if the file does not change anymore.
+                {
+                    std::lock_guard<std::recursive_mutex> lock(mutex_);
+                    info.scanned = offsets[n];
+                    info.size = -1;
+                }
+                info.tail->close();
+                delete info.tail;
+                info.tail = nullptr;
+                break;
+            }
+            Entry entry = createEntry(event, offsets[n]);
+            entry.file = f;
+            std::lock_guard<std::recursive_mutex> lock(mutex_);
+            if (info.detector.empty()) {
+                info.detector = event->getDetectorName();
+            }
+            info.entries.push_back(entry);
+            addPosition(f, info.entries.size() - 1);
+            added++;
+        }
+        // After a failed read the reader was deleted with the last event it read,
+        // so the events appended before are only shown once the rest are read.
+        if (added > 0 && event != nullptr && appended) {
+            appended(getNumberOfEvents() - 1, event);
+        }
+        return added;
+    }
+
+    void EventIndex::openTail(FileInfo& info) {
+        if (info.tail != nullptr) {
+            info.tail->close();
+            delete info.tail;
+        }
+        info.tail = IOIMPL::LCFactory::getInstance()->createLCReader();
+        info.tail->open(info.path);
+        if (info.entries.size() > 0) {
+            HPS_LOG(FINE) << "Skipping " << info.entries.size() << " indexed events of: " << info.path << std::endl;
+            info.tail->skipNEvents(info.entries.size());
+        }
+    }
+
+    std::vector<long long> EventIndex::scanEventRecords(const std::string& path, long long from, long long* end) {
+
+        // An SIO record starts with a header of big-endian words: header length,
+        // record marker, options, data length, uncompressed length and name length,
+        // followed by the name and the data, each padded to 4 bytes.
+        static const unsigned int RECORD_MARKER = 0xabadcafe;
+        static const std::string EVENT_HEADER("LCEventHeader");
+        static const std::string EVENT_DATA("LCEvent");
+
+        std::vector<long long> offsets;
+        if (end != nullptr) {
+            *end = from;
+        }
+        long long size = -1;
+        long long mtime = -1;
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr || !stat(path, size, mtime)) {
+            if (file != nullptr) {
+                fclose(file);
+            }
+            return offsets;
+        }
+
+        // An event is complete once the data record after its header was written.
+        long long offset = from;
+        long long header = -1;
+        unsigned char buf[24];
+        while (fseeko(file, offset, SEEK_SET) == 0 && fread(buf, 1, 24, file) == 24) {
+            unsigned int words[6];
+            for (int i = 0; i < 6; i++) {
+                words[i] = (buf[4 * i] << 24) | (buf[4 * i + 1] << 16) | (buf[4 * i + 2] << 8) | buf[4 * i + 3];
+            }
+            unsigned int headLength = words[0];
+            unsigned int dataLength = words[3];
+            unsigned int nameLength = words[5];
+            if (words[1] != RECORD_MARKER || headLength < 24 || nameLength > headLength - 24) {
+                // Not a record boundary, e.g. a truncated file.
+                break;
+            }
+            std::string name(nameLength, '\0');
+            if (nameLength > 0 && fread(&name[0], 1, nameLength, file) != nameLength) {
+                break;
+            }
+            long long next = offset + headLength + ((dataLength + 3) & ~3u);
+            if (next > size) {
+                // The record is still being written.
+                break;
+            }
+            if (name == EVENT_HEADER) {
+                header = offset;
+            } else if (name == EVENT_DATA && header >= 0) {
+                offsets.push_back(header);
+                header = -1;
+            }
+            offset = next;
+            if (end != nullptr && header < 0) {
+                *end = offset;
+            }
+        }
+
+        fclose(file);
+        return offsets;
+    }
+
+    bool EventIndex::read(const std::string& path) {
+        std::ifstream in(path.c_str());
+        std::string magic;
+        int version = -1;
+        in >> magic >> version;
+        if (magic != "hps-eve-index" || version != INDEX_VERSION) {
+            return false;
+        }
+
+        std::string tag;
+        size_t nColls = 0;
+        in >> tag >> nColls;
+        if (tag != "collections") {
+            return false;
+        }
+        for (size_t i = 0; i < nColls && in.good(); i++) {
+            std::string name;
+            in >> name;
+            getCollectionIndex(name);
+        }
+
+        size_t nFiles = 0;
+        in >> tag >> nFiles;
+        if (tag != "files") {
+            return false;
+        }
+        for (size_t f = 0; f < nFiles && in.good(); f++) {
+            FileInfo info;
+            size_t nEvents = 0;
+            in >> tag >> info.size >> info.mtime >> nEvents >> info.detector;
+            in >> std::ws;
+            std::getline(in, info.path);
+            if (tag != "file") {
+                return false;
+            }
+            info.entries.resize(nEvents);
+            for (size_t e = 0; e < nEvents && in.good(); e++) {
+                Entry& entry = info.entries[e];
+                size_t nSizes = 0;
+                in >> entry.offset >> entry.run >> entry.event >> nSizes;
+                entry.sizes.resize(nSizes);
+                for (size_t s = 0; s < nSizes; s++) {
+                    in >> entry.sizes[s];
+                }
+            }
+            files_.push_back(info);
+        }
+        return !in.fail();
+    }
+
+    void EventIndex::write(const std::string& path) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+        // Write to a temporary file first so an interrupted write does not leave a bad index.
+        std::string tmpPath = path + ".tmp";
+        std::ofstream out(tmpPath.c_str());
+        out << "hps-eve-index " << INDEX_VERSION << "\n";
+        out << "collections " << collectionNames_.size() << "\n";
+        for (std::vector<std::string>::iterator it = collectionNames_.begin();
+                it != collectionNames_.end(); it++) {
+            out << *it << "\n";
+        }
+        out << "files " << files_.size() << "\n";
+        for (std::vector<FileInfo>::iterator it = files_.begin(); it != files_.end(); it++) {
+            out << "file " << it->size << " " << it->mtime << " " << it->entries.size() << " "
+                    << (it->detector.empty() ? "-" : it->detector) << "\n" << it->path << "\n";
+            for (std::deque<Entry>::iterator e = it->entries.begin(); e != it->entries.end(); e++) {
+                out << e->offset << " " << e->run << " " << e->event << " " << e->sizes.size();
+                for (std::vector<int>::iterator s = e->sizes.begin(); s != e->sizes.end(); s++) {
+                    out << " " << *s;
+                }
+                out << "\n";
+            }
+        }
+        out.close();
+        if (out.fail() || rename(tmpPath.c_str(), path.c_str()) != 0) {
+            log("Failed to write event index: " + path, ERROR);
+        }
+    }
+
+    int EventIndex::getNumberOfEvents() {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        return events_.size();
+    }
+
+    const EventIndex::Entry& EventIndex::getEntry(int i) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        const std::pair<int, int>& pos = events_.at(i);
+        return files_[pos.first].entries[pos.second];
+    }
+
+    int EventIndex::find(int run, int event) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        std::map<std::pair<int, int>, int>::iterator fnd = positions_.find(std::make_pair(run, event));
+        return fnd != positions_.end() ? fnd->second : -1;
+    }
+
+    void EventIndex::addPosition(int f, int e) {
+        const Entry& entry = files_[f].entries[e];
+        events_.push_back(std::make_pair(f, e));
+
+        // The first of events with the same numbers is found.
+        positions_.insert(std::make_pair(std::make_pair(entry.run, entry.event), (int) events_.size() - 1));
+    }
+
+    const std::string& EventIndex::getFile(int file) {
+        return files_.at(file).path;
+    }
+
+    int EventIndex::getNumberOfFiles() {
+        return files_.size();
+    }
+
+    std::string EventIndex::getDetectorName() {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        for (std::vector<FileInfo>::iterator it = files_.begin(); it != files_.end(); it++) {
+            if (!it->detector.empty() && it->detector != "-") {
+                return it->detector;
+            }
+        }
+        return std::string();
+    }
+
+    std::vector<std::string> EventIndex::getCollectionNames() {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        return collectionNames_;
+    }
+
+    int EventIndex::getCollectionSize(int i, const std::string& collectionName) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        std::map<std::string, int>::iterator fnd = collectionIndex_.find(collectionName);
+        if (fnd == collectionIndex_.end()) {
+            return -1;
+        }
+        const Entry& entry = getEntry(i);
+        return fnd->second < (int) entry.sizes.size() ? entry.sizes[fnd->second] : -1;
+    }
+
+    int EventIndex::getCollectionIndex(const std::string& collectionName) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        std::map<std::string, int>::iterator fnd = collectionIndex_.find(collectionName);
+        if (fnd != collectionIndex_.end()) {
+            return fnd->second;
+        }
+        collectionNames_.push_back(collectionName);
+        collectionIndex_[collectionName] = collectionNames_.size() - 1;
+        return collectionNames_.size() - 1;
+    }
+
+    std::string EventIndex::getIndexName() {
+        // FNV-1a hash of the file list, which is stable between runs unlike std::hash.
+        unsigned long long hash = 14695981039346656037ULL;
+        for (std::vector<FileInfo>::iterator it = files_.begin(); it != files_.end(); it++) {
+            std::string path = it->path + "\n";
+            for (size_t i = 0; i < path.size(); i++) {
+                hash ^= (unsigned char) path[i];
+                hash *= 1099511628211ULL;
+            }
+        }
+        std::stringstream ss;
+        ss << "events_" << std::hex << std::setw(16) << std::setfill('0') << hash << ".index";
+        return ss.str();
+    }
+
+    bool EventIndex::stat(const std::string& path, long long& size, long long& mtime) {
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0) {
+            return false;
+        }
+        size = st.st_size;
+        mtime = st.st_mtime;
+        return true;
+    }
+}
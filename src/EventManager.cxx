@@ -1,11 +1,27 @@
 #include "EventManager.h"
 
 // HPS
+#include "CutCompiler.h"
 #include "DetectorGeometry.h"
 #include "EventDisplay.h"
-
-// LCIO
-#include "IOIMPL/LCFactory.h"
+#include "EventFollower.h"
+#include "EventIndex.h"
+#include "EventPrebuilder.h"
+#include "EventReadAhead.h"
+#include "EventSkim.h"
+#include "LCObjectUserData.h"
+#include "SceneCache.h"
+#include "StageTimer.h"
+
+// ROOT
+#include "TEveSelection.h"
+
+// C++ standard library
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <thread>
 
 ClassImp(hps::EventManager);
 
@@ -14,135 +30,358 @@ namespace hps {
     EventManager::EventManager(EventDisplay* app) :
             Logger("EventManager"),
             TEveEventManager("HPS Event Manager", ""),
-            reader_(nullptr),
-            event_(new EventObjects(app)),
+            event_(new EventObjects(app->getDetectorGeometry(), app->getPropagatorRegistry(),
+                                    app->getBuildThreads())),
             app_(app) {
 
+        event_->setExcludedCollections(app_->getExcludeCollectionNames(), app_->getExcludeCollectionTypes());
+        event_->setMCDetail(app_->getMCMinEnergy(), app_->getMCMaxDepth(), app_->getMCMaxParticles());
+
         // Set log level from main application.
         setLogLevel(app_->getLogLevel());
         event_->setLogLevel(getLogLevel());
     }
 
     EventManager::~EventManager() {
+        delete detectorTimer_;
+        delete loadTimer_;
+        delete autoPlayTimer_;
+        delete prebuilder_;
+        delete followTimer_;
+        delete follower_;
+        delete timingTimer_;
+        delete skimTimer_;
+        delete skim_;
+        delete skimCompiler_;
+        delete sceneCache_;
+        delete readAhead_;
+        delete index_;
         delete event_;
     }
 
     void EventManager::Open() {
 
-        // Open the LCIO reader.
-
-        log("Opening reader... ", INFO);
-
-        reader_ = IOIMPL::LCFactory::getInstance()->createLCReader(IO::LCReader::directAccess);
-        reader_->open(app_->getLcioFiles());
-        auto runHeader = reader_->readNextRunHeader();
-        std::string detName;
-
-        if (runHeader != nullptr) {
-            // Get run number and detector name from run header that was found.
-            // We are assuming run header was first record and reader does not need to be reset.
-            runNumber_ = runHeader->getRunNumber();
-            detName = runHeader->getDetectorName();
-        } else if (runHeader == nullptr) {
-            // Get run number and detector name from first event in file, as no run header was found.
-            // Then reset the reader by closing and reopening it.
-            log("Setting run number from first event ...");
-
-            auto event = reader_->readNextEvent();
-            runNumber_ = event->getRunNumber();
-            detName = event->getDetectorName();
-            reader_->close();
-            reader_->open(app_->getLcioFiles());
-            log("Done setting run number from first event!");
-
-        }
-        if (runNumber_ < 0) {
-            // Run number was not found or it is invalid.
-            // This could break random IO with the reader but continue anyways.
-            log("Run number was not set!", ERROR);
-        } else {
-            log(INFO) << "Run number set to: " << runNumber_ << std::endl;
+        // Load the event index, which reads the files only if they were not indexed before.
+
+        log("Opening event index... ", INFO);
+
+        index_ = new EventIndex(app_->getFileCache(), app_->getLcioFiles());
+        index_->setLogLevel(getLogLevel());
+        index_->load();
+        if (index_->getNumberOfEvents() == 0) {
+            log("No events found in LCIO files!", ERROR);
+            throw std::runtime_error("No events found in LCIO files!");
+        }
+        std::string detName = index_->getDetectorName();
+
+        log("Done opening event index!", INFO);
+
+        // Titles are only created for elements the user looks at.
+        TEveManager* eve = app_->getEveManager();
+        eve->GetHighlight()->Connect("SelectionAdded(TEveElement*)",
+                "hps::EventManager", this, "updateElementTitle(TEveElement*)");
+        eve->GetSelection()->Connect("SelectionAdded(TEveElement*)",
+                "hps::EventManager", this, "updateElementTitle(TEveElement*)");
+
+        // Collapsed MCParticles are only built when their parent is selected.
+        eve->GetSelection()->Connect("SelectionAdded(TEveElement*)",
+                "hps::EventManager", this, "expandElement(TEveElement*)");
+
+        // Create the scene cache if enabled.
+        if (app_->getSceneCacheSize() > 0) {
+            log(INFO) << "Scene cache limit: " << app_->getSceneCacheSize() << " MB" << std::endl;
+            sceneCache_ = new SceneCache((size_t) app_->getSceneCacheSize() * 1024 * 1024);
+            sceneCache_->setLogLevel(getLogLevel());
         }
-        log("Done opening reader!", INFO);
+
+        // The skim scans on the build threads, or one per core if there are none.
+        int skimThreads = app_->getBuildThreads() > 0 ?
+                app_->getBuildThreads() : std::max(1, (int) std::thread::hardware_concurrency());
+        skim_ = new EventSkim(index_, skimThreads);
+        skim_->setLogLevel(getLogLevel());
+        skim_->setExcludedCollections(app_->getExcludeCollectionNames(), app_->getExcludeCollectionTypes());
+        skimCompiler_ = new CutCompiler();
+        skimCompiler_->setLogLevel(getLogLevel());
+        skimTimer_ = new TTimer(250);
+        skimTimer_->Connect("Timeout()", "hps::EventManager", this, "updateSkimStatus()");
+
+        // Heavy collections are built in slices between the events of the GUI.
+        loadTimer_ = new TTimer(10);
+        loadTimer_->Connect("Timeout()", "hps::EventManager", this, "continueLoading()");
+
+        // Timings are shown while they are enabled in the GUI.
+        timingTimer_ = new TTimer(1000);
+        timingTimer_->Connect("Timeout()", "hps::EventManager", this, "updateTimingStatus()");
+
+        // Events are read through the read ahead, which only starts a worker if enabled.
+        readAhead_ = new EventReadAhead(index_, app_->getReadAheadDepth());
+        readAhead_->setLogLevel(getLogLevel());
+        readAhead_->setExcludedCollections(app_->getExcludeCollectionNames(), app_->getExcludeCollectionTypes());
+        readAhead_->setStepFunction([this](int i, int dir) {
+            if (!skim_->isActive()) {
+                return i + dir;
+            }
+            return dir > 0 ? skim_->next(i) : skim_->previous(i);
+        });
+        readAhead_->start();
+
+        // Auto play builds the next event on a worker with its own builder.
+        prebuilder_ = new EventPrebuilder(readAhead_, app_->getDetectorGeometry(), app_->getMagFieldY());
+        prebuilder_->setLogLevel(getLogLevel());
+        prebuilder_->setExcludedCollections(app_->getExcludeCollectionNames(), app_->getExcludeCollectionTypes());
+        prebuilder_->setMCDetail(app_->getMCMinEnergy(), app_->getMCMaxDepth(), app_->getMCMaxParticles());
+        autoPlayTimer_ = new TTimer(10);
+        autoPlayTimer_->Connect("Timeout()", "hps::EventManager", this, "autoPlayStep()");
+
+        // Follow mode decodes the newest appended event on a worker.
+        follower_ = new EventFollower(index_);
+        follower_->setLogLevel(getLogLevel());
+        follower_->setExcludedCollections(app_->getExcludeCollectionNames(), app_->getExcludeCollectionTypes());
+        followTimer_ = new TTimer(100);
+        followTimer_->Connect("Timeout()", "hps::EventManager", this, "followStep()");
+        knownEvents_ = index_->getNumberOfEvents();
 
         // Initialize the detector geometry if this has not been done already.
         if (!app_->getDetectorGeometry()->isInitialized()) {
             if (detName.size()) {
-                app_->getDetectorGeometry()->loadDetector(detName);
+                // The GUI is built while the detector files are fetched.
+                detName_ = detName;
+                detectorFetch_ = app_->getDetectorGeometry()->fetchDetector(detName);
+                detectorTimer_ = new TTimer(250);
+                detectorTimer_->Connect("Timeout()", "hps::EventManager", this, "checkDetector()");
+                detectorTimer_->TurnOn();
             } else {
                 // No detector name was found to load geometry so crash the application.
                 log("Failed to get detector name from LCIO file!", ERROR);
+                LogHandler::drainAll();
                 throw std::runtime_error("Failed to get detector name from LCIO file!");
             }
+        } else {
+            // Crystals of calorimeter hits are looked up from the build threads
+            // and the prebuilder.
+            app_->getDetectorGeometry()->setMaxThreads(app_->getBuildThreads() + 1);
         }
 
         LogHandler::flushAll();
     }
 
+    void EventManager::checkDetector() {
+        if (!app_->getDetectorGeometry()->isInitialized()
+                && detectorFetch_.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            if (loadDetector()) {
+                redraw();
+            }
+        }
+    }
+
+    bool EventManager::loadDetector() {
+        DetectorGeometry* det = app_->getDetectorGeometry();
+        if (det->isInitialized()) {
+            return true;
+        }
+        detectorTimer_->TurnOff();
+        if (detectorFetch_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            log("Waiting for detector files: " + detName_, INFO);
+        }
+        try {
+            det->loadDetector(detName_);
+        } catch (std::exception& e) {
+            log(ERROR) << "Failed to load detector " << detName_ << ": " << e.what() << std::endl;
+            LogHandler::flushAll();
+            return false;
+        }
+
+        // Crystals of calorimeter hits are looked up from the build threads
+        // and the prebuilder.
+        det->setMaxThreads(app_->getBuildThreads() + 1);
+        return true;
+    }
+
+    int EventManager::getNumberOfEvents() {
+        return index_->getNumberOfEvents();
+    }
+
     void EventManager::NextEvent() {
-        GotoEvent(eventNum_ + 1);
+        HPS_LOG(FINE) << "NextEvent" << std::endl;
+        if (skim_->isActive()) {
+            int next = skim_->next(eventNum_);
+            if (next >= 0) {
+                GotoEvent(next);
+            } else {
+                log(WARNING) << "No later event passes the skim"
+                        << (skim_->isFinished() ? "!" : " yet!") << std::endl;
+            }
+        } else if (eventNum_ < getNumberOfEvents() - 1) {
+            GotoEvent(eventNum_ + 1);
+        } else {
+            log(WARNING) << "Already at last event!" << std::endl;
+        }
+    }
+
+    void EventManager::loadEvent(std::shared_ptr<const EventStore> store) {
+
+        // Put away previous event and load the next one.
+        stashEvent();
+        {
+            StageTimer::Span span("build");
+            event_->startBuild(app_->getEveManager(), store);
+        }
+
+        // Elements of the heavy collections are cut as they are added.
+        applyCuts();
+        if (event_->isBuilding()) {
+            HPS_LOG(FINE) << "Building heavy collections in the background" << std::endl;
+            loadTimer_->Start(10, kFALSE);
+        } else {
+            log("Done loading event!");
+        }
+    }
+
+    void EventManager::continueLoading() {
+        TEveElementList* added = nullptr;
+        {
+            // Each slice takes about 30 ms, after which the GUI handles its events.
+            StageTimer::Span span("build slice");
+            added = event_->buildNext(app_->getEveManager(), 0.03);
+        }
+        if (!event_->isBuilding()) {
+            loadTimer_->Stop();
+            log("Done loading event!");
+        }
+        if (added != nullptr) {
+            redraw();
+        }
+    }
+
+    void EventManager::stashEvent() {
+        TEveEventManager* current = app_->getEveManager()->GetCurrentEvent();
+
+        // A partly loaded event is not cached, so its pending work is dropped.
+        bool loading = event_->isBuilding();
+        if (loading) {
+            HPS_LOG(FINE) << "Cancelling loading of event: " << eventNum_ << std::endl;
+            loadTimer_->Stop();
+            event_->cancelBuild();
+        }
+        if (sceneCache_ == nullptr || eventNum_ < 0 || loading || current->NumChildren() == 0) {
+            current->DestroyElements();
+            return;
+        }
+        HPS_LOG(FINE) << "Caching scene for event: " << eventNum_ << std::endl;
+        SceneCache::Scene* scene = new SceneCache::Scene();
+        for (TEveElement::List_i it = current->BeginChildren(); it != current->EndChildren(); it++) {
+            TEveElement* element = *it;
+            element->IncDenyDestroy();
+            scene->elements.push_back(element);
+            scene->size += SceneCache::estimateSize(element);
+        }
+        current->RemoveElements();
+
+        // The elements keep the store of the event for their titles.
+        scene->store = event_->getStore();
+        if (scene->store != nullptr) {
+            scene->size += scene->store->getSize();
+        }
+        scene->typeMap = event_->getTypeMap();
+        scene->cutTables = event_->getCutTables();
+        const EventIndex::Entry& entry = index_->getEntry(eventNum_);
+        sceneCache_->put(SceneCache::Key(entry.run, entry.event), scene);
+    }
+
+    void EventManager::restoreEvent(Int_t i) {
+        StageTimer::Span span("restore");
+        stashEvent();
+        HPS_LOG(FINE) << "Restoring cached scene for event: " << i << std::endl;
+        const EventIndex::Entry& entry = index_->getEntry(i);
+        showScene(sceneCache_->take(SceneCache::Key(entry.run, entry.event)));
     }
 
-    void EventManager::loadEvent(EVENT::LCEvent* event) {
+    void EventManager::showScene(SceneCache::Scene* scene) {
+        TEveEventManager* current = app_->getEveManager()->GetCurrentEvent();
+        for (std::vector<TEveElement*>::iterator it = scene->elements.begin();
+                it != scene->elements.end(); it++) {
+            current->AddElement(*it);
+            (*it)->DecDenyDestroy();
+        }
+        event_->setTypeMap(scene->typeMap);
+        event_->setCutTables(scene->cutTables);
+        event_->setStore(scene->store);
+        event_->recordCounts();
+        delete scene;
+
+        // Cut values may have changed while the event was cached or prebuilt.
+        applyCuts();
+    }
 
-        // Destroy previous event and load the next one.
-        app_->getEveManager()->GetCurrentEvent()->DestroyElements();
-        log() << "Loading LCIO event: " << event->getEventNumber() << std::endl;
-        event_->build(app_->getEveManager(), event);
-        log("Done loading event!");
+    void EventManager::applyCuts() {
+        StageTimer::Span span("cuts");
+        event_->setMCPCut(app_->getMCPCut());
+        event_->setTrackPCut(app_->getTrackPCut());
+        event_->setChi2Cut(app_->getChi2Cut());
+        event_->setCutExpression(app_->getCutExpression());
     }
 
     void EventManager::GotoEvent(Int_t i) {
 
         log(INFO) << "GotoEvent: " << i << std::endl;
 
-        if (i < 0) {
+        // Manual navigation takes over from auto play and follow mode.
+        stopAutoPlay();
+        stopFollow();
+
+        StageTimer::Span span("goto");
+
+        // Events cannot be built without the detector.
+        if (!loadDetector()) {
+            return;
+        }
+
+        if (i < 0 || i >= index_->getNumberOfEvents()) {
             log(ERROR) << "Event number is not valid: " << i << std::endl;
             return;
         } else if (i == eventNum_) {
             log(ERROR) << "Event is already loaded: " << i << std::endl;
             return;
         }
-        EVENT::LCEvent* event = nullptr;
-        if (i == (eventNum_ + 1)) {
 
-            log(FINE) << "Reading next event" << std::endl;
+        const EventIndex::Entry& entry = index_->getEntry(i);
+        HPS_LOG(FINE) << "Event " << i << " has run " << entry.run
+                << " and event number " << entry.event << std::endl;
 
-            try {
-                event = reader_->readNextEvent();
-            } catch (IO::IOException& ioe) {
-                log(ERROR) << ioe.what() << std::endl;
-            } catch (std::exception& e) {
-                log(ERROR) << e.what() << std::endl;
-            }
-        } else {
-            log(FINER) << "Seeking event " << i
-                    << " with run number " << runNumber_ << std::endl;
-            try {
-                event = reader_->readEvent(runNumber_, i);
-                if (event == nullptr) {
-                    log(ERROR) << "Seeking failed!" << std::endl;
-                }
-            } catch (IO::IOException& ioe) {
-                log(ERROR) << ioe.what() << std::endl;
-            } catch (std::exception& e) {
-                log(ERROR) << e.what() << std::endl;
-            }
+        // Swap in the cached scene without reading the event again.
+        if (sceneCache_ != nullptr && sceneCache_->contains(SceneCache::Key(entry.run, entry.event))) {
+            restoreEvent(i);
+            readAhead_->skip(i);
+            eventNum_ = i;
+            redraw();
+            LogHandler::flushAll();
+            return;
         }
-        if (event != nullptr) {
-            loadEvent(event);
+
+        std::shared_ptr<const EventStore> store = readAhead_->take(i);
+        if (store != nullptr) {
+            log() << "Loading event: " << i << std::endl;
+            loadEvent(store);
             eventNum_ = i;
         } else {
-            log(ERROR) << "Failed to read next event!" << std::endl;
+            log(ERROR) << "Failed to read event: " << i << std::endl;
         }
-        app_->getEveManager()->FullRedraw3D(false);
+        redraw();
 
         LogHandler::flushAll();
     }
 
     void EventManager::PrevEvent() {
-        log(FINE) << "PrevEvent" << std::endl;
-        if (eventNum_ > 0) {
+        HPS_LOG(FINE) << "PrevEvent" << std::endl;
+        if (skim_->isActive()) {
+            int previous = skim_->previous(eventNum_);
+            if (previous >= 0) {
+                GotoEvent(previous);
+            } else {
+                log(WARNING) << "No earlier event passes the skim"
+                        << (skim_->isFinished() ? "!" : " yet!") << std::endl;
+            }
+        } else if (eventNum_ > 0) {
             GotoEvent(eventNum_ - 1);
         } else {
             log(WARNING) << "Already at first event!" << std::endl;
@@ -150,8 +389,16 @@ namespace hps {
     }
 
     void EventManager::SetEventNumber() {
-        log(FINE) << "Set event number: " << app_->getCurrentEventNumber() << std::endl;
-        if (app_->getCurrentEventNumber() > -1) {
+        HPS_LOG(FINE) << "Set event number: " << app_->getCurrentEventNumber() << std::endl;
+        if (app_->getCurrentEventNumber() > -1 && skim_->isActive()) {
+            int next = skim_->next(app_->getCurrentEventNumber() - 1);
+            if (next >= 0) {
+                GotoEvent(next);
+            } else {
+                log(WARNING) << "No event from " << app_->getCurrentEventNumber()
+                        << " on passes the skim" << (skim_->isFinished() ? "!" : " yet!") << std::endl;
+            }
+        } else if (app_->getCurrentEventNumber() > -1) {
             GotoEvent(app_->getCurrentEventNumber());
         } else {
             log(ERROR) << "Event number is not valid: "
@@ -163,23 +410,393 @@ namespace hps {
     void EventManager::setLogLevel(int verbosity) {
         Logger::setLogLevel(verbosity);
         event_->setLogLevel(verbosity);
+        if (index_ != nullptr) {
+            index_->setLogLevel(verbosity);
+        }
+        if (readAhead_ != nullptr) {
+            readAhead_->setLogLevel(verbosity);
+        }
+        if (sceneCache_ != nullptr) {
+            sceneCache_->setLogLevel(verbosity);
+        }
+        if (prebuilder_ != nullptr) {
+            prebuilder_->setLogLevel(verbosity);
+        }
+        if (follower_ != nullptr) {
+            follower_->setLogLevel(verbosity);
+        }
+        if (skim_ != nullptr) {
+            skim_->setLogLevel(verbosity);
+            skimCompiler_->setLogLevel(verbosity);
+        }
     }
 
     void EventManager::modifyMCPCut() {
-        event_->setMCPCut(app_->getMCPCut());
-        app_->getEveManager()->FullRedraw3D(false);
+        {
+            StageTimer::Span span("cuts");
+            event_->setMCPCut(app_->getMCPCut());
+        }
+        redraw();
     }
 
     void EventManager::modifyTrackPCut() {
-        event_->setTrackPCut(app_->getTrackPCut());
-        app_->getEveManager()->FullRedraw3D(false);
+        {
+            StageTimer::Span span("cuts");
+            event_->setTrackPCut(app_->getTrackPCut());
+        }
+        redraw();
     }
 
     void EventManager::modifyChi2Cut() {
-        event_->setChi2Cut(app_->getChi2Cut());
+        {
+            StageTimer::Span span("cuts");
+            event_->setChi2Cut(app_->getChi2Cut());
+        }
+        redraw();
+    }
+
+    void EventManager::modifyCutExpression() {
+        {
+            StageTimer::Span span("cuts");
+            event_->setCutExpression(app_->getCutExpression());
+        }
+        redraw();
+    }
+
+    void EventManager::modifySkim() {
+        std::string expression = app_->getSkimExpression();
+        if (expression.find_first_not_of(" \t") == std::string::npos) {
+            log(INFO) << "Stopping skim" << std::endl;
+            skimTimer_->Stop();
+            skim_->clear();
+            app_->setSkimStatus("All events");
+            return;
+        }
+        CutTable::CutFunction selection = skimCompiler_->compile(expression, EventSkim::getVariableNames());
+        if (selection == nullptr) {
+            app_->setSkimStatus("Invalid selection");
+            return;
+        }
+        log(INFO) << "Starting skim: " << expression << std::endl;
+        skim_->start(selection);
+        skimTimer_->Start(250, kFALSE);
+        updateSkimStatus();
+    }
+
+    void EventManager::updateSkimStatus() {
+        int scanned = skim_->getNumberOfScanned();
+        int passed = skim_->getNumberOfPassed();
+        std::stringstream status;
+        status << "Passed " << passed << " of " << scanned;
+        if (!skim_->isFinished()) {
+            status << "/" << getNumberOfEvents();
+        }
+        if (scanned > 0) {
+            status << " (" << std::fixed << std::setprecision(2) << (100. * passed / scanned) << "%)";
+        }
+        app_->setSkimStatus(status.str());
+        if (skim_->isFinished()) {
+            skimTimer_->Stop();
+        }
+    }
+
+    void EventManager::toggleAutoPlay() {
+        if (!app_->isAutoPlayEnabled()) {
+            stopAutoPlay();
+            return;
+        }
+        if (autoPlaying_) {
+            return;
+        }
+        log(INFO) << "Starting auto play at " << app_->getAutoPlayRate() << " events/s" << std::endl;
+        autoPlaying_ = true;
+        autoPlayNext_ = -1;
+        modifyAutoPlayRate();
+        autoPlayTimer_->Start(10, kFALSE);
+    }
+
+    void EventManager::modifyAutoPlayRate() {
+        // The rates are measured again from here.
+        autoPlayStart_ = std::chrono::steady_clock::now();
+        nextFrame_ = autoPlayStart_;
+        framesShown_ = 0;
+        framesDropped_ = 0;
+        if (autoPlaying_) {
+            updateAutoPlayStatus();
+        }
+    }
+
+    void EventManager::stopAutoPlay() {
+        if (!autoPlaying_) {
+            return;
+        }
+        log(INFO) << "Stopping auto play" << std::endl;
+        autoPlayTimer_->Stop();
+        prebuilder_->cancel();
+        autoPlaying_ = false;
+        app_->setAutoPlayEnabled(false);
+        updateAutoPlayStatus();
+    }
+
+    void EventManager::prebuildNext(int i) {
+        if (skim_->isActive()) {
+            autoPlayNext_ = skim_->next(i);
+            if (autoPlayNext_ < 0) {
+                autoPlayNext_ = skim_->next(-1);
+            }
+        } else {
+            autoPlayNext_ = i < getNumberOfEvents() - 1 ? i + 1 : 0;
+        }
+        if (autoPlayNext_ < 0 || autoPlayNext_ == eventNum_) {
+            return;
+        }
+        const EventIndex::Entry& entry = index_->getEntry(autoPlayNext_);
+        if (sceneCache_ == nullptr || !sceneCache_->contains(SceneCache::Key(entry.run, entry.event))) {
+            prebuilder_->start(autoPlayNext_);
+        }
+    }
+
+    void EventManager::autoPlayStep() {
+        // Events are only built once the detector files were fetched.
+        if (!app_->getDetectorGeometry()->isInitialized()) {
+            modifyAutoPlayRate();
+            return;
+        }
+        if (autoPlayNext_ < 0 && !following_) {
+            prebuildNext(eventNum_);
+        }
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now < nextFrame_) {
+            return;
+        }
+
+        // The next event is shown if it was built in time, else the frame is dropped.
+        // While following, the newest event is shown if one was appended since the
+        // last frame, so the rate limits how often the display is rebuilt.
+        bool shown = false;
+        if (following_) {
+            if (showNewestEvent()) {
+                framesShown_++;
+                updateFollowStatus();
+            }
+        } else if (prebuilder_->isStarted()) {
+            if (prebuilder_->isReady()) {
+                int i = prebuilder_->getEventNumber();
+                SceneCache::Scene* scene = prebuilder_->take();
+                if (scene != nullptr) {
+                    StageTimer::Span span("auto play");
+                    stashEvent();
+                    showScene(scene);
+                    eventNum_ = i;
+                    shown = true;
+                } else {
+                    // Unreadable events are skipped.
+                    prebuildNext(i);
+                }
+            }
+        } else if (autoPlayNext_ >= 0 && autoPlayNext_ != eventNum_) {
+            const EventIndex::Entry& entry = index_->getEntry(autoPlayNext_);
+            if (sceneCache_ != nullptr && sceneCache_->contains(SceneCache::Key(entry.run, entry.event))) {
+                restoreEvent(autoPlayNext_);
+                readAhead_->skip(autoPlayNext_);
+                eventNum_ = autoPlayNext_;
+                shown = true;
+            }
+        }
+        if (following_) {
+            // Frames without a new event are not dropped.
+        } else if (shown) {
+            framesShown_++;
+            redraw();
+        } else {
+            framesDropped_++;
+        }
+        if (!following_ && !prebuilder_->isStarted()) {
+            prebuildNext(eventNum_);
+        }
+
+        // Frames that were missed entirely, e.g. while the GUI was busy, are dropped.
+        std::chrono::steady_clock::duration interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(1. / app_->getAutoPlayRate()));
+        nextFrame_ += interval;
+        while (nextFrame_ <= now) {
+            nextFrame_ += interval;
+            framesDropped_++;
+        }
+        updateAutoPlayStatus();
+    }
+
+    void EventManager::updateAutoPlayStatus() {
+        std::stringstream status;
+        status << std::fixed << std::setprecision(2);
+        if (!autoPlaying_) {
+            status << "Auto play is off";
+        } else {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - autoPlayStart_).count();
+            status << "Target " << app_->getAutoPlayRate() << "/s, actual "
+                    << (seconds > 0. ? framesShown_ / seconds : 0.) << "/s, dropped " << framesDropped_;
+            if (prebuilder_->getBuildTime() > 0.) {
+                status << ", build " << std::setprecision(0) << 1000. * prebuilder_->getBuildTime() << " ms";
+            }
+        }
+        app_->setAutoPlayStatus(status.str());
+    }
+
+    void EventManager::toggleFollow() {
+        if (!app_->isFollowEnabled()) {
+            stopFollow();
+            return;
+        }
+        if (following_) {
+            return;
+        }
+        log(INFO) << "Following input files" << std::endl;
+        following_ = true;
+        followLatency_ = -1.;
+
+        // Auto play goes on with the appended events instead of the next ones.
+        prebuilder_->cancel();
+        autoPlayNext_ = -1;
+        follower_->start();
+        followTimer_->Start(100, kFALSE);
+        updateFollowStatus();
+    }
+
+    void EventManager::stopFollow() {
+        if (!following_) {
+            return;
+        }
+        log(INFO) << "Stopping follow mode" << std::endl;
+        followTimer_->Stop();
+        follower_->stop();
+        following_ = false;
+        autoPlayNext_ = -1;
+        app_->setFollowEnabled(false);
+        updateFollowStatus();
+    }
+
+    void EventManager::followStep() {
+        int nEvents = index_->getNumberOfEvents();
+        if (nEvents != knownEvents_) {
+            knownEvents_ = nEvents;
+            app_->setNumberOfEvents(nEvents);
+        }
+
+        // Events are only built once the detector files were fetched, and with
+        // auto play at its frame times.
+        if (app_->getDetectorGeometry()->isInitialized() && !autoPlaying_) {
+            showNewestEvent();
+        }
+        updateFollowStatus();
+    }
+
+    bool EventManager::showNewestEvent() {
+        int i = -1;
+        EventFollower::TimePoint changed;
+        std::shared_ptr<const EventStore> store = follower_->takeNewest(i, changed);
+        if (store == nullptr) {
+            return false;
+        }
+        HPS_LOG(FINE) << "Showing newest event: " << i << std::endl;
+        {
+            StageTimer::Span span("follow");
+            stashEvent();
+            event_->startBuild(app_->getEveManager(), store);
+            applyCuts();
+            if (event_->isBuilding()) {
+                loadTimer_->Start(10, kFALSE);
+            }
+            eventNum_ = i;
+        }
+        redraw();
+
+        // From the change of the file to the cheap collections being on screen
+        followLatency_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - changed).count();
+        return true;
+    }
+
+    void EventManager::updateFollowStatus() {
+        std::stringstream status;
+        if (!following_) {
+            status << "Follow is off";
+        } else {
+            status << "Appended " << follower_->getNumberOfAppended() << ", showing " << eventNum_;
+            if (followLatency_ >= 0.) {
+                status << ", latency " << std::fixed << std::setprecision(0) << 1000. * followLatency_ << " ms";
+            }
+        }
+        app_->setFollowStatus(status.str());
+    }
+
+    void EventManager::toggleTiming() {
+        bool enabled = app_->isTimingEnabled();
+        log(INFO) << (enabled ? "Enabling" : "Disabling") << " stage timing" << std::endl;
+        StageTimer::clear();
+        StageTimer::setEnabled(enabled);
+        if (enabled) {
+            timingTimer_->Start(1000, kFALSE);
+        } else {
+            timingTimer_->Stop();
+        }
+        updateTimingStatus();
+    }
+
+    void EventManager::updateTimingStatus() {
+        if (!StageTimer::isEnabled()) {
+            app_->setTimingStatus("Timing is disabled");
+            return;
+        }
+        std::vector<std::pair<std::string, StageTimer::Stats>> stats = StageTimer::getStats();
+        std::vector<std::pair<std::string, int>> counts = StageTimer::getCounts();
+        std::stringstream status;
+        status << std::fixed << std::setprecision(2);
+        status << std::left << std::setw(28) << "Stage [ms]" << std::right
+                << std::setw(9) << "last" << std::setw(9) << "mean" << std::setw(9) << "p95" << std::endl;
+        for (size_t s = 0; s < stats.size(); s++) {
+            const StageTimer::Stats& stage = stats[s].second;
+            status << std::left << std::setw(28) << stats[s].first << std::right
+                    << std::setw(9) << 1000. * stage.last
+                    << std::setw(9) << 1000. * stage.mean
+                    << std::setw(9) << 1000. * stage.p95 << std::endl;
+        }
+        if (counts.size() > 0) {
+            status << std::endl << std::left << std::setw(28) << "Collection" << std::right
+                    << std::setw(9) << "objects" << std::endl;
+            for (size_t c = 0; c < counts.size(); c++) {
+                status << std::left << std::setw(28) << counts[c].first << std::right
+                        << std::setw(9) << counts[c].second << std::endl;
+            }
+        }
+        app_->setTimingStatus(status.str());
+    }
+
+    void EventManager::redraw() {
+        StageTimer::Span span("redraw");
         app_->getEveManager()->FullRedraw3D(false);
     }
 
+    void EventManager::modifyMagField() {
+        app_->setMagFieldY(app_->getMagFieldEntry());
+        prebuilder_->setMagFieldY(app_->getMagFieldY());
+        redraw();
+    }
+
+    void EventManager::updateElementTitle(TEveElement* element) {
+        LCObjectUserData* data = static_cast<LCObjectUserData*>(element->GetUserData());
+        if (data != nullptr) {
+            TString title = data->getTitle();
+            if (title.Length() > 0) {
+                element->SetElementTitle(title);
+            }
+        }
+    }
+
+    void EventManager::expandElement(TEveElement* element) {
+        if (event_->expandMCParticles(element)) {
+            redraw();
+        }
+    }
+
     /*
     void EventManager::Close() {
         std::cout << "[ EventManager ] : Close" << std::endl;
@@ -1,28 +1,33 @@
 #include "EventObjects.h"
 
 // C++ standard library
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
+#include <limits>
+#include <queue>
 #include <sstream>
 
 // HPS
+#include "CutCompiler.h"
+#include "DeferredStamp.h"
 #include "DetectorGeometry.h"
 #include "EventDisplay.h"
 #include "EventObjects.h"
+#include "HelixTrack.h"
+#include "LCBoxSet.h"
+#include "LCObjectElement.h"
 #include "LCObjectUserData.h"
+#include "LCPointSet.h"
+#include "MCParticleGroup.h"
+#include "PropagatorRegistry.h"
+#include "StageTimer.h"
+#include "ThreadPool.h"
+#include "TrackMaker.h"
 
 // LCIO
 #include "EVENT/LCIO.h"
-#include "EVENT/LCCollection.h"
-#include "EVENT/SimTrackerHit.h"
-#include "EVENT/SimCalorimeterHit.h"
-#include "EVENT/MCParticle.h"
-#include "EVENT/Cluster.h"
-#include "EVENT/Track.h"
-#include "EVENT/ReconstructedParticle.h"
-#include "EVENT/Vertex.h"
-#include "IMPL/LCCollectionVec.h"
-#include "EVENT/Vertex.h"
 
 // ROOT
 #include "TEveElement.h"
@@ -38,54 +43,85 @@ using EVENT::LCIO;
 
 namespace hps {
 
-    EventObjects::EventObjects(EventDisplay* app) :
+    EventObjects::EventObjects(DetectorGeometry* det, PropagatorRegistry* propagators, int buildThreads) :
             Logger("EventObjects"),
-            app_(app),
+            det_(det),
+            propagators_(propagators),
             pdgdb_(TDatabasePDG::Instance()) {
 
-        // Set log level from main app.
-        setLogLevel(app_->getLogLevel());
+        // Palettes are shared by all events.
+        TStyle ecalStyle;
+        ecalStyle.SetPalette(kTemperatureMap);
+        ecalPalette_ = getPaletteColors(ecalStyle);
+        TStyle clusStyle = createClusStyle();
+        clusPalette_ = getPaletteColors(clusStyle);
+        TStyle particleStyle;
+        particleStyle.SetPalette(kRainBow); // FIXME: hard-coded color palette
+        particlePalette_ = getPaletteColors(particleStyle);
+
+        // Collections are built on worker threads if enabled.
+        if (buildThreads > 0) {
+            log(INFO) << "Building collections on " << buildThreads << " threads" << std::endl;
+            pool_ = new ThreadPool(buildThreads);
+
+            // The PDG table is read on first use.
+            pdgdb_->GetParticle(11);
+        }
+        trackMaker_ = new TrackMaker(propagators_, pool_);
+        compiler_ = new CutCompiler();
     }
 
-    void EventObjects::build(TEveManager* manager, EVENT::LCEvent* event) {
-        log(INFO) << "Set new LCIO event: " << event->getEventNumber() << std::endl;
+    void EventObjects::setLogLevel(int level) {
+        Logger::setLogLevel(level);
+        trackMaker_->setLogLevel(level);
+        compiler_->setLogLevel(level);
+    }
 
-        // Clear the map of types to element lists.
-        typeMap_.clear();
+    void EventObjects::setMCDetail(double minEnergy, int maxDepth, int maxParticles) {
+        mcMinEnergy_ = minEnergy;
+        mcMaxDepth_ = maxDepth;
+        mcMaxParticles_ = maxParticles;
+    }
 
-        const std::vector<std::string>* collNames = event->getCollectionNames();
-        for (std::vector<std::string>::const_iterator it = collNames->begin();
-                it != collNames->end();
-                it++) {
-            auto collectionName = *it;
-            EVENT::LCCollection* collection = event->getCollection(collectionName);
-            if (app_->excludeCollection(collectionName, collection)) {
-                log(FINE) << "Excluded collection: " << collectionName << std::endl;
-                continue;
-            }
-            TEveElementList* elements = nullptr;
-            auto typeName = collection->getTypeName();
-            if (typeName == LCIO::SIMTRACKERHIT) {
-                elements = createSimTrackerHits(collection);
-            } else if (typeName == LCIO::SIMCALORIMETERHIT) {
-                elements = createSimCalorimeterHits(collection);
-            } else if (typeName == LCIO::MCPARTICLE) {
-                elements = createMCParticles(collection);
-            } else if (typeName == LCIO::CLUSTER) {
-                elements = createCalClusters(collection);
-            } else if (typeName == LCIO::TRACK) {
-                elements = createReconTracks(collection);
-            } else if (typeName == LCIO::RECONSTRUCTEDPARTICLE) {
-                elements = createReconstructedParticles(collection);
-            } else if (typeName == LCIO::VERTEX) {
-                elements = createVertices(collection);
-            }
-            if (elements != nullptr) {
-                elements->SetElementName(collectionName.c_str());
-                elements->SetPickableRecursively(true);
-                manager->AddElement(elements);
-                typeMap_[typeName].push_back(elements);
-                log(FINE) << "Added elements from collection: " << collectionName << std::endl;
+    void EventObjects::setExcludedCollections(const std::set<std::string>& names,
+                                              const std::set<std::string>& types) {
+        excludeCollectionNames_ = names;
+        excludeCollectionTypes_ = types;
+    }
+
+    std::vector<TEveElementList*> EventObjects::build(TEveManager* manager, EVENT::LCEvent* event) {
+        cancelBuild();
+        decode(event);
+        return buildAll(manager);
+    }
+
+    std::vector<TEveElementList*> EventObjects::build(TEveManager* manager,
+                                                      std::shared_ptr<const EventStore> store) {
+        cancelBuild();
+        reset(store);
+        return buildAll(manager);
+    }
+
+    std::vector<TEveElementList*> EventObjects::buildAll(TEveManager* manager) {
+
+        // Build all collections, concurrently if there are workers.
+        std::vector<size_t> indices;
+        for (size_t i = 0; i < store_->getCollections().size(); i++) {
+            indices.push_back(i);
+        }
+        std::vector<TEveElementList*> elementLists = buildCollections(indices);
+        makeTracks(0);
+        recordTimes();
+        if (manager != nullptr && StageTimer::isEnabled()) {
+            StageTimer::clearCounts();
+        }
+
+        // Add the elements in the order of the collections in the event.
+        std::vector<TEveElementList*> added;
+        for (size_t k = 0; k < indices.size(); k++) {
+            if (elementLists[k] != nullptr) {
+                addElements(manager, indices[k], elementLists[k]);
+                added.push_back(elementLists[k]);
             }
         }
 
@@ -94,228 +130,678 @@ namespace hps {
 
         // Apply current Track P cut
         //setTrackPCut(trackPcut_);
+
+        return added;
     }
 
-    EventObjects::~EventObjects() {
+    std::vector<TEveElementList*> EventObjects::startBuild(TEveManager* manager, EVENT::LCEvent* event) {
+        cancelBuild();
+        decode(event);
+        return startCollections(manager);
+    }
+
+    std::vector<TEveElementList*> EventObjects::startBuild(TEveManager* manager,
+                                                           std::shared_ptr<const EventStore> store) {
+        cancelBuild();
+        log(INFO) << "Set decoded event with " << store->getCollections().size() << " collections" << std::endl;
+        reset(store);
+        return startCollections(manager);
+    }
+
+    std::vector<TEveElementList*> EventObjects::startCollections(TEveManager* manager) {
+
+        // Cheap collections are built right away and the heavy ones are queued.
+        const std::vector<EventStore::Collection>& collections = store_->getCollections();
+        std::vector<size_t> indices;
+        for (size_t i = 0; i < collections.size(); i++) {
+            if (isDeferred(collections[i].typeName)) {
+                pendingCollections_.push_back(i);
+            } else {
+                indices.push_back(i);
+            }
+        }
+        HPS_LOG(FINE) << "Building " << indices.size() << " collections, deferring "
+                << pendingCollections_.size() << std::endl;
+        std::vector<TEveElementList*> elementLists = buildCollections(indices);
+        makeTracks(0);
+        if (pendingCollections_.empty()) {
+            recordTimes();
+        }
+        if (manager != nullptr && StageTimer::isEnabled()) {
+            StageTimer::clearCounts();
+        }
+
+        std::vector<TEveElementList*> added;
+        for (size_t k = 0; k < indices.size(); k++) {
+            if (elementLists[k] != nullptr) {
+                addElements(manager, indices[k], elementLists[k]);
+                added.push_back(elementLists[k]);
+            }
+        }
+        return added;
     }
 
-    TEveElementList* EventObjects::createSimTrackerHits(EVENT::LCCollection* coll) {
-        TEveElementList* elements = new TEveElementList();
-        for (int i=0; i<coll->getNumberOfElements(); i++) {
-            EVENT::SimTrackerHit* hit = dynamic_cast<EVENT::SimTrackerHit*>(coll->getElementAt(i));
-            auto x = hit->getPosition()[0];
-            auto y = hit->getPosition()[1];
-            auto z = hit->getPosition()[2];
-            auto edep = hit->getEDep();
-            auto hitTime = hit->getTime();
-            TEvePointSet* p = new TEvePointSet(1);
-            p->SetElementName("SimTrackerHit");
-            p->SetMarkerStyle(kStar);
-            p->SetMarkerSize(0.2);
-            p->SetPoint(0, x/10.0, y/10.0, z/10.0);
-            p->SetMarkerColor(3);
-            p->SetTitle(Form("Simulated Tracker Hit\n"
-                              "(x, y, z) = (%.3f, %.3f, %.3f)\n"
-                              "Time = %f, dEdx = %E",
-                              x, y, z, hitTime, edep));
-            elements->AddElement(p);
+    TEveElementList* EventObjects::buildNext(TEveManager* manager, double seconds) {
+        auto start = std::chrono::steady_clock::now();
+        auto elapsed = [&start]() {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        // Start on the next deferred collection, whose objects are created and
+        // whose tracks are then made in slices.
+        if (!slicing_ && building_ == nullptr) {
+            if (pendingCollections_.empty()) {
+                return nullptr;
+            }
+            buildingIndex_ = pendingCollections_.front();
+            pendingCollections_.pop_front();
+            slicing_ = true;
+            nextObject_ = store_->getCollections()[buildingIndex_].begin;
+        }
+        while (slicing_ && elapsed() < seconds) {
+            buildSlice();
+        }
+        if (slicing_) {
+            return nullptr;
+        }
+
+        double tracksStart = elapsed();
+        while (trackMaker_->getNumberOfTracks() > 0 && elapsed() < seconds) {
+            makeTracks(TRACKS_PER_SLICE);
+        }
+        HPS_LOG(FINER) << "Spent " << elapsed() - tracksStart << " s making tracks, "
+                << trackMaker_->getNumberOfTracks() << " left" << std::endl;
+        if (trackMaker_->getNumberOfTracks() > 0) {
+            return nullptr;
+        }
+
+        TEveElementList* elements = building_;
+        building_ = nullptr;
+        addElements(manager, buildingIndex_, elements);
+        if (pendingCollections_.empty()) {
+            recordTimes();
         }
         return elements;
     }
 
-    TEveElementList* EventObjects::createSimCalorimeterHits(EVENT::LCCollection* coll) {
+    bool EventObjects::buildSlice() {
+        auto start = std::chrono::steady_clock::now();
+        const EventStore::Collection& collection = store_->getCollections()[buildingIndex_];
+        int end = std::min(nextObject_ + OBJECTS_PER_SLICE, collection.end);
+        if (collection.typeName == LCIO::SIMCALORIMETERHIT) {
+            if (slicedHits_ == nullptr) {
+                slicedHits_ = new LCBoxSet("SimCalorimeterHits", store_, &simCalorimeterHitTitle);
+            }
+            addSimCalorimeterHits(slicedHits_, collection, nextObject_, end);
+            if (end == collection.end) {
+                building_ = finishSimCalorimeterHits(slicedHits_);
+                slicedHits_ = nullptr;
+            }
+        } else {
+            if (nextObject_ == collection.begin) {
+                selectMCParticles(collection, slicedParticles_);
+            }
+            createMCParticleTracks(collection, slicedParticles_, nextObject_, end,
+                                   getCutTable(collection.typeName));
+            if (end == collection.end) {
+                building_ = linkMCParticles(collection, slicedParticles_);
+                slicedParticles_ = MCParticleTree();
+            }
+        }
+        HPS_LOG(FINER) << "Created objects " << nextObject_ - collection.begin << " to "
+                << end - collection.begin << " of " << collection.name << std::endl;
+        nextObject_ = end;
+        slicing_ = end < collection.end;
+        buildTimes_[collection.typeName] +=
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return !slicing_;
+    }
 
-        TStyle ecalStyle;
-        ecalStyle.SetPalette(kTemperatureMap);
+    bool EventObjects::isBuilding() {
+        return slicing_ || building_ != nullptr || !pendingCollections_.empty();
+    }
 
-        float min = 999;
-        float max = -999;
-        for (int i=0; i<coll->getNumberOfElements(); i++) {
-            EVENT::SimCalorimeterHit* hit = dynamic_cast<EVENT::SimCalorimeterHit*>(coll->getElementAt(i));
-            auto energy = hit->getEnergy();
-            if (energy < min) {
-                min = energy;
-            }
-            if (energy > max) {
-                max = energy;
-            }
-        }
-
-        log(FINE) << "ECAL min, max hit energy: " << min << ", " << max << std::endl;
-
-        min = 0;
-        max = max * 100;
-
-        TGeoManager* geo = app_->getDetectorGeometry()->getGeoManager();
-        TEveElementList* elements = new TEveElementList();
-        for (int i=0; i<coll->getNumberOfElements(); i++) {
-            EVENT::SimCalorimeterHit* hit = dynamic_cast<EVENT::SimCalorimeterHit*>(coll->getElementAt(i));
-            auto energy = hit->getEnergy();
-            auto pos = hit->getPosition();
-            auto x = pos[0]/10.0;
-            auto y = pos[1]/10.0;
-            auto z = pos[2]/10.0;
-            auto hitTime = hit->getTimeCont(0);
-            log(FINEST) << "Looking for ECAL crystal at: ("
-                    << x << ", " << y << ", " << z << ")" << std::endl;
-
-            geo->CdTop();
-            TGeoNode* node = geo->FindNode((double)x, (double)y, (double)z);
-            if (node != nullptr && node != geo->GetTopNode()) {
-                log(FINEST) << "Found geo node: " << node->GetName() << std::endl;
-            } else {
-                log("No geo node found for cal hit!", ERROR);
-                continue;
+    void EventObjects::cancelBuild() {
+        if (!isBuilding()) {
+            return;
+        }
+        HPS_LOG(FINE) << "Cancelling " << pendingCollections_.size() + (slicing_ || building_ != nullptr ? 1 : 0)
+                << " collections" << std::endl;
+        trackMaker_->clear();
+        if (slicedHits_ != nullptr) {
+            slicedHits_->Destroy();
+            slicedHits_ = nullptr;
+        }
+        for (size_t k = 0; k < slicedParticles_.tracks.size(); k++) {
+            if (slicedParticles_.tracks[k] != nullptr) {
+                slicedParticles_.tracks[k]->Destroy();
             }
-            TEveElement* element = DetectorGeometry::toEveElement(geo, node);
-            element->SetElementName("SimCalorimeterHit");
+        }
+        slicedParticles_ = MCParticleTree();
+        slicing_ = false;
+        if (building_ != nullptr) {
+            building_->Destroy();
+            building_ = nullptr;
+        }
+        pendingCollections_.clear();
+    }
 
-            auto energyScaled = energy * 100;
-            element->SetMainColor(ecalStyle.GetColorPalette((energyScaled - min)/(max - min) * ecalStyle.GetNumberOfColors()));
-            element->SetElementTitle(Form("Simulated Calorimeter Hit\n"
-                    "(x, y, z) = (%.3f, %.3f, %.3f)\n"
-                    "Time = %f, Energy = %E, Contribs = %d",
-                    x, y, z, hitTime, energy, hit->getNMCContributions()));
-            elements->AddElement(element);
+    bool EventObjects::isDeferred(const std::string& typeName) {
+        return typeName == LCIO::MCPARTICLE || typeName == LCIO::SIMCALORIMETERHIT;
+    }
+
+    void EventObjects::decode(EVENT::LCEvent* event) {
+        log(INFO) << "Set new LCIO event: " << event->getEventNumber() << std::endl;
+
+        // The builders only read the store, which is shared with the elements
+        // made from it and outlives the LCIO event.
+        auto decodeStart = std::chrono::steady_clock::now();
+        std::shared_ptr<EventStore> store = std::make_shared<EventStore>();
+        store->decode(event, excludeCollectionNames_, excludeCollectionTypes_);
+        double decodeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - decodeStart).count();
+        HPS_LOG(FINE) << "Decoded " << store->getCollections().size() << " collections into "
+                << store->getSize() << " bytes" << std::endl;
+        reset(store);
+        decodeTime_ = decodeTime;
+        if (StageTimer::isEnabled()) {
+            StageTimer::record("decode", decodeTime_);
         }
-        return elements;
     }
 
-    // Based on Druid src/BuildMCParticles.cc
-    TEveElementList* EventObjects::createMCParticles(EVENT::LCCollection *coll) {
+    void EventObjects::reset(std::shared_ptr<const EventStore> store) {
 
-        TEveElementList* mcTracks = new TEveElementList();
+        // Clear the map of types to element lists.
+        typeMap_.clear();
 
-        log(FINE) << "Building MCParticle collection with size: "
-                << coll->getNumberOfElements() << std::endl;
+        // New tables for the cut variables of the types that can be cut.
+        cutTables_.clear();
+        cutTables_[LCIO::MCPARTICLE] = std::make_shared<CutTable>();
+        cutTables_[LCIO::TRACK] = std::make_shared<CutTable>();
+        cutTables_[LCIO::RECONSTRUCTEDPARTICLE] = std::make_shared<CutTable>();
 
-        TEveTrackPropagator *propsetCharged = new TEveTrackPropagator();
+        store_ = store;
+        decodeTime_ = 0.;
+        buildTimes_.clear();
+        makeTracksTime_ = 0.;
+    }
 
-        propsetCharged->SetMagFieldObj(new TEveMagFieldConst(0.0, app_->getMagFieldY(), 0.0));
-        propsetCharged->SetDelta(0.01);
-        propsetCharged->SetMaxR(150);
-        propsetCharged->SetMaxZ(200);
-        propsetCharged->SetMaxOrbs(2.0);
-        propsetCharged->SetFitDecay(true);
+    std::vector<TEveElementList*> EventObjects::buildCollections(const std::vector<size_t>& indices) {
+        const std::vector<EventStore::Collection>& collections = store_->getCollections();
+        std::vector<TEveElementList*> elementLists(indices.size(), nullptr);
+        std::vector<double> seconds(indices.size(), 0.);
+        auto buildCollection = [this, &collections, &indices, &elementLists, &seconds](size_t k) {
+            auto start = std::chrono::steady_clock::now();
+            elementLists[k] = createElements(collections[indices[k]]);
+            seconds[k] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
+        if (pool_ != nullptr && indices.size() > 1) {
+            std::vector<std::future<void>> futures;
+            for (size_t k = 0; k < indices.size(); k++) {
+                futures.push_back(pool_->submit([&buildCollection, k]() {
+                    buildCollection(k);
+                }));
+            }
+            for (size_t k = 0; k < futures.size(); k++) {
+                futures[k].wait();
+            }
+            for (size_t k = 0; k < futures.size(); k++) {
+                futures[k].get();
+            }
+        } else {
+            for (size_t k = 0; k < indices.size(); k++) {
+                buildCollection(k);
+            }
+        }
+        for (size_t k = 0; k < indices.size(); k++) {
+            if (elementLists[k] != nullptr) {
+                const EventStore::Collection& collection = collections[indices[k]];
+                buildTimes_[collection.typeName] += seconds[k];
+            }
+        }
+        return elementLists;
+    }
 
-        TEveTrackPropagator *propsetNeutral = new TEveTrackPropagator();
-        propsetNeutral->SetMagFieldObj(new TEveMagFieldConst(0.0, app_->getMagFieldY(), 0.0));
-        propsetNeutral->SetDelta(0.01);
-        propsetNeutral->SetMaxR(150);
-        propsetNeutral->SetMaxZ(200);
-        propsetNeutral->SetMaxOrbs(1.0);
-        propsetNeutral->SetFitDecay(true);
+    void EventObjects::recordTimes() {
+        if (!StageTimer::isEnabled()) {
+            return;
+        }
+        for (BuildTimes::const_iterator it = buildTimes_.begin(); it != buildTimes_.end(); it++) {
+            StageTimer::record("build " + it->first, it->second);
+        }
+        StageTimer::record("make tracks", makeTracksTime_);
+    }
 
-        std::map<EVENT::MCParticle*, TEveTrack*> particleMap;
+    void EventObjects::recordCounts() {
+        if (!StageTimer::isEnabled() || store_ == nullptr) {
+            return;
+        }
+        StageTimer::clearCounts();
+        const std::vector<EventStore::Collection>& collections = store_->getCollections();
+        for (size_t i = 0; i < collections.size(); i++) {
+            TypeMap::const_iterator it = typeMap_.find(collections[i].typeName);
+            if (it == typeMap_.end()) {
+                continue;
+            }
+            for (size_t k = 0; k < it->second.size(); k++) {
+                if (collections[i].name == it->second[k]->GetElementName()) {
+                    StageTimer::setCount(collections[i].name, collections[i].size());
+                    break;
+                }
+            }
+        }
+    }
 
-        for (int i = 0; i < coll->getNumberOfElements(); i++) {
+    void EventObjects::makeTracks(size_t maxTracks) {
+        auto start = std::chrono::steady_clock::now();
+        trackMaker_->makeTracks(maxTracks);
+        makeTracksTime_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
 
-            EVENT::MCParticle *mcp = dynamic_cast<EVENT::MCParticle*>(coll->getElementAt(i));
+    void EventObjects::addElements(TEveManager* manager, size_t i, TEveElementList* elements) {
+        const EventStore::Collection& collection = store_->getCollections()[i];
+        elements->SetElementName(collection.name.c_str());
+        elements->SetPickableRecursively(true);
+        if (manager != nullptr) {
+            manager->AddElement(elements);
+        }
+        typeMap_[collection.typeName].push_back(elements);
 
-            float charge = mcp->getCharge();
-            double energy = mcp->getEnergy();
+        // Only the counts of the shown event are listed, not those of events built ahead.
+        if (manager != nullptr && StageTimer::isEnabled()) {
+            StageTimer::setCount(collection.name, collection.size());
+        }
+        HPS_LOG(FINE) << "Added elements from collection: " << collection.name << std::endl;
+    }
 
-            double px = mcp->getMomentum()[0];
-            double py = mcp->getMomentum()[1];
-            double pz = mcp->getMomentum()[2];
+    EventObjects::~EventObjects() {
+        cancelBuild();
+        delete compiler_;
+        delete trackMaker_;
+        delete pool_;
+    }
 
-            double x = mcp->getVertex()[0]/10.0;
-            double y = mcp->getVertex()[1]/10.0;
-            double z = mcp->getVertex()[2]/10.0;
+    TEveElementList* EventObjects::createElements(const EventStore::Collection& collection) {
+        TEveElementList* elements = nullptr;
+        const std::string& typeName = collection.typeName;
+        if (typeName == LCIO::SIMTRACKERHIT) {
+            elements = createSimTrackerHits(collection);
+        } else if (typeName == LCIO::SIMCALORIMETERHIT) {
+            elements = createSimCalorimeterHits(collection);
+        } else if (typeName == LCIO::MCPARTICLE) {
+            elements = createMCParticles(collection, getCutTable(typeName));
+        } else if (typeName == LCIO::CLUSTER) {
+            elements = createCalClusters(getIndices(collection));
+        } else if (typeName == LCIO::TRACK) {
+            elements = createReconTracks(getIndices(collection), getCutTable(typeName));
+        } else if (typeName == LCIO::RECONSTRUCTEDPARTICLE) {
+            elements = createReconstructedParticles(collection, getCutTable(typeName));
+        } else if (typeName == LCIO::VERTEX) {
+            elements = createVertices(getIndices(collection));
+        }
+        return elements;
+    }
 
-            double endX = mcp->getEndpoint()[0]/10.0;
-            double endY = mcp->getEndpoint()[1]/10.0;
-            double endZ = mcp->getEndpoint()[2]/10.0;
+    std::vector<int> EventObjects::getIndices(const EventStore::Collection& collection) {
+        std::vector<int> indices;
+        indices.reserve(collection.size());
+        for (int i = collection.begin; i < collection.end; i++) {
+            indices.push_back(i);
+        }
+        return indices;
+    }
 
-            TEveVector vertex(x, y, z);
-            TEveVector endpoint(endX, endY, endZ);
 
-            float length = vertex.Distance(endpoint);
+    TEveElementList* EventObjects::createSimTrackerHits(const EventStore::Collection& coll) {
+        const EventStore::Vectors& pos = store_->simTrackerHits.position;
+        TEveElementList* elements = new DeferredStamp<TEveElementList>();
+        LCPointSet* hits = new LCPointSet("SimTrackerHits", coll.size(), store_, &simTrackerHitTitle);
+        hits->SetMarkerStyle(kStar);
+        hits->SetMarkerSize(0.2);
+        hits->SetMarkerColor(3);
+        for (int i = coll.begin; i < coll.end; i++) {
+            hits->addPoint(i, pos.x[i], pos.y[i], pos.z[i]);
+        }
+        elements->AddElement(hits);
+        return elements;
+    }
 
-            TParticlePDG* pdg = pdgdb_->GetParticle(mcp->getPDG());
+    TString EventObjects::simTrackerHitTitle(const EventStore& store, int i) {
+        const EventStore::SimTrackerHits& hits = store.simTrackerHits;
+        return TString::Format("Simulated Tracker Hit\n"
+                               "(x, y, z) = (%.3f, %.3f, %.3f)\n"
+                               "Time = %f, dEdx = %E",
+                               hits.position.x[i] * 10., hits.position.y[i] * 10., hits.position.z[i] * 10.,
+                               hits.time[i], hits.edep[i]);
+    }
 
-            log(FINEST) << "Processing MCParticle: charge = " << charge
-                    << "; vertex = (" << x << ", " << y << ", " << z
-                    << "); " << "momentum = (" << px << ", " << py << ", "
-                    << pz << "); " << "gen_status = " << mcp->getGeneratorStatus()
-                    << std::endl;
+    TEveElementList* EventObjects::createSimCalorimeterHits(const EventStore::Collection& coll) {
 
-            TEveRecTrack *recTrack = new TEveRecTrack();
-            recTrack->fV.Set(TEveVector(x, y, z));
-            recTrack->fP.Set(px, py, pz);
-            recTrack->fSign = charge;
+        HPS_LOG(FINE) << "ECAL min, max hit energy: " << coll.minEnergy << ", " << coll.maxEnergy << std::endl;
+
+        // All hits are drawn as one box set with a box per crystal.
+        LCBoxSet* boxes = new LCBoxSet("SimCalorimeterHits", store_, &simCalorimeterHitTitle);
+        addSimCalorimeterHits(boxes, coll, coll.begin, coll.end);
+        return finishSimCalorimeterHits(boxes);
+    }
 
-            TEveTrack *track = new TEveTrack(recTrack, nullptr);
-            if (pdg) {
-                track->SetElementName(pdg->GetName());
+    void EventObjects::addSimCalorimeterHits(LCBoxSet* boxes, const EventStore::Collection& coll,
+                                             int begin, int end) {
+
+        // Colors go from zero to the highest energy of the collection.
+        float max = coll.maxEnergy;
+
+        DetectorGeometry* det = det_;
+        const EventStore::CalorimeterHits& hits = store_->simCalorimeterHits;
+        int nColors = ecalPalette_.size();
+        for (int i = begin; i < end; i++) {
+            double hitPos[3] = {hits.position.x[i], hits.position.y[i], hits.position.z[i]};
+            HPS_LOG(FINEST) << "Looking for ECAL crystal at: ("
+                    << hitPos[0] << ", " << hitPos[1] << ", " << hitPos[2] << ")" << std::endl;
+
+            const DetectorGeometry::Crystal* crystal = det->findCrystal(hits.cellID[i], hitPos);
+            if (crystal != nullptr) {
+                HPS_LOG(FINEST) << "Found crystal: " << crystal->node->GetName() << std::endl;
             } else {
-                log(WARNING) << "Unknown PDG code: " << mcp->getPDG() << std::endl;
-                track->SetElementName("Unknown");
+                log("No crystal found for cal hit!", ERROR);
+                continue;
             }
-            if (charge != 0.0) {
-                track->SetPropagator(propsetCharged);
-                track->SetMainColor(kRed);
-            } else {
-                track->SetPropagator(propsetNeutral);
-                track->SetMainColor(kYellow);
+            if (!crystal->hasVertices) {
+                log(ERROR) << "Crystal cannot be drawn as a box: " << crystal->node->GetName() << std::endl;
+                continue;
             }
 
-            TVector3 p(px, py, pz);
+            int colorIndex = max > 0 ? hits.energy[i] / max * nColors : 0;
+            colorIndex = std::max(0, std::min(colorIndex, nColors - 1));
+            boxes->addBox(i, crystal->vertices, ecalPalette_[colorIndex]);
+        }
+    }
 
-            track->SetElementTitle(Form("MC Particle\n"
-                    "(x, y, z) = (%.3f, %.3f, %.3f)\n"
-                    "(Px, Py, Pz) = (%.3f, %.3f, %.3f)\n"
-                    "Charge = %.3f, Energy = %.3f, Length = %.3f\n"
-                    "P = %.3f",
-                    x, y, z,
-                    px, py, pz,
-                    charge, energy, length,
-                    p.Mag()));
+    TEveElementList* EventObjects::finishSimCalorimeterHits(LCBoxSet* boxes) {
+        TEveElementList* elements = new DeferredStamp<TEveElementList>();
+        boxes->RefitPlex();
+        elements->AddElement(boxes);
+        return elements;
+    }
 
-            particleMap[mcp] = track;
+    TString EventObjects::simCalorimeterHitTitle(const EventStore& store, int i) {
+        const EventStore::CalorimeterHits& hits = store.simCalorimeterHits;
+        return TString::Format("Simulated Calorimeter Hit\n"
+                               "(x, y, z) = (%.3f, %.3f, %.3f)\n"
+                               "Time = %f, Energy = %E, Contribs = %d",
+                               hits.position.x[i], hits.position.y[i], hits.position.z[i],
+                               hits.time[i], hits.energy[i], hits.contributions[i]);
+    }
 
-            if (pdg) {
-                track->SetElementName(pdg->GetName());
-            } else {
-                log(WARNING) << "Unknown PDG code: " << mcp->getPDG() << std::endl;
-                track->SetElementName("Unknown");
+    TString EventObjects::calorimeterHitTitle(const EventStore& store, int i) {
+        const EventStore::CalorimeterHits& hits = store.clusterHits;
+        return TString::Format("Calorimeter Hit\n"
+                               "(x, y, z) = (%.3f, %.3f, %.3f)\n"
+                               "Time = %f, Energy = %E",
+                               hits.position.x[i], hits.position.y[i], hits.position.z[i],
+                               hits.time[i], hits.energy[i]);
+    }
+
+    // Based on Druid src/BuildMCParticles.cc
+    TEveElementList* EventObjects::createMCParticles(const EventStore::Collection& coll, CutTable* cuts) {
+        MCParticleTree tree;
+        selectMCParticles(coll, tree);
+        createMCParticleTracks(coll, tree, coll.begin, coll.end, cuts);
+        return linkMCParticles(coll, tree);
+    }
+
+    void EventObjects::selectMCParticles(const EventStore::Collection& coll, MCParticleTree& tree) {
+
+        HPS_LOG(FINE) << "Building MCParticle collection with size: " << coll.size() << std::endl;
+
+        const EventStore::MCParticles& mcps = store_->mcParticles;
+        int begin = coll.begin;
+        int n = coll.size();
+
+        // Daughters of each particle, and all particles in breadth-first order
+        // with their depth, which are found without recursion.
+        std::vector<int> firstDaughter(n + 1, 0);
+        for (int i = begin; i < coll.end; i++) {
+            if (mcps.parent[i] >= 0) {
+                firstDaughter[mcps.parent[i] - begin + 1]++;
             }
+        }
+        for (int l = 0; l < n; l++) {
+            firstDaughter[l + 1] += firstDaughter[l];
+        }
+        std::vector<int> daughters(firstDaughter[n]);
+        std::vector<int> nextDaughter(firstDaughter.begin(), firstDaughter.end() - 1);
+        for (int i = begin; i < coll.end; i++) {
+            if (mcps.parent[i] >= 0) {
+                daughters[nextDaughter[mcps.parent[i] - begin]++] = i;
+            }
+        }
+        std::vector<int>& order = tree.order;
+        order.reserve(n);
+        std::vector<int> depth(n, 0);
+        for (int i = begin; i < coll.end; i++) {
+            if (mcps.parent[i] < 0) {
+                order.push_back(i);
+            }
+        }
+        for (size_t k = 0; k < order.size(); k++) {
+            int l = order[k] - begin;
+            for (int d = firstDaughter[l]; d < firstDaughter[l + 1]; d++) {
+                depth[daughters[d] - begin] = depth[l] + 1;
+                order.push_back(daughters[d]);
+            }
+        }
 
-            // Decay point
-            const double* endPoint = mcp->getEndpoint();
-            if (endPoint != nullptr) {
-                TEveVector v(endPoint[0]/10., endPoint[1]/10., endPoint[2]/10.);
-                TEvePathMark* pmDecay = new TEvePathMark(TEvePathMark::kDecay, v);
-                track->AddPathMark(*pmDecay);
+        // The most energetic particles are drawn first, starting at the top,
+        // so that the drawn particles form trees within the limits.
+        auto isCandidate = [this, &mcps, &depth, begin](int i) {
+            return mcps.energy[i] >= mcMinEnergy_ && (mcMaxDepth_ < 0 || depth[i - begin] <= mcMaxDepth_);
+        };
+        std::vector<char>& drawn = tree.drawn;
+        drawn.assign(n, 0);
+        std::priority_queue<std::pair<float, int>> candidates;
+        for (int i = begin; i < coll.end; i++) {
+            if (mcps.parent[i] < 0 && isCandidate(i)) {
+                candidates.push(std::make_pair(mcps.energy[i], i));
             }
+        }
+        int& nDrawn = tree.nDrawn;
+        while (!candidates.empty() && (mcMaxParticles_ <= 0 || nDrawn < mcMaxParticles_)) {
+            int i = candidates.top().second;
+            candidates.pop();
+            drawn[i - begin] = 1;
+            nDrawn++;
+            for (int d = firstDaughter[i - begin]; d < firstDaughter[i - begin + 1]; d++) {
+                if (isCandidate(daughters[d])) {
+                    candidates.push(std::make_pair(mcps.energy[daughters[d]], daughters[d]));
+                }
+            }
+        }
 
-            track->MakeTrack(false);
+        tree.tracks.assign(n, nullptr);
+    }
 
-            track->SetUserData(new TrackUserData(mcp, p.Mag()));
+    void EventObjects::createMCParticleTracks(const EventStore::Collection& coll, MCParticleTree& tree,
+                                              int begin, int end, CutTable* cuts) {
+        TEveTrackPropagator *propsetCharged = getPropagator(true);
+        TEveTrackPropagator *propsetNeutral = getPropagator(false);
+        for (int i = begin; i < end; i++) {
+            if (tree.drawn[i - coll.begin]) {
+                tree.tracks[i - coll.begin] = createMCParticle(store_, i, propsetCharged, propsetNeutral, cuts);
+            }
         }
+    }
 
-        for (auto it = particleMap.begin(); it != particleMap.end(); it++) {
-            MCParticle* particle = it->first;
-            TEveTrack* track = it->second;
-            if (particle->getParents().size() > 0) {
-                auto fnd = particleMap.find(particle->getParents()[0]);
-                if (fnd != particleMap.end()) {
-                    TEveTrack* parent = fnd->second;
-                    parent->AddElement(track);
+    TEveElementList* EventObjects::linkMCParticles(const EventStore::Collection& coll, MCParticleTree& tree) {
+
+        TEveElementList* mcTracks = new DeferredStamp<TEveElementList>();
+
+        const EventStore::MCParticles& mcps = store_->mcParticles;
+        int begin = coll.begin;
+        int n = coll.size();
+        const std::vector<int>& order = tree.order;
+        const std::vector<char>& drawn = tree.drawn;
+        const std::vector<TEveTrack*>& tracks = tree.tracks;
+
+        // Drawn particles hang from their parents, and the others are collapsed
+        // into a group below the closest drawn particle they descend from.
+        std::map<int, std::vector<int>> groups;
+        std::vector<int> owners(n, -1);
+        for (size_t k = 0; k < order.size(); k++) {
+            int i = order[k];
+            int parent = mcps.parent[i];
+            if (drawn[i - begin]) {
+                if (parent >= 0) {
+                    tracks[parent - begin]->AddElement(tracks[i - begin]);
+                } else {
+                    // Top-level particles with no parents.
+                    mcTracks->AddElement(tracks[i - begin]);
                 }
             } else {
-                // Top-level particles with no parents.
-                mcTracks->AddElement(track);
+                int owner = parent < 0 ? -1 : (drawn[parent - begin] ? parent : owners[parent - begin]);
+                owners[i - begin] = owner;
+                groups[owner].push_back(i);
             }
         }
+        for (std::map<int, std::vector<int>>::iterator it = groups.begin(); it != groups.end(); it++) {
+            TEveElement* parent = it->first < 0 ? (TEveElement*) mcTracks : tracks[it->first - begin];
+            parent->AddElement(new MCParticleGroup(store_, it->first, parent, it->second, &mcParticleTitle));
+        }
 
         mcTracks->SetRnrSelfChildren(true, true);
 
-        log("Done building MCParticle collection!", FINE);
+        HPS_LOG(FINE) << "Done building MCParticle collection with " << tree.nDrawn << " of "
+                << n << " particles as tracks!" << std::endl;
 
         return mcTracks;
     }
 
+    TEveTrack* EventObjects::createMCParticle(const std::shared_ptr<const EventStore>& store, int i,
+                                              TEveTrackPropagator* propsetCharged,
+                                              TEveTrackPropagator* propsetNeutral,
+                                              CutTable* cuts) {
+        const EventStore::MCParticles& mcps = store->mcParticles;
+
+        float charge = mcps.charge[i];
+
+        double px = mcps.momentum.x[i];
+        double py = mcps.momentum.y[i];
+        double pz = mcps.momentum.z[i];
+
+        double x = mcps.vertex.x[i];
+        double y = mcps.vertex.y[i];
+        double z = mcps.vertex.z[i];
+
+        TParticlePDG* pdg = pdgdb_->GetParticle(mcps.pdg[i]);
+
+        HPS_LOG(FINEST) << "Processing MCParticle: charge = " << charge
+                << "; vertex = (" << x << ", " << y << ", " << z
+                << "); " << "momentum = (" << px << ", " << py << ", "
+                << pz << ")" << std::endl;
+
+        TEveRecTrack *recTrack = new TEveRecTrack();
+        recTrack->fV.Set(TEveVector(x, y, z));
+        recTrack->fP.Set(px, py, pz);
+        recTrack->fSign = charge;
+
+        TEveTrack *track = new LCObjectElement<TEveTrack>(recTrack, nullptr);
+        if (pdg) {
+            track->SetElementName(pdg->GetName());
+        } else {
+            log(WARNING) << "Unknown PDG code: " << mcps.pdg[i] << std::endl;
+            track->SetElementName("Unknown");
+        }
+        if (charge != 0.0) {
+            track->SetMainColor(kRed);
+        } else {
+            track->SetMainColor(kYellow);
+        }
+
+        TVector3 p(px, py, pz);
+
+        // Decay point
+        TEveVector v(mcps.endpoint.x[i], mcps.endpoint.y[i], mcps.endpoint.z[i]);
+        TEvePathMark* pmDecay = new TEvePathMark(TEvePathMark::kDecay, v);
+        track->AddPathMark(*pmDecay);
+
+        trackMaker_->addTrack(track, charge != 0.0 ? propsetCharged : propsetNeutral);
+
+        track->SetUserData(new TrackUserData(store, i, p.Mag(), 0., &mcParticleTitle));
+
+        if (cuts != nullptr) {
+            CutTable::Values values;
+            values.values[CutTable::P] = p.Mag();
+            values.values[CutTable::PT] = p.Perp();
+            values.values[CutTable::CHARGE] = charge;
+            values.values[CutTable::PDG] = mcps.pdg[i];
+            values.values[CutTable::ENERGY] = mcps.energy[i];
+            values.values[CutTable::TIME] = mcps.time[i];
+            cuts->addRow(track, values);
+        }
+
+        return track;
+    }
+
+    bool EventObjects::expandMCParticles(TEveElement* element) {
+        MCParticleGroup* group = nullptr;
+        for (TEveElement::List_i it = element->BeginChildren(); group == nullptr && it != element->EndChildren(); it++) {
+            group = dynamic_cast<MCParticleGroup*>(*it);
+        }
+        if (group == nullptr) {
+            return false;
+        }
+        std::shared_ptr<const EventStore> store = group->getStore();
+        const EventStore::MCParticles& mcps = store->mcParticles;
+        int owner = group->getOwner();
+
+        // The most energetic daughters of the owner become tracks.
+        std::vector<int> roots = group->getRoots();
+        std::stable_sort(roots.begin(), roots.end(), [&mcps](int a, int b) {
+            return mcps.energy[a] > mcps.energy[b];
+        });
+        if (mcMaxParticles_ > 0 && (int) roots.size() > mcMaxParticles_) {
+            roots.resize(mcMaxParticles_);
+        }
+        CutTable* cuts = getCutTable(LCIO::MCPARTICLE);
+        TEveTrackPropagator *propsetCharged = getPropagator(true);
+        TEveTrackPropagator *propsetNeutral = getPropagator(false);
+        std::map<int, TEveTrack*> expanded;
+        for (size_t n = 0; n < roots.size(); n++) {
+            TEveTrack* track = createMCParticle(store, roots[n], propsetCharged, propsetNeutral, cuts);
+            element->AddElement(track);
+            expanded[roots[n]] = track;
+        }
+        trackMaker_->makeTracks();
+
+        // The other particles are grouped again below the new tracks, or stay
+        // below the owner.
+        std::map<int, std::vector<int>> groups;
+        std::map<int, int> owners;
+        const std::vector<int>& particles = group->getParticles();
+        for (size_t n = 0; n < particles.size(); n++) {
+            int i = particles[n];
+            if (expanded.count(i) > 0) {
+                continue;
+            }
+            int parent = mcps.parent[i];
+            int newOwner = parent == owner ? owner : (expanded.count(parent) > 0 ? parent : owners[parent]);
+            owners[i] = newOwner;
+            groups[newOwner].push_back(i);
+        }
+        for (std::map<int, std::vector<int>>::iterator it = groups.begin(); it != groups.end(); it++) {
+            TEveElement* parent = it->first == owner ? element : expanded[it->first];
+            parent->AddElement(new MCParticleGroup(store, it->first, parent, it->second, &mcParticleTitle));
+        }
+        for (std::map<int, TEveTrack*>::iterator it = expanded.begin(); it != expanded.end(); it++) {
+            it->second->SetPickableRecursively(true);
+        }
+
+        HPS_LOG(FINE) << "Expanded " << expanded.size() << " of " << particles.size()
+                << " collapsed MCParticles into " << groups.size() << " groups" << std::endl;
+
+        element->RemoveElement(group);
+        return true;
+    }
+
     /*
     void EventObjects::findSimTrackerHits(std::vector<EVENT::SimTrackerHit*>& list,
                                           EVENT::LCCollection* hits,
@@ -330,210 +816,279 @@ namespace hps {
     }
     */
 
-    TEveElementList* EventObjects::createCalClusters(EVENT::LCCollection* coll) {
+    TEveElementList* EventObjects::createCalClusters(const std::vector<int>& indices, int color) {
 
-        log(FINE) << "Creating clusters: " << coll->getNumberOfElements() << std::endl;
+        HPS_LOG(FINE) << "Creating clusters: " << indices.size() << std::endl;
 
-        TGeoManager* geo = app_->getDetectorGeometry()->getGeoManager();
+        DetectorGeometry* det = det_;
 
-        TEveElementList* elements = new TEveElementList();
+        const EventStore::Clusters& clusters = store_->clusters;
+        const EventStore::CalorimeterHits& hits = store_->clusterHits;
+
+        TEveElementList* elements = new DeferredStamp<TEveElementList>();
+
+        int nColors = color < 0 ? clusPalette_.size() : 1;
+
+        // Cluster centers are drawn with one point set per palette color
+        // and the hits of all clusters as one box set.
+        std::vector<LCPointSet*> centers(nColors, nullptr);
+        LCBoxSet* boxes = new LCBoxSet("CalorimeterHits", store_, &calorimeterHitTitle);
 
-        TStyle clusStyle = createClusStyle();
-        int nColors = clusStyle.GetNumberOfColors();
         int currColor = 0;
-        for (int i = 0; i < coll->getNumberOfElements(); i++) {
+        for (size_t n = 0; n < indices.size(); n++) {
 
             if (currColor > (nColors - 1)) {
                 currColor = 0;
             }
 
-            TEveCompound* compound = new TEveCompound();
-            compound->SetElementName("Cluster");
+            int i = indices[n];
+            float x = clusters.position.x[i];
+            float y = clusters.position.y[i];
+            float z = clusters.position.z[i];
 
-            EVENT::Cluster* clus = (EVENT::Cluster*)coll->getElementAt(i);
-            float x = clus->getPosition()[0]/10.0;
-            float y = clus->getPosition()[1]/10.0;
-            float z = clus->getPosition()[2]/10.0;
-
-            log(FINEST) << "Adding cluster at: ("
+            HPS_LOG(FINEST) << "Adding cluster at: ("
                     << x << "," << y << ", " << z << ")" << std::endl;
 
-            TEvePointSet* p = new TEvePointSet(1);
-            p->SetElementName("Cluster Center");
-            p->SetMarkerStyle(kStar);
-            p->SetMarkerSize(3.0);
-            p->SetPoint(0, x, y, z);
-            int color = clusStyle.GetColorPalette(currColor);
-            p->SetMarkerColor(color);
-            elements->AddElement(p);
-
-            auto hits = clus->getCalorimeterHits();
-            for (EVENT::CalorimeterHitVec::const_iterator it = hits.begin();
-                    it != hits.end();
-                    it++) {
-                auto hit = *it;
-                auto pos = hit->getPosition();
-                auto x = pos[0]/10.0;
-                auto y = pos[1]/10.0;
-                auto z = pos[2]/10.0;
-                geo->CdTop();
-                TGeoNode* node = geo->FindNode((double)x, (double)y, (double)z);
-                if (node != nullptr && node != geo->GetTopNode()) {
-                    log(FINEST) << "Found geo node: " << node->GetName() << std::endl;
-                } else {
+            int clusColor = color < 0 ? clusPalette_[currColor] : color;
+            LCPointSet* p = centers[currColor];
+            if (p == nullptr) {
+                p = new LCPointSet("Cluster Centers", indices.size(), store_, &clusterTitle);
+                p->SetMarkerStyle(kStar);
+                p->SetMarkerSize(3.0);
+                p->SetMarkerColor(clusColor);
+                elements->AddElement(p);
+                centers[currColor] = p;
+            }
+            p->addPoint(i, x, y, z);
+
+            int lastHit = clusters.firstHit[i] + clusters.nHits[i];
+            for (int h = clusters.firstHit[i]; h < lastHit; h++) {
+                double hitPos[3] = {hits.position.x[h], hits.position.y[h], hits.position.z[h]};
+                const DetectorGeometry::Crystal* crystal = det->findCrystal(hits.cellID[h], hitPos);
+                if (crystal == nullptr) {
                     // This could happen with a bad hit position.
                     log(ERROR) << "No geo node found for cal hit at: ("
-                            << x << ", " << y << ", " << z << ")"
+                            << hitPos[0] << ", " << hitPos[1] << ", " << hitPos[2] << ")"
                             << std::endl;
                     continue;
+                } else if (!crystal->hasVertices) {
+                    log(ERROR) << "Crystal cannot be drawn as a box: " << crystal->node->GetName() << std::endl;
+                    continue;
                 }
-                TEveElement* element = DetectorGeometry::toEveElement(geo, node);
-                element->SetElementName("CalorimeterHit");
-                element->SetMainColor(color);
-                p->AddElement(element);
+                boxes->addBox(h, crystal->vertices, clusColor);
             }
             ++currColor;
         }
+        boxes->RefitPlex();
+        elements->AddElement(boxes);
 
-        log("Done creating clusters!", FINE);
+        HPS_LOG(FINE) << "Done creating clusters!" << std::endl;
 
         return elements;
     }
 
-    TEveElementList* EventObjects::createReconTracks(EVENT::LCCollection* coll) {
+    TString EventObjects::clusterTitle(const EventStore& store, int i) {
+        const EventStore::Clusters& clusters = store.clusters;
+        return TString::Format("Cluster\n"
+                               "(x, y, z) = (%.3f, %.3f, %.3f)\n"
+                               "Energy = %.3f, Hits = %d",
+                               clusters.position.x[i] * 10., clusters.position.y[i] * 10.,
+                               clusters.position.z[i] * 10., clusters.energy[i], clusters.nHits[i]);
+    }
 
-        static double fieldConversion = 2.99792458e-4;
+    TEveElementList* EventObjects::createReconTracks(const std::vector<int>& indices, CutTable* cuts) {
 
-        auto elements = new TEveElementList();
+        auto elements = new DeferredStamp<TEveElementList>();
 
-        float bY = this->app_->getMagFieldY();
+        float bY = propagators_->getMagFieldY();
 
-        TEveTrackPropagator *propsetCharged = new TEveTrackPropagator();
-        propsetCharged->SetMagFieldObj(new TEveMagFieldConst(0.0, bY, 0.0));
-        propsetCharged->SetDelta(0.01);
-        propsetCharged->SetMaxR(150);
-        propsetCharged->SetMaxZ(200);
-        propsetCharged->SetMaxOrbs(2.0);
-        propsetCharged->SetFitReferences(true);
-        /*
-        propsetCharged->SetFitDaughters(true);
-        propsetCharged->SetFitCluster2Ds(false);
-        propsetCharged->SetFitDecay(false);
-        propsetCharged->SetFitLineSegments(false);
-        */
+        // Recon tracks are not fit to decays, 2D clusters or line segments.
+        PropagatorRegistry::Settings settings = getPropagatorSettings(true);
+        settings.fitDecay = false;
+        settings.fitCluster2Ds = false;
+        settings.fitLineSegments = false;
+        TEveTrackPropagator *propsetCharged = propagators_->getPropagator(settings);
 
-        for (int i = 0; i < coll->getNumberOfElements(); i++) {
+        const EventStore::Tracks& tracks = store_->tracks;
+        const EventStore::TrackStates& states = store_->trackStates;
 
-            auto track = (EVENT::Track*) coll->getElementAt(i);
+        for (size_t n = 0; n < indices.size(); n++) {
 
-            if (track == nullptr) {
-                log(WARNING) << "Got a track that points to null!" << std::endl;
-                continue;
-            }
+            int i = indices[n];
 
-            if (track->getTrackStates().size() == 0) {
+            if (tracks.nStates[i] == 0) {
                 log(WARNING) << "Got a track with no track states!" << std::endl;
                 continue;
             }
 
-            auto ts = track->getTrackState(EVENT::TrackState::AtIP);
-
-            float omega = ts->getOmega();
-            double pt = bY * fieldConversion / abs(omega);
-
-            double px = pt * cos(ts->getPhi());
-            double py = pt * sin(ts->getPhi());
-            double pz = pt * ts->getTanLambda();
+            // Helices of the track states ordered along the beam
+            std::vector<std::pair<double, Helix>> helices;
+            int lastState = tracks.firstState[i] + tracks.nStates[i];
+            for (int j = tracks.firstState[i]; j < lastState; j++) {
+                Helix helix(states, j);
+                helices.push_back(std::make_pair(helix.getPosition(0.).Z(), helix));
+            }
+            std::stable_sort(helices.begin(), helices.end(),
+                    [](const std::pair<double, Helix>& a, const std::pair<double, Helix>& b) {
+                        return a.first < b.first;
+                    });
 
-            TVector3 p(px, py, pz);
-            p.RotateY(-(TMath::Pi() / 2));
-            p.RotateZ(-(TMath::Pi() / 2));
+            int ts = tracks.ipState[i];
 
-            track->getChi2();
+            TVector3 p = getTrackMomentum(states, ts, bY);
 
-            auto refPoint = track->getReferencePoint();
-            double charge = omega > 0. ? charge = -1 : charge = 1;
+            double charge = states.omega[ts] > 0. ? -1 : 1;
 
-            log(FINEST) << "Making track with (px, py, pz) = ("
-                    << px << ", " << py << ", " << pz << ")"
-                    << std::endl;
+            HPS_LOG(FINEST) << "Making track with (px, py, pz) = ("
+                    << p.X() << ", " << p.Y() << ", " << p.Z() << ") from "
+                    << tracks.nStates[i] << " track states" << std::endl;
 
             TEveRecTrack *recTrack = new TEveRecTrack();
-            recTrack->fV.Set(TEveVector(refPoint[0], refPoint[1], refPoint[2]));
+            recTrack->fV.Set(helices[0].second.getPosition(0.));
             recTrack->fP.Set(p);
             recTrack->fSign = charge;
 
-            TEveTrack *eveTrack = new TEveTrack(recTrack, nullptr);
+            // Segments end where the next track state starts and a single one
+            // ends at the bounds of the propagator.
+            HelixTrack *eveTrack = new HelixTrack(recTrack, nullptr);
+            for (size_t j = 0; j + 1 < helices.size(); j++) {
+                const Helix& helix = helices[j].second;
+                eveTrack->addSegment(helix, helix.getPathLength(helices[j + 1].second.getPosition(0.)));
+            }
+            if (helices.size() == 1) {
+                eveTrack->addOpenSegment(helices[0].second);
+            }
             eveTrack->SetElementName("Track");
-            eveTrack->SetPropagator(propsetCharged);
             eveTrack->SetMainColor(kGreen);
 
-            // For "rotated" hits, use this correction from PF
-            // x->z, y->x, z->y
-
-            // Path marks for hits
-            /*
-            eveTrack->SetMarkerColor(kGreen);
-            eveTrack->SetMarkerStyle(kFullCircle);
-            eveTrack->SetMarkerSize(1);
-            const EVENT::TrackerHitVec& hits = track->getTrackerHits();
-            for (EVENT::TrackerHitVec::const_iterator it = hits.begin(); it != hits.end();
-                    it++) {
-                EVENT::TrackerHit* hit = *it;
-                const double* hitPos = hit->getPosition();
-                TEveVector v(hitPos[0]/10.0, hitPos[1]/10., hitPos[2]/10.);
-                TEvePathMark* pm = new TEvePathMark(TEvePathMark::kReference, v, hit->getTime());
-                eveTrack->AddPathMark(*pm);
-                log(FINEST) << "Added TrackerHit path mark at: ("
-                        << hitPos[0] << ", " << hitPos[1] << ", " << hitPos[2] << ") [mm]"
-                        << std::endl;
-            }
-            eveTrack->SetRnrPoints(true);
-            */
-
-            eveTrack->SetElementTitle(Form("Recon Track\n"
-                    "(x, y, z) = (%.3f, %.3f, %.3f)\n"
-                    "(Px, Py, Pz) = (%.3f, %.3f, %.3f)\n"
-                    "Charge = %.3f, P = %.3f, Chi2 = %.3f",
-                    refPoint[0], refPoint[1], refPoint[2],
-                    p.X(), p.Y(), p.Z(), charge, p.Mag(),
-                    track->getChi2()));
-
-            eveTrack->SetUserData(new TrackUserData(track, p.Mag()));
-            eveTrack->MakeTrack();
+            eveTrack->SetUserData(new TrackUserData(store_, i, p.Mag(), tracks.chi2[i], &reconTrackTitle));
+
+            if (cuts != nullptr) {
+                CutTable::Values values;
+                values.values[CutTable::P] = p.Mag();
+                values.values[CutTable::PT] = p.Perp();
+                values.values[CutTable::CHI2] = tracks.chi2[i];
+                values.values[CutTable::CHARGE] = charge;
+                values.values[CutTable::NHITS] = tracks.nHits[i];
+                cuts->addRow(eveTrack, values);
+            }
+            trackMaker_->addTrack(eveTrack, propsetCharged);
             elements->AddElement(eveTrack);
         }
 
         return elements;
     }
 
-    TEveElementList* EventObjects::createVertices(EVENT::LCCollection* coll) {
-        TEveElementList* elements = new TEveElementList();
-        for (int i = 0; i < coll->getNumberOfElements(); i++) {
-            EVENT::Vertex* vertex = (EVENT::Vertex*) coll->getElementAt(i);
-            auto chi2 = vertex->getChi2();
-            auto position = vertex->getPosition();
-            auto algoType = vertex->getAlgorithmType();
-            auto probability = vertex->getProbability();
-            log(FINE) << "Adding vertex at: ("
-                    << position[0] << ", " << position[1] << ", " << position[2] << ")"
+    TEveElementList* EventObjects::createVertices(const std::vector<int>& indices) {
+        const EventStore::Vectors& position = store_->vertices.position;
+        TEveElementList* elements = new DeferredStamp<TEveElementList>();
+        LCPointSet* vertices = new LCPointSet("Vertex", indices.size(), store_, &vertexTitle);
+        vertices->SetMarkerStyle(kCircle);
+        vertices->SetMarkerSize(1.0);
+        vertices->SetMarkerColor(kWhite);
+        for (size_t n = 0; n < indices.size(); n++) {
+            int i = indices[n];
+            HPS_LOG(FINE) << "Adding vertex at: ("
+                    << position.x[i] << ", " << position.y[i] << ", " << position.z[i] << ")"
                     << std::endl;
-            TEvePointSet* p = new TEvePointSet(1);
-            p->SetElementName("Vertex");
-            p->SetMarkerStyle(kCircle);
-            p->SetMarkerSize(1.0);
-            p->SetPoint(0, position[0]/10., position[1]/10., position[2]/10.);
-            p->SetMarkerColor(kWhite);
-            p->SetElementTitle(Form("Vertex\n"
-                    "x, y, z = (%.3f, %.3f, %.3f)\n"
-                    "chi2 = %.3f, probability = %.3f",
-                    position[0], position[1], position[2],
-                    chi2, probability));
-            elements->AddElement(p);
+            vertices->addPoint(i, position.x[i], position.y[i], position.z[i]);
         }
+        elements->AddElement(vertices);
         return elements;
     }
 
+    TString EventObjects::vertexTitle(const EventStore& store, int i) {
+        const EventStore::Vertices& vertices = store.vertices;
+        return TString::Format("Vertex\n"
+                               "x, y, z = (%.3f, %.3f, %.3f)\n"
+                               "chi2 = %.3f, probability = %.3f",
+                               vertices.position.x[i] * 10., vertices.position.y[i] * 10.,
+                               vertices.position.z[i] * 10., vertices.chi2[i], vertices.probability[i]);
+    }
+
+    TVector3 EventObjects::getTrackMomentum(const EventStore::TrackStates& states, int i, double bY) {
+
+        static double fieldConversion = 2.99792458e-4;
+
+        double pt = bY * fieldConversion / std::abs(states.omega[i]);
+
+        double px = pt * cos(states.phi[i]);
+        double py = pt * sin(states.phi[i]);
+        double pz = pt * states.tanLambda[i];
+
+        // From the tracking frame to the detector frame
+        TVector3 p(px, py, pz);
+        p.RotateY(-(TMath::Pi() / 2));
+        p.RotateZ(-(TMath::Pi() / 2));
+        return p;
+    }
+
+    TString EventObjects::mcParticleTitle(const EventStore& store, int i) {
+        const EventStore::MCParticles& mcps = store.mcParticles;
+        TEveVector vertex(mcps.vertex.x[i], mcps.vertex.y[i], mcps.vertex.z[i]);
+        TEveVector endpoint(mcps.endpoint.x[i], mcps.endpoint.y[i], mcps.endpoint.z[i]);
+        TVector3 p(mcps.momentum.x[i], mcps.momentum.y[i], mcps.momentum.z[i]);
+        return TString::Format("MC Particle\n"
+                               "(x, y, z) = (%.3f, %.3f, %.3f)\n"
+                               "(Px, Py, Pz) = (%.3f, %.3f, %.3f)\n"
+                               "Charge = %.3f, Energy = %.3f, Length = %.3f\n"
+                               "P = %.3f",
+                               vertex.fX, vertex.fY, vertex.fZ,
+                               p.X(), p.Y(), p.Z(),
+                               mcps.charge[i], mcps.energy[i], vertex.Distance(endpoint),
+                               p.Mag());
+    }
+
+    TString EventObjects::reconTrackTitle(const EventStore& store, int i) {
+        const EventStore::Tracks& tracks = store.tracks;
+        int ts = tracks.ipState[i];
+        if (ts < 0) {
+            return TString();
+        }
+        TVector3 p = getTrackMomentum(store.trackStates, ts, EventDisplay::getInstance()->getMagFieldY());
+        return TString::Format("Recon Track\n"
+                               "(x, y, z) = (%.3f, %.3f, %.3f)\n"
+                               "(Px, Py, Pz) = (%.3f, %.3f, %.3f)\n"
+                               "Charge = %.3f, P = %.3f, Chi2 = %.3f",
+                               tracks.referencePoint.x[i] * 10., tracks.referencePoint.y[i] * 10.,
+                               tracks.referencePoint.z[i] * 10.,
+                               p.X(), p.Y(), p.Z(), store.trackStates.omega[ts] > 0. ? -1. : 1., p.Mag(),
+                               tracks.chi2[i]);
+    }
+
+    TString EventObjects::reconstructedParticleTitle(const EventStore& store, int i) {
+        const EventStore::ReconstructedParticles& particles = store.particles;
+        TVector3 p(particles.momentum.x[i], particles.momentum.y[i], particles.momentum.z[i]);
+        return TString::Format("Reconstructed Particle\n"
+                               "(x, y, z) = (%.3f, %.3f, %.3f)\n"
+                               "(Px, Py, Pz) = (%.3f, %.3f, %.3f)\n"
+                               "Charge = %.3f, Energy = %.3f, PID = %d\n"
+                               "P = %.3f",
+                               particles.start.x[i] * 10., particles.start.y[i] * 10., particles.start.z[i] * 10.,
+                               p.X(), p.Y(), p.Z(),
+                               particles.charge[i], particles.energy[i], particles.pdg[i],
+                               p.Mag());
+    }
+
+    PropagatorRegistry::Settings EventObjects::getPropagatorSettings(bool charged) {
+        PropagatorRegistry::Settings settings;
+        settings.charged = charged;
+        settings.maxOrbs = charged ? 2.0 : 1.0;
+        return settings;
+    }
+
+    TEveTrackPropagator* EventObjects::getPropagator(bool charged) {
+        return propagators_->getPropagator(getPropagatorSettings(charged));
+    }
+
+    std::vector<Color_t> EventObjects::getPaletteColors(TStyle& style) {
+        std::vector<Color_t> colors;
+        for (int i = 0; i < style.GetNumberOfColors(); i++) {
+            colors.push_back(style.GetColorPalette(i));
+        }
+        return colors;
+    }
+
     TStyle EventObjects::createClusStyle() {
         Int_t clusPalette[12];
         clusPalette[0] = kRed;
@@ -556,257 +1111,140 @@ namespace hps {
     void EventObjects::setMCPCut(double cut) {
         mcPCut = cut;
         log(INFO) << "Setting new MCParticle P cut: " << cut << std::endl;
-        const std::vector<TEveElementList*>& particleLists = getElementsByType(std::string(LCIO::MCPARTICLE));
-        if (particleLists.size() > 0) {
-            for (std::vector<TEveElementList*>::const_iterator it = particleLists.begin();
-                    it != particleLists.end(); it++) {
-                TEveElementList* particleList = *(it);
-                applyPCut(particleList, mcPCut);
-            }
-        }
+        applyRange(LCIO::MCPARTICLE, P_CUT, CutTable::P, cut, std::numeric_limits<double>::infinity());
     }
 
     void EventObjects::setTrackPCut(double cut) {
         trackPCut = cut;
         log(INFO) << "Setting new Track P cut: " << cut << std::endl;
-        const std::vector<TEveElementList*>& trackLists = getElementsByType(std::string(LCIO::TRACK));
-        if (trackLists.size() > 0) {
-            for (std::vector<TEveElementList*>::const_iterator it = trackLists.begin();
-                    it != trackLists.end(); it++) {
-                TEveElementList* particleList = *(it);
-                log(FINE) << "Applying P cut to: " << particleList->GetElementName() << std::endl;
-                applyPCut(particleList, trackPCut);
-            }
-        }
-    }
-
-    void EventObjects::applyPCut(TEveElement* element, double& cut) {
-        if (element->GetUserData() != nullptr) {
-            TrackUserData* trackData = (TrackUserData*)(element->GetUserData());
-            if (trackData != nullptr) {
-                double p = trackData->p();
-                if (p < cut) {
-                    log(FINEST) << "Cutting Track with P: " << p << std::endl;
-                    element->SetRnrSelf(false);
-                } else {
-                    element->SetRnrSelf(true);
-                }
-            }
-        }
-        for (TEveElement::List_i it = element->BeginChildren();
-                it != element->EndChildren(); it++) {
-            TEveTrack* track = dynamic_cast<TEveTrack*>(*(it));
-            applyPCut(track, cut);
-        }
+        applyRange(LCIO::TRACK, P_CUT, CutTable::P, cut, std::numeric_limits<double>::infinity());
     }
 
     void EventObjects::setChi2Cut(double cut) {
         chi2Cut_ = cut;
         log(INFO) << "Setting new Track chi2 cut: " << cut << std::endl;
-        const std::vector<TEveElementList*>& trackLists = getElementsByType(std::string(LCIO::TRACK));
-        if (trackLists.size() > 0) {
-            for (std::vector<TEveElementList*>::const_iterator it = trackLists.begin();
-                    it != trackLists.end(); it++) {
-                TEveElementList* trackList = *(it);
-                applyChi2Cut(trackList);
-            }
-        }
-    }
-
-    void EventObjects::applyChi2Cut(TEveElementList* trackList) {
-        for (TEveElementList::List_i it = trackList->BeginChildren();
-                it != trackList->EndChildren();
-                it++ ) {
-            TEveElement* element = *it;
-            if (element->GetUserData() != nullptr) {
-                LCObjectUserData* userData = (LCObjectUserData*) element->GetUserData();
-                EVENT::Track* track = (EVENT::Track*) userData->getLCObject();
-                if (track->getChi2() > chi2Cut_) {
-                    log(FINEST) << "Cutting Track with chi2: " << track->getChi2() << std::endl;
-                    element->SetRnrSelf(false);
-                } else {
-                    element->SetRnrSelf(true);
-                }
+        applyRange(LCIO::TRACK, CHI2_CUT, CutTable::CHI2, -std::numeric_limits<double>::infinity(), cut);
+    }
+
+    void EventObjects::setCutExpression(const std::string& expression) {
+        cutExpression_ = expression;
+        CutTable::CutFunction function = nullptr;
+        if (expression.find_first_not_of(" \t") != std::string::npos) {
+            log(INFO) << "Setting new cut expression: " << expression << std::endl;
+            function = compiler_->compile(expression);
+            if (function == nullptr) {
+                log(WARNING) << "Removing the cut expression, which is not valid" << std::endl;
             }
         }
+        for (CutTables::iterator it = cutTables_.begin(); it != cutTables_.end(); it++) {
+            int changed = it->second->setFunction(EXPRESSION_CUT, function);
+            HPS_LOG(FINE) << "Cut expression changed " << changed << " of "
+                    << it->second->getNumberOfRows() << " " << it->first << " elements" << std::endl;
+        }
     }
 
-    TEveElementList* EventObjects::createReconstructedParticles(EVENT::LCCollection* coll) {
+    void EventObjects::applyRange(const std::string& typeName, int cut, CutTable::Column column,
+                                  double min, double max) {
+        CutTable* table = getCutTable(typeName);
+        if (table != nullptr) {
+            int changed = table->setRange(cut, column, min, max);
+            HPS_LOG(FINE) << "Cut changed " << changed << " of "
+                    << table->getNumberOfRows() << " " << typeName << " elements" << std::endl;
+        }
+    }
 
-        TEveTrackPropagator *propsetCharged = new TEveTrackPropagator();
-        propsetCharged->SetMagFieldObj(new TEveMagFieldConst(0.0, app_->getMagFieldY(), 0.0));
-        propsetCharged->SetDelta(0.01);
-        propsetCharged->SetMaxR(150);
-        propsetCharged->SetMaxZ(200);
-        propsetCharged->SetMaxOrbs(2.0);
-        propsetCharged->SetFitDecay(true);
+    TEveElementList* EventObjects::createReconstructedParticles(const EventStore::Collection& coll,
+                                                                CutTable* cuts) {
 
-        TEveTrackPropagator *propsetNeutral = new TEveTrackPropagator();
-        propsetNeutral->SetMagFieldObj(new TEveMagFieldConst(0.0, app_->getMagFieldY(), 0.0));
-        propsetNeutral->SetDelta(0.01);
-        propsetNeutral->SetMaxR(150);
-        propsetNeutral->SetMaxZ(200);
-        propsetNeutral->SetMaxOrbs(1.0);
-        propsetNeutral->SetFitDecay(true);
+        TEveTrackPropagator *propsetCharged = getPropagator(true);
+        TEveTrackPropagator *propsetNeutral = getPropagator(false);
 
-        TStyle style;
-        style.SetPalette(kRainBow); // FIXME: hard-coded color palette
-        int nColors = style.GetNumberOfColors();
-        TEveElementList* elements = new TEveElementList();
-        //std::map<EVENT::ReconstructedParticle*, TEveCompound*> particleMap;
-        for (int i = 0; i < coll->getNumberOfElements(); i++) {
+        const EventStore::ReconstructedParticles& particles = store_->particles;
+        const EventStore::Vertices& vertices = store_->vertices;
+        const EventStore::Tracks& tracks = store_->tracks;
 
-            log(FINEST) << "Creating recon particle: " << i << std::endl;
+        int nColors = particlePalette_.size();
+        TEveElementList* elements = new DeferredStamp<TEveElementList>();
+        for (int i = coll.begin; i < coll.end; i++) {
 
-            int color = style.GetColorPalette(rand() % nColors);
+            HPS_LOG(FINEST) << "Creating recon particle: " << i << std::endl;
 
-            EVENT::ReconstructedParticle* particle =
-                    dynamic_cast<EVENT::ReconstructedParticle*>(coll->getElementAt(i));
+            // Colors step through the palette by the position of the particle, so
+            // that neighbours differ and an event is drawn the same way every time.
+            int color = particlePalette_[((i - coll.begin) * PARTICLE_COLOR_STRIDE) % nColors];
 
-            TEveCompound* compound = new TEveCompound("ReconstructedParticle");
+            TEveCompound* compound = new LCObjectElement<TEveCompound>("ReconstructedParticle");
             compound->OpenCompound();
 
-            auto charge = particle->getCharge();
-            auto endVertex = particle->getEndVertex();
-            auto energy = particle->getEnergy();
-            auto mass = particle->getMass();
-            auto momentum = particle->getMomentum();
-            auto px = momentum[0];
-            auto py = momentum[1];
-            auto pz = momentum[2];
-            auto pid = particle->getParticleIDUsed();
-            auto startVertex = particle->getStartVertex();
-
-            float* startPosition = nullptr;
-            if (startVertex != nullptr) {
-                startPosition = const_cast<float*>(startVertex->getPosition());
-                log(FINEST) << "Using vertex for start position." << std::endl;
-            } else {
-                startPosition = const_cast<float*>(particle->getReferencePoint());
-                log(FINEST) << "Using reference point for start position." << std::endl;
-            }
+            float charge = particles.charge[i];
+            int startVertex = particles.startVertex[i];
+            int endVertex = particles.endVertex[i];
 
-            float* endPosition = nullptr;
-            if (endVertex != nullptr) {
-                endPosition = const_cast<float*>(endVertex->getPosition());
-            }
+            TVector3 p(particles.momentum.x[i], particles.momentum.y[i], particles.momentum.z[i]);
 
-            TVector3 p(px, py, pz);
-
-            int pdg = 0;
-            if (pid != nullptr) {
-                pdg = pid->getPDG();
-            }
-            auto title = Form("Reconstructed Particle\n"
-                    "(x, y, z) = (%.3f, %.3f, %.3f)\n"
-                    "(Px, Py, Pz) = (%.3f, %.3f, %.3f)\n"
-                    "Charge = %.3f, Energy = %.3f, PID = %d\n"
-                    "P = %.3f",
-                    startPosition[0], startPosition[1], startPosition[2],
-                    px, py, pz,
-                    charge, energy, pdg,
-                    p.Mag());
+            // Picks of the particle's elements are forwarded to the compound.
+            compound->SetUserData(new LCObjectUserData(store_, i, &reconstructedParticleTitle));
 
             // Create a track for the particle itself.
             TEveRecTrack *recTrack = new TEveRecTrack();
-            recTrack->fV.Set(TEveVector(startPosition[0]/10., startPosition[1]/10., startPosition[2]/10.));
+            recTrack->fV.Set(TEveVector(particles.start.x[i], particles.start.y[i], particles.start.z[i]));
             recTrack->fP.Set(p);
             recTrack->fSign = charge;
-            TEveTrack *eveTrack = new TEveTrack(recTrack, nullptr);
+            TEveTrack *eveTrack = new DeferredStamp<TEveTrack>(recTrack, nullptr);
             eveTrack->SetElementName("Track");
-            if (charge != 0) {
-                eveTrack->SetPropagator(propsetCharged);
-            } else {
-                eveTrack->SetPropagator(propsetNeutral);
-            }
             eveTrack->SetMainColor(color);
-            eveTrack->SetElementTitle(title);
             eveTrack->SetElementName("Particle");
 
             // Add the end vertex as a path mark, if it exists.
-            if (endPosition != nullptr) {
-                log(FINEST) << "Adding decay PM at: ("
-                        << endPosition[0] << ", " << endPosition[1] << ", " << endPosition[2] << ")"
-                        << std::endl;
-                TEveVector v(endPosition[0]/10., endPosition[1]/10., endPosition[2]/10.);
+            if (endVertex >= 0) {
+                TEveVector v(vertices.position.x[endVertex], vertices.position.y[endVertex],
+                             vertices.position.z[endVertex]);
+                HPS_LOG(FINEST) << "Adding decay PM at: ("
+                        << v.fX << ", " << v.fY << ", " << v.fZ << ")" << std::endl;
                 TEvePathMark* pmDecay = new TEvePathMark(TEvePathMark::kDecay, v);
                 eveTrack->AddPathMark(*pmDecay);
             }
 
-            eveTrack->MakeTrack(false);
+            trackMaker_->addTrack(eveTrack, charge != 0 ? propsetCharged : propsetNeutral);
             compound->AddElement(eveTrack);
 
             // Create tracks and set their color.
-            auto tracks = particle->getTracks();
-            log(FINEST) << "Creating n tracks: " << tracks.size() << std::endl;
-            IMPL::LCCollectionVec trackVec(LCIO::TRACK);
-            trackVec.setSubset(true);
-            for (EVENT::TrackVec::const_iterator it = tracks.begin();
-                    it != tracks.end(); it++) {
-                trackVec.push_back(*it);
-            }
-            TEveElementList* trackList = createReconTracks(&trackVec);
+            std::vector<int>::const_iterator firstTrack = store_->particleTracks.begin() + particles.firstTrack[i];
+            std::vector<int> trackIndices(firstTrack, firstTrack + particles.nTracks[i]);
+            HPS_LOG(FINEST) << "Creating n tracks: " << trackIndices.size() << std::endl;
+            TEveElementList* trackList = createReconTracks(trackIndices);
             trackList->SetElementName("Tracks");
             for (TEveElementList::List_i it = trackList->BeginChildren();
                     it != trackList->EndChildren(); it++) {
                 (*it)->SetMainColor(color);
-                (*it)->SetElementTitle(title);
                 (*it)->SetRnrSelf(false);
             }
             compound->AddElement(trackList);
 
             // Build clusters and set their color.
-            auto clusters = particle->getClusters();
-            log(FINEST) << "Creating n clusters: " << tracks.size() << std::endl;
-            IMPL::LCCollectionVec clusterVec(LCIO::CLUSTER);
-            clusterVec.setSubset(true);
-            for (EVENT::ClusterVec::const_iterator it = clusters.begin();
-                    it != clusters.end(); it++) {
-                EVENT::Cluster* clus = *it;
-                const float* pos = clus->getPosition();
-                log(FINEST) << "Adding cluster at: ("
-                        << pos[0] << ", " << pos[1] << ", " << pos[2]
-                        << ")" << std::endl;
-                clusterVec.push_back(*it);
-            }
-            TEveElementList* clusterList = createCalClusters(&clusterVec);
+            std::vector<int>::const_iterator firstCluster =
+                    store_->particleClusters.begin() + particles.firstCluster[i];
+            std::vector<int> clusterIndices(firstCluster, firstCluster + particles.nClusters[i]);
+            HPS_LOG(FINEST) << "Creating n clusters: " << clusterIndices.size() << std::endl;
+            TEveElementList* clusterList = createCalClusters(clusterIndices, color);
             clusterList->SetElementName("Clusters");
-            for (TEveElementList::List_i it = clusterList->BeginChildren();
-                    it != clusterList->EndChildren(); it++) {
-                TEveElement* clusterElement = (*it);
-                clusterElement->SetMainColor(color);
-                clusterElement->SetElementTitle(title);
-                for (TEveElement::List_i it2 = clusterElement->BeginChildren();
-                        it2 != clusterElement->EndChildren();
-                        it2++) {
-                    TEveElement* hitElement = (*it2);
-                    hitElement->SetMainColor(color);
-                    hitElement->SetElementTitle(title);
-                }
-            }
             compound->AddElement(clusterList);
 
             // Draw start vertex and set the color.
-            if (startVertex != nullptr) {
-                log(FINEST) << "Adding start vertex" << std::endl;
-                IMPL::LCCollectionVec vertexVec(LCIO::VERTEX);
-                vertexVec.setSubset(true);
-                vertexVec.push_back(startVertex);
-                TEveElementList* vertices = createVertices(&vertexVec);
-                TEveElement* vertexElement = (*vertices->BeginChildren());
+            if (startVertex >= 0) {
+                HPS_LOG(FINEST) << "Adding start vertex" << std::endl;
+                TEveElementList* vertexList = createVertices(std::vector<int>(1, startVertex));
+                TEveElement* vertexElement = (*vertexList->BeginChildren());
                 vertexElement->SetMainColor(color);
                 vertexElement->SetElementName("Start Vertex");
                 compound->AddElement(vertexElement);
             }
 
             // Draw end vertex and set the color.
-            if (endVertex != nullptr) {
-                log(FINEST) << "Adding end vertex" << std::endl;
-                IMPL::LCCollectionVec vertexVec(LCIO::VERTEX);
-                vertexVec.setSubset(true);
-                vertexVec.push_back(endVertex);
-                TEveElementList* vertices = createVertices(&vertexVec);
-                TEveElement* vertexElement = (*vertices->BeginChildren());
+            if (endVertex >= 0) {
+                HPS_LOG(FINEST) << "Adding end vertex" << std::endl;
+                TEveElementList* vertexList = createVertices(std::vector<int>(1, endVertex));
+                TEveElement* vertexElement = (*vertexList->BeginChildren());
                 vertexElement->SetMainColor(color);
                 vertexElement->SetElementName("End Vertex");
                 compound->AddElement(vertexElement);
@@ -815,7 +1253,21 @@ namespace hps {
             compound->CloseCompound();
             compound->SetRnrSelfChildren(true, true);
             elements->AddElement(compound);
-            log(FINEST) << "Done creating recon particle: " << i << std::endl;
+
+            CutTable::Values values;
+            values.values[CutTable::P] = p.Mag();
+            values.values[CutTable::PT] = p.Perp();
+            values.values[CutTable::CHARGE] = charge;
+            values.values[CutTable::ENERGY] = particles.energy[i];
+            values.values[CutTable::PDG] = particles.pdg[i];
+            if (!trackIndices.empty()) {
+                values.values[CutTable::CHI2] = tracks.chi2[trackIndices[0]];
+            }
+            for (size_t j = 0; j < trackIndices.size(); j++) {
+                values.values[CutTable::NHITS] += tracks.nHits[trackIndices[j]];
+            }
+            cuts->addRow(compound, values);
+            HPS_LOG(FINEST) << "Done creating recon particle: " << i << std::endl;
         }
 
         return elements;
@@ -825,4 +1277,45 @@ namespace hps {
         return typeMap_[typeName];
     }
 
+    const EventObjects::TypeMap& EventObjects::getTypeMap() {
+        return typeMap_;
+    }
+
+    CutTable* EventObjects::getCutTable(const std::string& typeName) {
+        CutTables::iterator it = cutTables_.find(typeName);
+        return it != cutTables_.end() ? it->second.get() : nullptr;
+    }
+
+    const EventObjects::CutTables& EventObjects::getCutTables() {
+        return cutTables_;
+    }
+
+    void EventObjects::setCutTables(const CutTables& cutTables) {
+        cutTables_ = cutTables;
+    }
+
+    const EventObjects::BuildTimes& EventObjects::getBuildTimes() {
+        return buildTimes_;
+    }
+
+    double EventObjects::getMakeTracksTime() {
+        return makeTracksTime_;
+    }
+
+    double EventObjects::getDecodeTime() {
+        return decodeTime_;
+    }
+
+    std::shared_ptr<const EventStore> EventObjects::getStore() {
+        return store_;
+    }
+
+    void EventObjects::setStore(std::shared_ptr<const EventStore> store) {
+        store_ = store;
+    }
+
+    void EventObjects::setTypeMap(const TypeMap& typeMap) {
+        typeMap_ = typeMap;
+    }
+
 } /* namespace hps */
@@ -0,0 +1,122 @@
+#include "EventPrebuilder.h"
+
+// HPS
+#include "EventObjects.h"
+#include "EventReadAhead.h"
+#include "PropagatorRegistry.h"
+#include "ThreadPool.h"
+
+// ROOT
+#include "TDatabasePDG.h"
+
+// C++ standard library
+#include <chrono>
+
+namespace hps {
+
+    EventPrebuilder::EventPrebuilder(EventReadAhead* readAhead, DetectorGeometry* det, double bY) :
+            Logger("EventPrebuilder"),
+            readAhead_(readAhead),
+            propagators_(new PropagatorRegistry(bY)),
+            builder_(new EventObjects(det, propagators_)),
+            pool_(new ThreadPool(1)) {
+
+        // The PDG table is read on first use.
+        TDatabasePDG::Instance()->GetParticle(11);
+    }
+
+    EventPrebuilder::~EventPrebuilder() {
+        cancel();
+        delete pool_;
+        delete builder_;
+        delete propagators_;
+    }
+
+    void EventPrebuilder::setLogLevel(int level) {
+        Logger::setLogLevel(level);
+        propagators_->setLogLevel(level);
+        builder_->setLogLevel(level);
+    }
+
+    void EventPrebuilder::setExcludedCollections(const std::set<std::string>& names,
+                                                 const std::set<std::string>& types) {
+        builder_->setExcludedCollections(names, types);
+    }
+
+    void EventPrebuilder::setMCDetail(double minEnergy, int maxDepth, int maxParticles) {
+        builder_->setMCDetail(minEnergy, maxDepth, maxParticles);
+    }
+
+    void EventPrebuilder::start(int i) {
+        cancel();
+        HPS_LOG(FINE) << "Prebuilding event: " << i << std::endl;
+        eventNum_ = i;
+        future_ = pool_->submit([this, i]() {
+            build(i);
+        });
+    }
+
+    bool EventPrebuilder::isStarted() {
+        return future_.valid();
+    }
+
+    bool EventPrebuilder::isReady() {
+        return future_.valid() && future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    int EventPrebuilder::getEventNumber() {
+        return eventNum_;
+    }
+
+    SceneCache::Scene* EventPrebuilder::take() {
+        wait();
+        SceneCache::Scene* scene = scene_;
+        scene_ = nullptr;
+        return scene;
+    }
+
+    void EventPrebuilder::cancel() {
+        SceneCache::Scene* scene = take();
+        if (scene != nullptr) {
+            HPS_LOG(FINE) << "Dropping prebuilt event: " << eventNum_ << std::endl;
+            SceneCache::destroy(scene);
+        }
+    }
+
+    void EventPrebuilder::setMagFieldY(double bY) {
+        wait();
+        propagators_->setMagFieldY(bY);
+    }
+
+    double EventPrebuilder::getBuildTime() {
+        return buildTime_;
+    }
+
+    void EventPrebuilder::build(int i) {
+        auto start = std::chrono::steady_clock::now();
+        std::shared_ptr<const EventStore> store = readAhead_->take(i);
+        if (store == nullptr) {
+            log(ERROR) << "Failed to read event: " << i << std::endl;
+            return;
+        }
+        SceneCache::Scene* scene = new SceneCache::Scene();
+        std::vector<TEveElementList*> elementLists = builder_->build(nullptr, store);
+        for (size_t l = 0; l < elementLists.size(); l++) {
+            // Held like the elements of a cached scene until they are shown.
+            elementLists[l]->IncDenyDestroy();
+            scene->elements.push_back(elementLists[l]);
+        }
+        scene->typeMap = builder_->getTypeMap();
+        scene->cutTables = builder_->getCutTables();
+        scene->store = builder_->getStore();
+        scene_ = scene;
+        buildTime_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void EventPrebuilder::wait() {
+        if (future_.valid()) {
+            // Rethrows an exception of the build.
+            future_.get();
+        }
+    }
+}
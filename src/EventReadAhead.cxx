@@ -0,0 +1,305 @@
+#include "EventReadAhead.h"
+
+// HPS
+#include "LcioLock.h"
+#include "StageTimer.h"
+
+// LCIO
+#include "EVENT/LCEvent.h"
+#include "IOIMPL/LCFactory.h"
+
+// C++ standard library
+#include <algorithm>
+#include <stdexcept>
+
+namespace hps {
+
+    EventReadAhead::EventReadAhead(EventIndex* index, int depth) :
+            Logger("EventReadAhead"),
+            index_(index),
+            depth_(depth),
+            step_([](int i, int dir) { return i + dir; }) {
+
+        if (depth_ < 0) {
+            throw std::runtime_error("Read ahead depth must not be negative.");
+        }
+
+        // Events ahead in the predicted direction, one behind and the one on screen.
+        slots_.resize(depth_ + 2);
+        readers_.resize(index_->getNumberOfFiles(), nullptr);
+    }
+
+    EventReadAhead::~EventReadAhead() {
+        stop();
+    }
+
+    void EventReadAhead::start() {
+        if (depth_ == 0) {
+            return;
+        }
+        log(INFO) << "Starting read ahead with depth: " << depth_ << std::endl;
+        stop_ = false;
+        worker_ = std::thread(&EventReadAhead::run, this);
+    }
+
+    void EventReadAhead::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        if (worker_.joinable()) {
+            worker_.join();
+            HPS_LOG(FINE) << "Stopped read ahead worker" << std::endl;
+        }
+        {
+            std::lock_guard<std::mutex> readLock(readMutex_);
+            LcioLock lcioLock;
+            for (std::vector<IO::LCReader*>::iterator it = readers_.begin(); it != readers_.end(); it++) {
+                if (*it != nullptr) {
+                    (*it)->close();
+                    delete *it;
+                    *it = nullptr;
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (std::vector<Slot>::iterator it = slots_.begin(); it != slots_.end(); it++) {
+            it->store.reset();
+            it->index = -1;
+        }
+        center_ = -1;
+    }
+
+    void EventReadAhead::setExcludedCollections(const std::set<std::string>& names,
+                                                const std::set<std::string>& types) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        excludeCollectionNames_ = names;
+        excludeCollectionTypes_ = types;
+    }
+
+    int EventReadAhead::getDepth() {
+        return depth_;
+    }
+
+    void EventReadAhead::setStepFunction(const StepFunction& step) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            step_ = step;
+        }
+        cond_.notify_all();
+    }
+
+    std::shared_ptr<const EventStore> EventReadAhead::take(int i) {
+
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        addStep(i);
+
+        // Wait for the worker if it is reading this event right now.
+        Slot* slot = findSlot(i);
+        while (slot != nullptr && slot->busy) {
+            HPS_LOG(FINE) << "Waiting for event being read ahead: " << i << std::endl;
+            cond_.wait(lock);
+            slot = findSlot(i);
+        }
+
+        std::shared_ptr<const EventStore> store;
+        if (slot != nullptr) {
+            HPS_LOG(FINE) << "Using event that was read ahead: " << i << std::endl;
+            store = slot->store;
+        } else {
+            // Events asked for are read again even if they failed before, e.g.
+            // because they were not written completely yet.
+            HPS_LOG(FINE) << "Event was not read ahead: " << i << std::endl;
+            failed_.erase(i);
+            slot = findFreeSlot(std::vector<int>());
+            slot->busy = true;
+            slot->index = i;
+            slot->store.reset();
+            lock.unlock();
+            store = read(i);
+            lock.lock();
+            slot->busy = false;
+            slot->store = store;
+            if (store == nullptr) {
+                slot->index = -1;
+                failed_.insert(i);
+            }
+        }
+        if (store != nullptr) {
+            center_ = i;
+        }
+        cond_.notify_all();
+
+        return store;
+    }
+
+    void EventReadAhead::skip(int i) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        addStep(i);
+        center_ = i;
+        cond_.notify_all();
+    }
+
+    void EventReadAhead::addStep(int i) {
+        if (center_ >= 0 && center_ != i) {
+            steps_.push_back(i > center_ ? 1 : -1);
+            if (steps_.size() > 4) {
+                steps_.pop_front();
+            }
+        }
+    }
+
+    void EventReadAhead::run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            Slot* slot = nullptr;
+            int next = -1;
+
+            // Events that failed are tried again once events were appended to the index.
+            int nEvents = index_->getNumberOfEvents();
+            if (nEvents != indexedEvents_) {
+                failed_.clear();
+                indexedEvents_ = nEvents;
+            }
+            if (center_ >= 0) {
+                std::vector<int> wanted = predict();
+                for (std::vector<int>::iterator it = wanted.begin(); it != wanted.end(); it++) {
+                    if (findSlot(*it) == nullptr && failed_.find(*it) == failed_.end()) {
+                        next = *it;
+                        break;
+                    }
+                }
+                if (next >= 0) {
+                    slot = findFreeSlot(wanted);
+                }
+            }
+            if (slot == nullptr) {
+                cond_.wait(lock);
+                continue;
+            }
+            slot->busy = true;
+            slot->index = next;
+            slot->store.reset();
+            lock.unlock();
+            std::shared_ptr<const EventStore> store = read(next);
+            lock.lock();
+            slot->busy = false;
+            slot->store = store;
+            if (store == nullptr) {
+                slot->index = -1;
+                failed_.insert(next);
+            }
+            cond_.notify_all();
+        }
+    }
+
+    std::shared_ptr<const EventStore> EventReadAhead::read(int i) {
+        const EventIndex::Entry& entry = index_->getEntry(i);
+        std::set<std::string> names;
+        std::set<std::string> types;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            names = excludeCollectionNames_;
+            types = excludeCollectionTypes_;
+        }
+
+        // The event is decoded before the reader of its file reads the next one.
+        std::lock_guard<std::mutex> readLock(readMutex_);
+        IO::LCReader*& reader = readers_.at(entry.file);
+        std::shared_ptr<EventStore> store;
+        try {
+            // A reader that was opened before does not know the events appended
+            // to a followed file since, so it is opened again if one is missing.
+            EVENT::LCEvent* event = nullptr;
+            bool opened = false;
+            while (event == nullptr) {
+                LcioLock lcioLock;
+                if (reader == nullptr) {
+                    reader = IOIMPL::LCFactory::getInstance()->createLCReader(IO::LCReader::directAccess);
+                    reader->open(index_->getFile(entry.file));
+                    opened = true;
+                }
+                StageTimer::Span span("read");
+                event = reader->readEvent(entry.run, entry.event);
+                if (event != nullptr || opened) {
+                    break;
+                }
+                HPS_LOG(FINE) << "Reopening reader of file: " << index_->getFile(entry.file) << std::endl;
+                reader->close();
+                delete reader;
+                reader = nullptr;
+            }
+            if (event != nullptr) {
+                StageTimer::Span span("decode");
+                store = std::make_shared<EventStore>();
+                store->decode(event, names, types);
+            }
+        } catch (IO::IOException& ioe) {
+            log(ERROR) << ioe.what() << std::endl;
+        } catch (std::exception& e) {
+            log(ERROR) << e.what() << std::endl;
+        }
+        if (store != nullptr) {
+            HPS_LOG(FINER) << "Read event " << i << " with run " << entry.run
+                    << " and event number " << entry.event << std::endl;
+        } else {
+            HPS_LOG(FINE) << "Failed to read event: " << i << std::endl;
+        }
+        return store;
+    }
+
+    std::vector<int> EventReadAhead::predict() {
+        std::vector<int> wanted;
+        int dir = direction();
+        int n = index_->getNumberOfEvents();
+        int i = center_;
+        for (int k = 1; k <= depth_; k++) {
+            i = step_(i, dir);
+            if (i < 0 || i >= n) {
+                break;
+            }
+            wanted.push_back(i);
+        }
+        int behind = step_(center_, -dir);
+        if (behind >= 0 && behind < n) {
+            wanted.push_back(behind);
+        }
+        return wanted;
+    }
+
+    int EventReadAhead::direction() {
+        int sum = 0;
+        for (std::deque<int>::iterator it = steps_.begin(); it != steps_.end(); it++) {
+            sum += *it;
+        }
+        return sum < 0 ? -1 : 1;
+    }
+
+    EventReadAhead::Slot* EventReadAhead::findSlot(int i) {
+        for (std::vector<Slot>::iterator it = slots_.begin(); it != slots_.end(); it++) {
+            if (it->index == i) {
+                return &(*it);
+            }
+        }
+        return nullptr;
+    }
+
+    EventReadAhead::Slot* EventReadAhead::findFreeSlot(const std::vector<int>& keep) {
+        Slot* found = nullptr;
+        for (std::vector<Slot>::iterator it = slots_.begin(); it != slots_.end(); it++) {
+            Slot* slot = &(*it);
+            if (slot->busy) {
+                continue;
+            }
+            if (slot->index == -1) {
+                return slot;
+            }
+            if (found == nullptr && std::find(keep.begin(), keep.end(), slot->index) == keep.end()) {
+                found = slot;
+            }
+        }
+        return found;
+    }
+}
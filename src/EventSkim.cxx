@@ -0,0 +1,359 @@
+#include "EventSkim.h"
+
+// HPS
+#include "LcioLock.h"
+#include "StageTimer.h"
+#include "ThreadPool.h"
+
+// LCIO
+#include "EVENT/Cluster.h"
+#include "EVENT/LCCollection.h"
+#include "EVENT/LCIO.h"
+#include "EVENT/Track.h"
+#include "IOIMPL/LCFactory.h"
+
+// C++ standard library
+#include <stdexcept>
+
+namespace hps {
+
+    // Number of consecutive events scanned by a worker at a time.
+    static const int CHUNK_SIZE = 256;
+
+    EventSkim::EventSkim(EventIndex* index, int nThreads) :
+            Logger("EventSkim"),
+            index_(index) {
+
+        if (nThreads < 1) {
+            throw std::runtime_error("Number of skim threads must be at least one.");
+        }
+        workers_.resize(nThreads);
+    }
+
+    EventSkim::~EventSkim() {
+        stop();
+    }
+
+    void EventSkim::setExcludedCollections(const std::set<std::string>& names,
+                                           const std::set<std::string>& types) {
+        excludeCollectionNames_ = names;
+        excludeCollectionTypes_ = types;
+    }
+
+    void EventSkim::start(CutTable::CutFunction selection) {
+        clear();
+        log(INFO) << "Starting skim of " << index_->getNumberOfEvents() << " events on "
+                << workers_.size() << " threads" << std::endl;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            selection_ = selection;
+        }
+        split();
+        stop_ = false;
+        running_ = workers_.size();
+        pool_ = new ThreadPool(workers_.size());
+        for (size_t w = 0; w < workers_.size(); w++) {
+            Worker& worker = workers_[w];
+            pool_->submit([this, &worker]() {
+                work(worker);
+            });
+        }
+    }
+
+    void EventSkim::clear() {
+        stop();
+        std::lock_guard<std::mutex> lock(mutex_);
+        selection_ = nullptr;
+        scanned_ = 0;
+        passed_.clear();
+    }
+
+    void EventSkim::stop() {
+        stop_ = true;
+        delete pool_;
+        pool_ = nullptr;
+        LcioLock lcioLock;
+        for (std::vector<Worker>::iterator it = workers_.begin(); it != workers_.end(); it++) {
+            if (it->reader != nullptr) {
+                it->reader->close();
+                delete it->reader;
+                it->reader = nullptr;
+                it->file = -1;
+            }
+        }
+    }
+
+    void EventSkim::split() {
+
+        // Chunks do not cross files, so that the selection is applied to the
+        // events a reader read one after the other.
+        chunks_.clear();
+        std::vector<long long> chunkBytes;
+        long long totalBytes = 0;
+        int nEvents = index_->getNumberOfEvents();
+        for (int i = 0; i < nEvents; i++) {
+            bool newFile = i == 0 || index_->getEntry(i).file != index_->getEntry(i - 1).file;
+            if (newFile || chunks_.back().last - chunks_.back().first + 1 == CHUNK_SIZE) {
+                Chunk chunk = {i, i};
+                chunks_.push_back(chunk);
+                chunkBytes.push_back(0);
+            } else {
+                chunks_.back().last = i;
+            }
+            long long bytes = getEventBytes(i);
+            chunkBytes.back() += bytes;
+            totalBytes += bytes;
+        }
+
+        // Without offsets in the index every event counts the same.
+        if (totalBytes == 0) {
+            for (size_t c = 0; c < chunks_.size(); c++) {
+                chunkBytes[c] = chunks_[c].last - chunks_[c].first + 1;
+            }
+            totalBytes = nEvents;
+        }
+
+        // Each worker gets consecutive chunks until it has its share of the bytes.
+        size_t c = 0;
+        long long bytes = 0;
+        for (size_t w = 0; w < workers_.size(); w++) {
+            Worker& worker = workers_[w];
+            worker.firstChunk = c;
+            long long share = totalBytes * (long long) (w + 1) / (long long) workers_.size();
+            while (c < chunks_.size() && (bytes < share || w + 1 == workers_.size())) {
+                bytes += chunkBytes[c++];
+            }
+            worker.endChunk = c;
+            HPS_LOG(FINE) << "Skim worker " << w << " scans chunks " << worker.firstChunk
+                    << " to " << worker.endChunk << std::endl;
+        }
+    }
+
+    long long EventSkim::getEventBytes(int i) {
+        const EventIndex::Entry& entry = index_->getEntry(i);
+        if (entry.offset < 0) {
+            return 0;
+        }
+        // The last event of a file is taken to be as large as the one before.
+        if (i + 1 < index_->getNumberOfEvents()) {
+            const EventIndex::Entry& next = index_->getEntry(i + 1);
+            if (next.file == entry.file && next.offset > entry.offset) {
+                return next.offset - entry.offset;
+            }
+        }
+        if (i > 0) {
+            const EventIndex::Entry& previous = index_->getEntry(i - 1);
+            if (previous.file == entry.file && previous.offset >= 0 && previous.offset < entry.offset) {
+                return entry.offset - previous.offset;
+            }
+        }
+        return 0;
+    }
+
+    bool EventSkim::isActive() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return selection_ != nullptr;
+    }
+
+    bool EventSkim::isFinished() {
+        return running_ == 0;
+    }
+
+    int EventSkim::getNumberOfScanned() {
+        return scanned_;
+    }
+
+    int EventSkim::getNumberOfPassed() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return passed_.size();
+    }
+
+    int EventSkim::next(int i) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::set<int>::iterator it = passed_.upper_bound(i);
+        return it != passed_.end() ? *it : -1;
+    }
+
+    int EventSkim::previous(int i) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::set<int>::iterator it = passed_.lower_bound(i);
+        return it != passed_.begin() ? *(--it) : -1;
+    }
+
+    void EventSkim::work(Worker& worker) {
+        CutTable::CutFunction selection = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            selection = selection_;
+        }
+        try {
+            for (size_t c = worker.firstChunk; c < worker.endChunk && !stop_; c++) {
+                scan(worker, chunks_[c], selection);
+            }
+        } catch (std::exception& e) {
+            log(ERROR) << "Skim failed: " << e.what() << std::endl;
+        }
+        if (--running_ == 0 && !stop_) {
+            log(INFO) << "Skim passed " << getNumberOfPassed() << " of "
+                    << scanned_ << " events" << std::endl;
+        }
+    }
+
+    void EventSkim::scan(Worker& worker, const Chunk& chunk, CutTable::CutFunction selection) {
+        int n = chunk.last - chunk.first + 1;
+        std::vector<double> columns[NVARIABLES];
+        for (int v = 0; v < NVARIABLES; v++) {
+            columns[v].resize(n);
+        }
+        std::vector<char> valid(n);
+        for (int k = 0; k < n && !stop_; k++) {
+            EVENT::LCEvent* event = read(worker, chunk.first + k);
+            const EventIndex::Entry& entry = index_->getEntry(chunk.first + k);
+            if (event != nullptr && event->getRunNumber() == entry.run && event->getEventNumber() == entry.event) {
+                double values[NVARIABLES] = {};
+                fill(event, values);
+                for (int v = 0; v < NVARIABLES; v++) {
+                    columns[v][k] = values[v];
+                }
+                valid[k] = 1;
+            } else {
+                log(WARNING) << "Failed to read event for skim: " << (chunk.first + k) << std::endl;
+            }
+            scanned_++;
+        }
+        if (stop_) {
+            return;
+        }
+
+        // The selection is applied to the whole chunk at once.
+        const double* values[NVARIABLES];
+        for (int v = 0; v < NVARIABLES; v++) {
+            values[v] = &columns[v][0];
+        }
+        std::vector<char> pass(n);
+        selection(n, values, &pass[0]);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int k = 0; k < n; k++) {
+            if (valid[k] && pass[k]) {
+                passed_.insert(chunk.first + k);
+            }
+        }
+    }
+
+    EVENT::LCEvent* EventSkim::read(Worker& worker, int i) {
+        const EventIndex::Entry& entry = index_->getEntry(i);
+        EVENT::LCEvent* event = nullptr;
+        try {
+            // Only the calls into the reader are serialized, if needed.
+            if (worker.reader != nullptr && worker.file != entry.file) {
+                LcioLock lcioLock;
+                worker.reader->close();
+                delete worker.reader;
+                worker.reader = nullptr;
+            }
+            if (worker.reader == nullptr) {
+                LcioLock lcioLock;
+                worker.reader = IOIMPL::LCFactory::getInstance()->createLCReader(IO::LCReader::directAccess);
+                worker.reader->open(index_->getFile(entry.file));
+                worker.file = entry.file;
+                worker.next = -1;
+            }
+            StageTimer::Span span("skim read");
+            if (worker.next == i) {
+                LcioLock lcioLock;
+                event = worker.reader->readNextEvent();
+            }
+
+            // The reader goes to the first event of the range by its number,
+            // instead of skipping the events before it.
+            if (event == nullptr || event->getRunNumber() != entry.run || event->getEventNumber() != entry.event) {
+                LcioLock lcioLock;
+                event = worker.reader->readEvent(entry.run, entry.event);
+            }
+            worker.next = i + 1;
+        } catch (IO::IOException& ioe) {
+            log(ERROR) << ioe.what() << std::endl;
+        } catch (std::exception& e) {
+            log(ERROR) << e.what() << std::endl;
+        }
+        return event;
+    }
+
+    void EventSkim::fill(EVENT::LCEvent* event, double* values) {
+        const std::vector<std::string>* collectionNames = event->getCollectionNames();
+        for (std::vector<std::string>::const_iterator it = collectionNames->begin();
+                it != collectionNames->end(); it++) {
+            if (excludeCollectionNames_.count(*it) > 0) {
+                continue;
+            }
+            EVENT::LCCollection* collection = event->getCollection(*it);
+            const std::string& typeName = collection->getTypeName();
+            if (excludeCollectionTypes_.count(typeName) > 0) {
+                continue;
+            }
+            int n = collection->getNumberOfElements();
+            if (typeName == EVENT::LCIO::TRACK) {
+                values[NTRACKS] += n;
+                for (int i = 0; i < n; i++) {
+                    // Same charge convention as the drawn tracks.
+                    EVENT::Track* track = static_cast<EVENT::Track*>(collection->getElementAt(i));
+                    values[track->getOmega() > 0. ? NNEG : NPOS] += 1;
+                }
+            } else if (typeName == EVENT::LCIO::CLUSTER) {
+                values[NCLUSTERS] += n;
+                for (int i = 0; i < n; i++) {
+                    double energy = static_cast<EVENT::Cluster*>(collection->getElementAt(i))->getEnergy();
+                    values[ESUM] += energy;
+                    if (energy > values[E1]) {
+                        values[E2] = values[E1];
+                        values[E1] = energy;
+                    } else if (energy > values[E2]) {
+                        values[E2] = energy;
+                    }
+                }
+            } else if (typeName == EVENT::LCIO::VERTEX) {
+                values[NVERTICES] += n;
+            } else if (typeName == EVENT::LCIO::RECONSTRUCTEDPARTICLE) {
+                values[NPARTICLES] += n;
+            } else if (typeName == EVENT::LCIO::MCPARTICLE) {
+                values[NMCPARTICLES] += n;
+            }
+        }
+    }
+
+    const char* EventSkim::getVariableName(Variable variable) {
+        switch (variable) {
+            case NTRACKS:
+                return "ntracks";
+            case NPOS:
+                return "npos";
+            case NNEG:
+                return "nneg";
+            case NVERTICES:
+                return "nvertices";
+            case NCLUSTERS:
+                return "nclusters";
+            case E1:
+                return "e1";
+            case E2:
+                return "e2";
+            case ESUM:
+                return "esum";
+            case NPARTICLES:
+                return "nparticles";
+            case NMCPARTICLES:
+                return "nmcparticles";
+            default:
+                return "";
+        }
+    }
+
+    std::vector<std::string> EventSkim::getVariableNames() {
+        std::vector<std::string> names;
+        for (int v = 0; v < NVARIABLES; v++) {
+            names.push_back(getVariableName((Variable) v));
+        }
+        return names;
+    }
+}
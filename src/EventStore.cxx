@@ -0,0 +1,323 @@
+#include "EventStore.h"
+
+// HPS
+#include "DetectorGeometry.h"
+
+// LCIO
+#include "EVENT/LCIO.h"
+#include "EVENT/LCCollection.h"
+#include "EVENT/SimTrackerHit.h"
+#include "EVENT/SimCalorimeterHit.h"
+#include "EVENT/CalorimeterHit.h"
+#include "EVENT/MCParticle.h"
+#include "EVENT/Cluster.h"
+#include "EVENT/Track.h"
+#include "EVENT/ReconstructedParticle.h"
+#include "EVENT/Vertex.h"
+
+// C++ standard library
+#include <algorithm>
+#include <limits>
+
+using EVENT::LCIO;
+
+namespace hps {
+
+    // Positions of LCIO objects are in mm.
+    static const float MM = 0.1f;
+
+    template <typename T>
+    static size_t bytes(const std::vector<T>& v) {
+        return v.capacity() * sizeof(T);
+    }
+
+    void EventStore::decode(EVENT::LCEvent* event,
+                            const std::set<std::string>& excludeNames,
+                            const std::set<std::string>& excludeTypes) {
+        std::vector<EVENT::LCCollection*> lcCollections;
+        const std::vector<std::string>* names = event->getCollectionNames();
+        for (std::vector<std::string>::const_iterator it = names->begin(); it != names->end(); it++) {
+            EVENT::LCCollection* collection = event->getCollection(*it);
+            const std::string& typeName = collection->getTypeName();
+            if (excludeNames.count(*it) > 0 || excludeTypes.count(typeName) > 0) {
+                continue;
+            }
+            if (typeName != LCIO::SIMTRACKERHIT && typeName != LCIO::SIMCALORIMETERHIT &&
+                    typeName != LCIO::MCPARTICLE && typeName != LCIO::CLUSTER &&
+                    typeName != LCIO::TRACK && typeName != LCIO::VERTEX &&
+                    typeName != LCIO::RECONSTRUCTEDPARTICLE) {
+                continue;
+            }
+            Collection decoded;
+            decoded.name = *it;
+            decoded.typeName = typeName;
+            collections_.push_back(decoded);
+            lcCollections.push_back(collection);
+        }
+
+        // Particles come last, so that the objects they refer to are already
+        // in the arrays if their collections are decoded.
+        for (size_t i = 0; i < collections_.size(); i++) {
+            if (collections_[i].typeName != LCIO::RECONSTRUCTEDPARTICLE) {
+                decodeCollection(lcCollections[i], collections_[i]);
+            }
+        }
+        for (size_t i = 0; i < collections_.size(); i++) {
+            if (collections_[i].typeName == LCIO::RECONSTRUCTEDPARTICLE) {
+                decodeCollection(lcCollections[i], collections_[i]);
+            }
+        }
+
+        clusterIndices_.clear();
+        trackIndices_.clear();
+        vertexIndices_.clear();
+    }
+
+    const std::vector<EventStore::Collection>& EventStore::getCollections() const {
+        return collections_;
+    }
+
+    size_t EventStore::getSize() const {
+        size_t size = sizeof(EventStore);
+        size += simTrackerHits.position.bytes() + bytes(simTrackerHits.time) + bytes(simTrackerHits.edep);
+        const CalorimeterHits* calHits[] = {&simCalorimeterHits, &clusterHits};
+        for (int i = 0; i < 2; i++) {
+            size += calHits[i]->position.bytes() + bytes(calHits[i]->energy) + bytes(calHits[i]->time) +
+                    bytes(calHits[i]->cellID) + bytes(calHits[i]->contributions);
+        }
+        size += mcParticles.vertex.bytes() + mcParticles.endpoint.bytes() + mcParticles.momentum.bytes() +
+                bytes(mcParticles.charge) + bytes(mcParticles.energy) + bytes(mcParticles.time) +
+                bytes(mcParticles.pdg) + bytes(mcParticles.parent);
+        size += clusters.position.bytes() + bytes(clusters.energy) + bytes(clusters.firstHit) +
+                bytes(clusters.nHits);
+        size += bytes(trackStates.d0) + bytes(trackStates.phi) + bytes(trackStates.omega) +
+                bytes(trackStates.z0) + bytes(trackStates.tanLambda) + trackStates.referencePoint.bytes();
+        size += tracks.referencePoint.bytes() + bytes(tracks.chi2) + bytes(tracks.nHits) +
+                bytes(tracks.firstState) + bytes(tracks.nStates) + bytes(tracks.ipState);
+        size += vertices.position.bytes() + bytes(vertices.chi2) + bytes(vertices.probability);
+        size += particles.start.bytes() + particles.momentum.bytes() + bytes(particles.charge) +
+                bytes(particles.energy) + bytes(particles.pdg) + bytes(particles.startVertex) +
+                bytes(particles.endVertex) + bytes(particles.firstTrack) + bytes(particles.nTracks) +
+                bytes(particles.firstCluster) + bytes(particles.nClusters);
+        size += bytes(particleTracks) + bytes(particleClusters);
+        for (size_t i = 0; i < collections_.size(); i++) {
+            size += sizeof(Collection) + collections_[i].name.capacity() + collections_[i].typeName.capacity();
+        }
+        return size;
+    }
+
+    void EventStore::decodeCollection(EVENT::LCCollection* collection, Collection& decoded) {
+        const std::string& typeName = decoded.typeName;
+        int n = collection->getNumberOfElements();
+        if (typeName == LCIO::SIMTRACKERHIT) {
+            decodeSimTrackerHits(collection, decoded);
+        } else if (typeName == LCIO::SIMCALORIMETERHIT) {
+            decodeSimCalorimeterHits(collection, decoded);
+        } else if (typeName == LCIO::MCPARTICLE) {
+            decodeMCParticles(collection, decoded);
+        } else if (typeName == LCIO::CLUSTER) {
+            decoded.begin = clusters.energy.size();
+            for (int i = 0; i < n; i++) {
+                addCluster(static_cast<EVENT::Cluster*>(collection->getElementAt(i)));
+            }
+            decoded.end = clusters.energy.size();
+        } else if (typeName == LCIO::TRACK) {
+            decoded.begin = tracks.chi2.size();
+            for (int i = 0; i < n; i++) {
+                addTrack(static_cast<EVENT::Track*>(collection->getElementAt(i)));
+            }
+            decoded.end = tracks.chi2.size();
+        } else if (typeName == LCIO::VERTEX) {
+            decoded.begin = vertices.chi2.size();
+            for (int i = 0; i < n; i++) {
+                addVertex(static_cast<EVENT::Vertex*>(collection->getElementAt(i)));
+            }
+            decoded.end = vertices.chi2.size();
+        } else if (typeName == LCIO::RECONSTRUCTEDPARTICLE) {
+            decodeReconstructedParticles(collection, decoded);
+        }
+    }
+
+    void EventStore::decodeSimTrackerHits(EVENT::LCCollection* collection, Collection& decoded) {
+        int n = collection->getNumberOfElements();
+        decoded.begin = simTrackerHits.time.size();
+        for (int i = 0; i < n; i++) {
+            EVENT::SimTrackerHit* hit = static_cast<EVENT::SimTrackerHit*>(collection->getElementAt(i));
+            simTrackerHits.position.add(hit->getPosition(), MM);
+            simTrackerHits.time.push_back(hit->getTime());
+            simTrackerHits.edep.push_back(hit->getEDep());
+        }
+        decoded.end = simTrackerHits.time.size();
+    }
+
+    void EventStore::decodeSimCalorimeterHits(EVENT::LCCollection* collection, Collection& decoded) {
+        int n = collection->getNumberOfElements();
+        CalorimeterHits& hits = simCalorimeterHits;
+        decoded.begin = hits.energy.size();
+        float min = std::numeric_limits<float>::infinity();
+        float max = -std::numeric_limits<float>::infinity();
+        for (int i = 0; i < n; i++) {
+            EVENT::SimCalorimeterHit* hit = static_cast<EVENT::SimCalorimeterHit*>(collection->getElementAt(i));
+            float energy = hit->getEnergy();
+            int contributions = hit->getNMCContributions();
+            hits.position.add(hit->getPosition(), MM);
+            hits.energy.push_back(energy);
+            hits.time.push_back(contributions > 0 ? hit->getTimeCont(0) : 0.f);
+            hits.cellID.push_back(DetectorGeometry::cellID(hit->getCellID0(), hit->getCellID1()));
+            hits.contributions.push_back(contributions);
+            min = std::min(min, energy);
+            max = std::max(max, energy);
+        }
+        decoded.end = hits.energy.size();
+        if (n > 0) {
+            decoded.minEnergy = min;
+            decoded.maxEnergy = max;
+        }
+    }
+
+    void EventStore::decodeMCParticles(EVENT::LCCollection* collection, Collection& decoded) {
+        int n = collection->getNumberOfElements();
+        decoded.begin = mcParticles.pdg.size();
+
+        // Parents are resolved once all particles of the collection have an index.
+        IndexMap indices;
+        std::vector<const EVENT::MCParticle*> parents(n, nullptr);
+        for (int i = 0; i < n; i++) {
+            EVENT::MCParticle* mcp = static_cast<EVENT::MCParticle*>(collection->getElementAt(i));
+            indices[mcp] = decoded.begin + i;
+            const EVENT::MCParticleVec& mcpParents = mcp->getParents();
+            if (!mcpParents.empty()) {
+                parents[i] = mcpParents[0];
+            }
+            mcParticles.vertex.add(mcp->getVertex(), MM);
+            const double* endpoint = mcp->getEndpoint();
+            mcParticles.endpoint.add(endpoint != nullptr ? endpoint : mcp->getVertex(), MM);
+            mcParticles.momentum.add(mcp->getMomentum());
+            mcParticles.charge.push_back(mcp->getCharge());
+            mcParticles.energy.push_back(mcp->getEnergy());
+            mcParticles.time.push_back(mcp->getTime());
+            mcParticles.pdg.push_back(mcp->getPDG());
+        }
+        for (int i = 0; i < n; i++) {
+            IndexMap::const_iterator it = parents[i] != nullptr ? indices.find(parents[i]) : indices.end();
+            mcParticles.parent.push_back(it != indices.end() ? it->second : -1);
+        }
+        decoded.end = mcParticles.pdg.size();
+    }
+
+    void EventStore::decodeReconstructedParticles(EVENT::LCCollection* collection, Collection& decoded) {
+        int n = collection->getNumberOfElements();
+        decoded.begin = particles.pdg.size();
+        for (int i = 0; i < n; i++) {
+            EVENT::ReconstructedParticle* particle =
+                    static_cast<EVENT::ReconstructedParticle*>(collection->getElementAt(i));
+            EVENT::Vertex* startVertex = particle->getStartVertex();
+            EVENT::Vertex* endVertex = particle->getEndVertex();
+            if (startVertex != nullptr) {
+                particles.start.add(startVertex->getPosition(), MM);
+            } else {
+                particles.start.add(particle->getReferencePoint(), MM);
+            }
+            particles.momentum.add(particle->getMomentum());
+            particles.charge.push_back(particle->getCharge());
+            particles.energy.push_back(particle->getEnergy());
+            particles.pdg.push_back(particle->getParticleIDUsed() != nullptr ?
+                    particle->getParticleIDUsed()->getPDG() : 0);
+            particles.startVertex.push_back(startVertex != nullptr ? addVertex(startVertex, true) : -1);
+            particles.endVertex.push_back(endVertex != nullptr ? addVertex(endVertex, true) : -1);
+
+            const EVENT::TrackVec& particleTrackVec = particle->getTracks();
+            particles.firstTrack.push_back(particleTracks.size());
+            particles.nTracks.push_back(particleTrackVec.size());
+            for (size_t j = 0; j < particleTrackVec.size(); j++) {
+                particleTracks.push_back(addTrack(particleTrackVec[j], true));
+            }
+
+            const EVENT::ClusterVec& particleClusterVec = particle->getClusters();
+            particles.firstCluster.push_back(particleClusters.size());
+            particles.nClusters.push_back(particleClusterVec.size());
+            for (size_t j = 0; j < particleClusterVec.size(); j++) {
+                particleClusters.push_back(addCluster(particleClusterVec[j], true));
+            }
+        }
+        decoded.end = particles.pdg.size();
+    }
+
+    int EventStore::addCluster(EVENT::Cluster* cluster, bool reuse) {
+        if (reuse) {
+            IndexMap::const_iterator it = clusterIndices_.find(cluster);
+            if (it != clusterIndices_.end()) {
+                return it->second;
+            }
+        }
+        int index = clusters.energy.size();
+        clusterIndices_.insert(std::make_pair(cluster, index));
+        const EVENT::CalorimeterHitVec& hits = cluster->getCalorimeterHits();
+        clusters.position.add(cluster->getPosition(), MM);
+        clusters.energy.push_back(cluster->getEnergy());
+        clusters.firstHit.push_back(clusterHits.energy.size());
+        clusters.nHits.push_back(hits.size());
+        for (size_t i = 0; i < hits.size(); i++) {
+            addCalorimeterHit(clusterHits, hits[i]);
+        }
+        return index;
+    }
+
+    int EventStore::addTrack(EVENT::Track* track, bool reuse) {
+        if (reuse) {
+            IndexMap::const_iterator it = trackIndices_.find(track);
+            if (it != trackIndices_.end()) {
+                return it->second;
+            }
+        }
+        int index = tracks.chi2.size();
+        trackIndices_.insert(std::make_pair(track, index));
+        const EVENT::TrackStateVec& states = track->getTrackStates();
+        int firstState = trackStates.d0.size();
+        int ipState = -1;
+        for (size_t i = 0; i < states.size(); i++) {
+            const EVENT::TrackState* ts = states[i];
+            if (ts->getLocation() == EVENT::TrackState::AtIP && ipState < 0) {
+                ipState = firstState + i;
+            }
+            trackStates.d0.push_back(ts->getD0());
+            trackStates.phi.push_back(ts->getPhi());
+            trackStates.omega.push_back(ts->getOmega());
+            trackStates.z0.push_back(ts->getZ0());
+            trackStates.tanLambda.push_back(ts->getTanLambda());
+            trackStates.referencePoint.add(ts->getReferencePoint());
+        }
+        if (ipState < 0 && !states.empty()) {
+            ipState = firstState;
+        }
+        tracks.referencePoint.add(track->getReferencePoint(), MM);
+        tracks.chi2.push_back(track->getChi2());
+        tracks.nHits.push_back(track->getTrackerHits().size());
+        tracks.firstState.push_back(firstState);
+        tracks.nStates.push_back(states.size());
+        tracks.ipState.push_back(ipState);
+        return index;
+    }
+
+    int EventStore::addVertex(EVENT::Vertex* vertex, bool reuse) {
+        if (reuse) {
+            IndexMap::const_iterator it = vertexIndices_.find(vertex);
+            if (it != vertexIndices_.end()) {
+                return it->second;
+            }
+        }
+        int index = vertices.chi2.size();
+        vertexIndices_.insert(std::make_pair(vertex, index));
+        vertices.position.add(vertex->getPosition(), MM);
+        vertices.chi2.push_back(vertex->getChi2());
+        vertices.probability.push_back(vertex->getProbability());
+        return index;
+    }
+
+    void EventStore::addCalorimeterHit(CalorimeterHits& hits, EVENT::CalorimeterHit* hit) {
+        hits.position.add(hit->getPosition(), MM);
+        hits.energy.push_back(hit->getEnergy());
+        hits.time.push_back(hit->getTime());
+        hits.cellID.push_back(DetectorGeometry::cellID(hit->getCellID0(), hit->getCellID1()));
+    }
+}
@@ -1,59 +1,156 @@
 #include "FileCache.h"
 
+#include <sys/file.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <stdexcept>
 
 #ifdef HAVE_CURL
 
 #include <curl/curl.h>
 
-size_t _write_data(void *ptr, size_t size, size_t nmemb, void *stream) {
-  size_t written = fwrite(ptr, size, nmemb, (FILE *)stream);
-  return written;
-}
+namespace {
 
-void _download(const char* url, const char* outfile)
-{
-    CURL *curl;
-    CURLcode res;
-    FILE *pagefile;
+    /*
+     * State of one transfer, which is passed to the curl callbacks.
+     */
+    struct Transfer {
+        FILE* file{nullptr};
+        std::string etag;
+        std::string lastModified;
+        const std::atomic<bool>* abort{nullptr};
+    };
 
-    curl_global_init(CURL_GLOBAL_DEFAULT);
+    size_t _write_data(void *ptr, size_t size, size_t nmemb, void *userdata) {
+        return fwrite(ptr, size, nmemb, ((Transfer*) userdata)->file);
+    }
 
-    curl = curl_easy_init();
+    size_t _write_header(char *buffer, size_t size, size_t nitems, void *userdata) {
+        Transfer* transfer = (Transfer*) userdata;
+        std::string line(buffer, size * nitems);
+        if (line.compare(0, 5, "HTTP/") == 0) {
+            // Only the validators of the last response, e.g. after a redirect, are kept.
+            transfer->etag.clear();
+            transfer->lastModified.clear();
+        }
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            std::string name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            size_t first = line.find_first_not_of(" \t", colon + 1);
+            size_t last = line.find_last_not_of(" \t\r\n");
+            std::string value = first != std::string::npos && last >= first ?
+                    line.substr(first, last - first + 1) : "";
+            if (name == "etag") {
+                transfer->etag = value;
+            } else if (name == "last-modified") {
+                transfer->lastModified = value;
+            }
+        }
+        return size * nitems;
+    }
 
-    curl_easy_setopt(curl, CURLOPT_URL, url);
+    int _check_abort(void *userdata, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+        return ((Transfer*) userdata)->abort->load() ? 1 : 0;
+    }
 
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    void _init_curl() {
+        static std::once_flag once;
+        std::call_once(once, []() {
+            curl_global_init(CURL_GLOBAL_DEFAULT);
+        });
+    }
+}
 
-    /* send all data to this function  */
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _write_data);
+#endif
 
-    /* open the file */
-    pagefile = fopen(outfile, "wb");
-    if(pagefile) {
+namespace hps {
 
-        /* write the page body to this file handle */
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, pagefile);
+    // Suffixes of the partial file, of a changed file that replaces the cached
+    // one at the next launch, of the metadata of a fetched file and of its lock
+    static const std::string PART_SUFFIX = ".part";
+    static const std::string NEXT_SUFFIX = ".next";
+    static const std::string META_SUFFIX = ".meta";
+    static const std::string LOCK_SUFFIX = ".lock";
 
-        /* get it! */
-        curl_easy_perform(curl);
+    static bool getFileSize(const std::string& path, long long& size) {
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0) {
+            return false;
+        }
+        size = st.st_size;
+        return true;
+    }
 
-        /* close the header file */
-        fclose(pagefile);
-     }
+    /*
+     * Get the local path of a file:// URL or of a path, or an empty string for
+     * other URLs.
+     */
+    static std::string getLocalPath(const std::string& url) {
+        if (url.compare(0, 7, "file://") == 0) {
+            return url.substr(7);
+        }
+        return url.find("://") == std::string::npos ? url : "";
+    }
 
-    /* cleanup curl stuff */
-    curl_easy_cleanup(curl);
+    /*
+     * Exclusive lock on a file next to a cached file, so that only one process
+     * fetches it into the same cache at a time. The lock file is removed when
+     * the lock is released, so a process that locked a file which was removed
+     * meanwhile opens and locks the new one.
+     */
+    class FetchLock {
 
-    curl_global_cleanup();
-}
+        public:
 
-#endif
+            FetchLock(const std::string& path, bool wait = true) : path_(path) {
+                while (true) {
+                    fd_ = ::open(path.c_str(), O_CREAT | O_RDWR, 0644);
+                    if (fd_ < 0) {
+                        return;
+                    }
+                    if (flock(fd_, wait ? LOCK_EX : LOCK_EX | LOCK_NB) != 0) {
+                        ::close(fd_);
+                        fd_ = -1;
+                        return;
+                    }
+                    struct stat locked;
+                    struct stat current;
+                    if (::fstat(fd_, &locked) == 0 && ::stat(path.c_str(), &current) == 0
+                            && locked.st_dev == current.st_dev && locked.st_ino == current.st_ino) {
+                        return;
+                    }
+                    ::close(fd_);
+                }
+            }
 
-namespace hps {
+            ~FetchLock() {
+                if (fd_ >= 0) {
+                    std::remove(path_.c_str());
+                    flock(fd_, LOCK_UN);
+                    ::close(fd_);
+                }
+            }
+
+            bool isLocked() {
+                return fd_ >= 0;
+            }
+
+        private:
+
+            std::string path_;
+            int fd_{-1};
+    };
 
     FileCache::FileCache(std::string cacheDir) :
             Logger("FileCache"),
@@ -61,12 +158,23 @@ namespace hps {
     }
 
     FileCache::~FileCache() {
+        abort_ = true;
+        for (std::vector<std::thread>::iterator it = threads_.begin(); it != threads_.end(); it++) {
+            it->join();
+        }
     }
 
     bool FileCache::isCached(const std::string& fileName) {
-        std::ifstream cacheFile;
-        cacheFile.open(getCachedPath(fileName));
-        return cacheFile.good();
+        std::string path = getCachedPath(fileName);
+        long long size = 0;
+        if (!getFileSize(path, size)) {
+            return false;
+        }
+        Metadata metadata;
+        if (readMetadata(path + META_SUFFIX, metadata) && metadata.size != size) {
+            return false;
+        }
+        return true;
     }
 
     std::string FileCache::getCachedPath(const std::string& fileName) {
@@ -86,13 +194,294 @@ namespace hps {
     }
 
     void FileCache::cache(const char* url, const char* outfile) {
-        log(INFO) << "Downloading: " << url << " -> " << outfile << std::endl;
+        fetch(url, outfile).get();
+    }
+
+    std::shared_future<void> FileCache::fetch(const std::string& url, const std::string& fileName) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::map<std::string, std::shared_future<void>>::iterator fnd = fetches_.find(fileName);
+        if (fnd != fetches_.end()) {
+            return fnd->second;
+        }
+
+        std::shared_ptr<std::promise<void>> promise(new std::promise<void>());
+        std::shared_future<void> future = promise->get_future().share();
+        fetches_[fileName] = future;
+
+        // A cached file is used right away, and a changed file is only used from the next launch.
+        promote(fileName);
+        bool cached = isCached(fileName);
+        if (cached) {
+            promise->set_value();
+        }
+        threads_.push_back(std::thread([this, url, fileName, promise, cached]() {
+            try {
+                download(url, fileName, cached);
+                if (!cached) {
+                    promise->set_value();
+                }
+            } catch (std::exception& e) {
+                if (cached) {
+                    log(WARNING) << "Failed to revalidate " << fileName << ": " << e.what() << std::endl;
+                } else {
+                    log(ERROR) << "Failed to fetch " << fileName << ": " << e.what() << std::endl;
+                    promise->set_exception(std::current_exception());
+                }
+            }
+        }));
+        return future;
+    }
+
+    void FileCache::promote(const std::string& fileName) {
+        std::string path = getCachedPath(fileName);
+        std::string nextPath = path + NEXT_SUFFIX;
+        long long size = 0;
+        if (!getFileSize(nextPath, size)) {
+            return;
+        }
+
+        // The file is promoted at a later launch if another process is fetching it.
+        FetchLock lock(path + LOCK_SUFFIX, false);
+        if (!lock.isLocked()) {
+            return;
+        }
+        if (std::rename(nextPath.c_str(), path.c_str()) != 0
+                || std::rename((nextPath + META_SUFFIX).c_str(), (path + META_SUFFIX).c_str()) != 0) {
+            log(WARNING) << "Failed to replace cached file: " << path << std::endl;
+            return;
+        }
+        log(INFO) << "Replaced cached file with the version fetched before: " << path << std::endl;
+    }
+
+    void FileCache::download(const std::string& url, const std::string& fileName, bool inUse) {
+
+        std::string path = getCachedPath(fileName);
+        std::string partPath = path + PART_SUFFIX;
+
+        // Wait for another process fetching the same file, which may have cached it meanwhile.
+        FetchLock lock(path + LOCK_SUFFIX);
+
+        // The validators of a cached file are only used if its contents are unchanged.
+        Metadata cached;
+        bool isValid = isCached(fileName)
+                && readMetadata(path + META_SUFFIX, cached)
+                && cached.hash == hashFile(path);
+
+        std::string localPath = getLocalPath(url);
+        if (!localPath.empty()) {
+            struct stat st;
+            if (::stat(localPath.c_str(), &st) != 0) {
+                throw std::runtime_error("Missing file in mirror: " + localPath);
+            }
+            Metadata metadata;
+            metadata.lastModified = std::to_string((long long) st.st_mtime);
+            if (isValid && cached.size == (long long) st.st_size && cached.lastModified == metadata.lastModified) {
+                HPS_LOG(FINE) << "Cached file is up to date: " << path << std::endl;
+                return;
+            }
+            log(INFO) << "Copying: " << localPath << " -> " << path << std::endl;
+            {
+                std::ifstream in(localPath, std::ios::binary);
+                std::ofstream out(partPath, std::ios::binary | std::ios::trunc);
+                out << in.rdbuf();
+                if (!in.good() || !out.good()) {
+                    std::remove(partPath.c_str());
+                    throw std::runtime_error("Failed to copy file from mirror: " + localPath);
+                }
+            }
+            commit(fileName, metadata, inUse);
+            return;
+        }
+
 #ifdef HAVE_CURL
-        _download(url, getCachedPath(outfile).c_str());
+        _init_curl();
+
+        // Resume a partial file of an earlier fetch, unless a complete file is only revalidated.
+        // A partial file is only resumed if its ETag is known, so that it is not completed from another version.
+        Metadata partial;
+        long long resumeFrom = 0;
+        if (isValid || !getFileSize(partPath, resumeFrom)
+                || !readMetadata(partPath + META_SUFFIX, partial) || partial.etag.empty()) {
+            resumeFrom = 0;
+        }
+
+        for (int attempt = 0; attempt < 2; attempt++) {
+
+            if (isValid) {
+                HPS_LOG(FINE) << "Revalidating: " << url << " -> " << path << std::endl;
+            } else if (resumeFrom > 0) {
+                log(INFO) << "Resuming download at " << resumeFrom << " bytes: " << url << " -> " << path << std::endl;
+            } else {
+                log(INFO) << "Downloading: " << url << " -> " << path << std::endl;
+            }
+
+            Transfer transfer;
+            transfer.abort = &abort_;
+            transfer.file = fopen(partPath.c_str(), resumeFrom > 0 ? "ab" : "wb");
+            if (transfer.file == nullptr) {
+                throw std::runtime_error("Failed to create file: " + partPath);
+            }
+
+            CURL *curl = curl_easy_init();
+            curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+            curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _write_data);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
+            curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, _write_header);
+            curl_easy_setopt(curl, CURLOPT_HEADERDATA, &transfer);
+            curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+            curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, _check_abort);
+            curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &transfer);
+            curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 30L);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 60L);
+
+            struct curl_slist* headers = nullptr;
+            if (isValid) {
+                if (!cached.etag.empty()) {
+                    headers = curl_slist_append(headers, ("If-None-Match: " + cached.etag).c_str());
+                }
+                if (!cached.lastModified.empty()) {
+                    headers = curl_slist_append(headers, ("If-Modified-Since: " + cached.lastModified).c_str());
+                }
+            } else if (resumeFrom > 0) {
+                curl_easy_setopt(curl, CURLOPT_RESUME_FROM_LARGE, (curl_off_t) resumeFrom);
+                if (!partial.etag.empty()) {
+                    headers = curl_slist_append(headers, ("If-Range: " + partial.etag).c_str());
+                }
+            }
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+
+            CURLcode res = curl_easy_perform(curl);
+            long status = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+            curl_off_t length = -1;
+            curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+
+            curl_slist_free_all(headers);
+            curl_easy_cleanup(curl);
+            fclose(transfer.file);
+
+            // The partial file changed on the server or cannot be resumed, so start over.
+            if (resumeFrom > 0 && (res == CURLE_RANGE_ERROR || status == 416 || status == 200)) {
+                log(INFO) << "Cannot resume download, starting over: " << url << std::endl;
+                std::remove((partPath + META_SUFFIX).c_str());
+                resumeFrom = 0;
+                continue;
+            }
+
+            if (res != CURLE_OK) {
+                // Keep the validators of the partial file, so that a later fetch only resumes the same file.
+                if (!transfer.etag.empty() && resumeFrom == 0) {
+                    Metadata metadata;
+                    metadata.etag = transfer.etag;
+                    writeMetadata(partPath + META_SUFFIX, metadata);
+                }
+                throw std::runtime_error(std::string("Download failed: ") + curl_easy_strerror(res));
+            }
+
+            if (status == 304) {
+                HPS_LOG(FINE) << "Cached file is up to date: " << path << std::endl;
+                std::remove(partPath.c_str());
+                return;
+            }
+
+            long long size = 0;
+            getFileSize(partPath, size);
+            if (length >= 0 && size != resumeFrom + (long long) length) {
+                throw std::runtime_error("Incomplete download of " + std::to_string(size) + " bytes");
+            }
+
+            Metadata metadata;
+            metadata.etag = transfer.etag.empty() ? partial.etag : transfer.etag;
+            metadata.lastModified = transfer.lastModified;
+            commit(fileName, metadata, inUse);
+            return;
+        }
+        throw std::runtime_error("Download could not be resumed: " + url);
 #else
-        // Should never get here but raise an error anyways.
         throw std::runtime_error("curl is not enabled!");
 #endif
     }
 
+    void FileCache::commit(const std::string& fileName, Metadata& metadata, bool next) {
+        std::string cachedPath = getCachedPath(fileName);
+        std::string partPath = cachedPath + PART_SUFFIX;
+        std::string path = next ? cachedPath + NEXT_SUFFIX : cachedPath;
+        getFileSize(partPath, metadata.size);
+        metadata.hash = hashFile(partPath);
+        if (std::rename(partPath.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("Failed to move file into cache: " + path);
+        }
+        writeMetadata(path + META_SUFFIX, metadata);
+        std::remove((partPath + META_SUFFIX).c_str());
+        if (next) {
+            log(INFO) << "Cached " << metadata.size << " bytes, which replace " << cachedPath
+                    << " at the next launch" << std::endl;
+        } else {
+            log(INFO) << "Cached " << metadata.size << " bytes: " << path << std::endl;
+        }
+    }
+
+    bool FileCache::readMetadata(const std::string& path, Metadata& metadata) {
+        std::ifstream in(path);
+        if (!in.good()) {
+            return false;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t eq = line.find('=');
+            if (eq == std::string::npos) {
+                continue;
+            }
+            std::string key = line.substr(0, eq);
+            std::string value = line.substr(eq + 1);
+            if (key == "size") {
+                metadata.size = std::atoll(value.c_str());
+            } else if (key == "hash") {
+                metadata.hash = value;
+            } else if (key == "etag") {
+                metadata.etag = value;
+            } else if (key == "last-modified") {
+                metadata.lastModified = value;
+            }
+        }
+        return true;
+    }
+
+    void FileCache::writeMetadata(const std::string& path, const Metadata& metadata) {
+        std::string tmpPath = path + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::trunc);
+            out << "size=" << metadata.size << std::endl;
+            out << "hash=" << metadata.hash << std::endl;
+            out << "etag=" << metadata.etag << std::endl;
+            out << "last-modified=" << metadata.lastModified << std::endl;
+        }
+        std::rename(tmpPath.c_str(), path.c_str());
+    }
+
+    std::string FileCache::hashFile(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.good()) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+        // 64-bit FNV-1a
+        unsigned long long hash = 14695981039346656037ULL;
+        std::vector<char> buffer(1 << 20);
+        while (in) {
+            in.read(&buffer[0], buffer.size());
+            std::streamsize n = in.gcount();
+            for (std::streamsize i = 0; i < n; i++) {
+                hash ^= (unsigned char) buffer[i];
+                hash *= 1099511628211ULL;
+            }
+        }
+        std::stringstream ss;
+        ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+        return ss.str();
+    }
 }
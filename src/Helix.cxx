@@ -0,0 +1,111 @@
+#include "Helix.h"
+
+// ROOT
+#include "TMath.h"
+#include "TVector2.h"
+
+// C++ standard library
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace hps {
+
+    Helix::Helix(const EventStore::TrackStates& states, int i) {
+        // LCIO parameters are in mm with the reference point in the tracking frame.
+        const EventStore::Vectors& ref = states.referencePoint;
+        double d0 = states.d0[i];
+        phi0_ = states.phi[i];
+        u0_ = (ref.x[i] - d0 * std::sin(phi0_)) / 10.;
+        v0_ = (ref.y[i] + d0 * std::cos(phi0_)) / 10.;
+        w0_ = (ref.z[i] + states.z0[i]) / 10.;
+        omega_ = states.omega[i] * 10.;
+        tanLambda_ = states.tanLambda[i];
+    }
+
+    TVector3 Helix::getPosition(double s) const {
+        double u, v;
+        if (isLine()) {
+            u = u0_ + s * std::cos(phi0_);
+            v = v0_ + s * std::sin(phi0_);
+        } else {
+            double phi = phi0_ + omega_ * s;
+            u = u0_ + (std::sin(phi) - std::sin(phi0_)) / omega_;
+            v = v0_ - (std::cos(phi) - std::cos(phi0_)) / omega_;
+        }
+        double w = w0_ + s * tanLambda_;
+
+        // From the tracking frame to the detector frame
+        return TVector3(v, w, u);
+    }
+
+    double Helix::getPathLength(const TVector3& point) const {
+        double du = point.Z() - u0_;
+        double dv = point.X() - v0_;
+        if (isLine()) {
+            return du * std::cos(phi0_) + dv * std::sin(phi0_);
+        }
+
+        // Angle of the point around the center of the circle
+        double uc = -std::sin(phi0_) / omega_;
+        double vc = std::cos(phi0_) / omega_;
+        double phi = std::atan2(omega_ * (du - uc), -omega_ * (dv - vc));
+        double dphi = TVector2::Phi_mpi_pi(phi - phi0_);
+        return dphi / omega_;
+    }
+
+    double Helix::getStep(double tolerance) const {
+        if (isLine()) {
+            return std::numeric_limits<double>::infinity();
+        }
+        double radius = 1. / std::abs(omega_);
+        if (tolerance >= radius) {
+            return TMath::PiOver2() * radius;
+        }
+        double dphi = 2. * std::acos(1. - tolerance / radius);
+        return dphi * radius;
+    }
+
+    double Helix::getExitPathLength(double maxR, double maxZ, double maxLength, double tolerance) const {
+        if (!isInside(0., maxR, maxZ)) {
+            return 0.;
+        }
+
+        // Walk along the helix to the first point outside and then bisect the last step.
+        double step = std::min(getStep(tolerance), std::max(maxR, maxZ) / 10.);
+        double inside = 0.;
+        double outside = maxLength;
+        for (double s = step; s < maxLength; s += step) {
+            if (!isInside(s, maxR, maxZ)) {
+                outside = s;
+                break;
+            }
+            inside = s;
+        }
+        if (outside == maxLength && isInside(maxLength, maxR, maxZ)) {
+            return maxLength;
+        }
+        while (outside - inside > tolerance) {
+            double s = (inside + outside) / 2.;
+            if (isInside(s, maxR, maxZ)) {
+                inside = s;
+            } else {
+                outside = s;
+            }
+        }
+        return inside;
+    }
+
+    double Helix::getTurnLength() const {
+        return isLine() ? 0. : TMath::TwoPi() / std::abs(omega_);
+    }
+
+    bool Helix::isLine() const {
+        return std::abs(omega_) < 1e-12;
+    }
+
+    bool Helix::isInside(double s, double maxR, double maxZ) const {
+        TVector3 pos = getPosition(s);
+        return pos.Perp2() < maxR * maxR && std::abs(pos.Z()) < maxZ;
+    }
+}
@@ -0,0 +1,69 @@
+#include "HelixTrack.h"
+
+// ROOT
+#include "TEveTrackPropagator.h"
+
+// C++ standard library
+#include <algorithm>
+#include <cmath>
+
+namespace hps {
+
+    HelixTrack::HelixTrack(TEveRecTrack* recTrack, TEveTrackPropagator* propagator) :
+            LCObjectElement<TEveTrack>(recTrack, propagator) {
+    }
+
+    HelixTrack::~HelixTrack() {
+    }
+
+    void HelixTrack::addSegment(const Helix& helix, double length) {
+        Segment segment = {helix, length, false};
+        segments_.push_back(segment);
+    }
+
+    void HelixTrack::addOpenSegment(const Helix& helix) {
+        Segment segment = {helix, 0., true};
+        segments_.push_back(segment);
+    }
+
+    void HelixTrack::setTolerance(double tolerance) {
+        tolerance_ = tolerance;
+    }
+
+    void HelixTrack::MakeTrack(Bool_t recurse) {
+        if (GetLockPoints()) {
+            return;
+        }
+
+        Reset(0);
+        TEveTrackPropagator& prop = fPropagator != nullptr ? *fPropagator : TEveTrackPropagator::fgDefault;
+        for (std::vector<Segment>::const_iterator it = segments_.begin(); it != segments_.end(); it++) {
+            double length = it->length;
+            if (it->open) {
+                double maxLength = it->helix.getTurnLength() > 0. ?
+                        prop.GetMaxOrbs() * it->helix.getTurnLength() :
+                        2. * std::sqrt(prop.GetMaxR() * prop.GetMaxR() + prop.GetMaxZ() * prop.GetMaxZ());
+                length = it->helix.getExitPathLength(prop.GetMaxR(), prop.GetMaxZ(), maxLength, tolerance_);
+            }
+            addPoints(it->helix, length);
+        }
+
+        if (recurse) {
+            for (List_i it = fChildren.begin(); it != fChildren.end(); it++) {
+                TEveTrack* track = dynamic_cast<TEveTrack*>(*it);
+                if (track != nullptr) {
+                    track->MakeTrack(recurse);
+                }
+            }
+        }
+    }
+
+    void HelixTrack::addPoints(const Helix& helix, double length) {
+        // Evenly spaced points along the segment, as close as the tolerance allows.
+        int nSteps = std::max(1, (int) std::ceil(std::abs(length) / helix.getStep(tolerance_)));
+        for (int i = 0; i <= nSteps; i++) {
+            TVector3 pos = helix.getPosition(length * i / nSteps);
+            SetNextPoint(pos.X(), pos.Y(), pos.Z());
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#include "LCBoxSet.h"
+
+// C++ standard library
+#include <algorithm>
+
+namespace hps {
+
+    LCBoxSet::LCBoxSet(const char* name, std::shared_ptr<const EventStore> store,
+                       LCObjectListUserData::TitleFunction titleFunction) :
+            DeferredStamp<TEveBoxSet>(name) {
+        Reset(TEveBoxSet::kBT_FreeBox, kTRUE, 64);
+        SetAlwaysSecSelect(kTRUE);
+        SetTooltipCBFoo(&LCBoxSet::tooltip);
+        TEveElement::SetUserData(new LCObjectListUserData(store, titleFunction));
+    }
+
+    LCBoxSet::~LCBoxSet() {
+        delete getObjects();
+    }
+
+    void LCBoxSet::addBox(int index, const Float_t* vertices, Color_t color) {
+        AddBox(vertices);
+        DigitColor(color);
+        getObjects()->add(index);
+    }
+
+    LCObjectListUserData* LCBoxSet::getObjects() {
+        return static_cast<LCObjectListUserData*>(TEveElement::GetUserData());
+    }
+
+    int LCBoxSet::getNumberOfBoxes() {
+        return GetPlex()->Size();
+    }
+
+    void LCBoxSet::getBox(int i, Float_t* vertices, UChar_t* rgba) {
+        BFreeBox_t* box = static_cast<BFreeBox_t*>(GetDigit(i));
+        std::copy(&box->fVertices[0][0], &box->fVertices[0][0] + 24, vertices);
+        std::copy((UChar_t*) &box->fValue, (UChar_t*) &box->fValue + 4, rgba);
+    }
+
+    void LCBoxSet::DigitSelected(Int_t idx) {
+        SetElementTitle(getObjects()->getTitle(idx));
+        TEveBoxSet::DigitSelected(idx);
+    }
+
+    TString LCBoxSet::tooltip(TEveDigitSet* digits, Int_t idx) {
+        return static_cast<LCBoxSet*>(digits)->getObjects()->getTitle(idx);
+    }
+}
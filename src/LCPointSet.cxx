@@ -0,0 +1,30 @@
+#include "LCPointSet.h"
+
+namespace hps {
+
+    LCPointSet::LCPointSet(const char* name,
+                           Int_t nPoints,
+                           std::shared_ptr<const EventStore> store,
+                           LCObjectListUserData::TitleFunction titleFunction) :
+            DeferredStamp<TEvePointSet>(name, nPoints) {
+        SetUserData(new LCObjectListUserData(store, titleFunction));
+    }
+
+    LCPointSet::~LCPointSet() {
+        delete getObjects();
+    }
+
+    void LCPointSet::addPoint(int index, Float_t x, Float_t y, Float_t z) {
+        SetNextPoint(x, y, z);
+        getObjects()->add(index);
+    }
+
+    LCObjectListUserData* LCPointSet::getObjects() {
+        return static_cast<LCObjectListUserData*>(GetUserData());
+    }
+
+    void LCPointSet::PointSelected(Int_t id) {
+        SetElementTitle(getObjects()->getTitle(id));
+        TEvePointSet::PointSelected(id);
+    }
+}
@@ -0,0 +1,193 @@
+#include "LogSink.h"
+
+// C++ standard library
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <thread>
+
+namespace hps {
+
+    struct LogEntry {
+        std::ostream* stream{nullptr};
+        std::string text;
+        std::atomic<LogEntry*> next{nullptr};
+    };
+
+    /*
+     * Queue of messages with any number of producers and the writer as its
+     * only consumer, where a push is one exchange of the head.
+     */
+    class LogQueue {
+
+        public:
+
+            LogQueue() : head_(&stub_), tail_(&stub_) {
+            }
+
+            void push(LogEntry* entry) {
+                entry->next.store(nullptr, std::memory_order_relaxed);
+                LogEntry* prev = head_.exchange(entry, std::memory_order_acq_rel);
+                prev->next.store(entry, std::memory_order_release);
+            }
+
+            /*
+             * Pop the oldest entry, or nullptr if the queue is empty or the
+             * push of the oldest entry is not complete yet.
+             */
+            LogEntry* pop() {
+                LogEntry* tail = tail_;
+                LogEntry* next = tail->next.load(std::memory_order_acquire);
+                if (tail == &stub_) {
+                    if (next == nullptr) {
+                        return nullptr;
+                    }
+                    tail_ = next;
+                    tail = next;
+                    next = next->next.load(std::memory_order_acquire);
+                }
+                if (next != nullptr) {
+                    tail_ = next;
+                    return tail;
+                }
+                if (tail != head_.load(std::memory_order_acquire)) {
+                    return nullptr;
+                }
+                // Put the stub behind the last entry, so that it can be popped.
+                push(&stub_);
+                next = tail->next.load(std::memory_order_acquire);
+                if (next != nullptr) {
+                    tail_ = next;
+                    return tail;
+                }
+                return nullptr;
+            }
+
+        private:
+
+            LogEntry stub_;
+            std::atomic<LogEntry*> head_;
+            LogEntry* tail_;
+    };
+
+    struct LogWriter {
+
+        LogQueue queue;
+
+        // Number of messages pushed, and written and flushed by the writer
+        std::atomic<unsigned long> pushed{0};
+        std::atomic<unsigned long> flushed{0};
+
+        // Number of messages that a caller of flush is waiting for
+        std::atomic<unsigned long> requested{0};
+
+        // The mutex is only taken to wake the writer when it is idle, or to
+        // wake the threads that wait until the queue is drained.
+        std::atomic<bool> idle{false};
+        std::atomic<int> draining{0};
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::condition_variable drained;
+
+        std::once_flag started;
+
+        void run() {
+            std::set<std::ostream*> streams;
+            unsigned long count = 0;
+            while (true) {
+                LogEntry* entry = queue.pop();
+                if (entry != nullptr) {
+                    *entry->stream << entry->text;
+                    streams.insert(entry->stream);
+                    delete entry;
+                    count++;
+                    if (count < requested.load(std::memory_order_acquire)) {
+                        continue;
+                    }
+                }
+                for (std::set<std::ostream*>::iterator it = streams.begin(); it != streams.end(); it++) {
+                    (*it)->flush();
+                }
+                streams.clear();
+                flushed.store(count);
+                if (draining.load() > 0) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    drained.notify_all();
+                }
+                if (entry != nullptr) {
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(mutex);
+                idle = true;
+                cond.wait(lock, [this, count]() {
+                    return pushed.load() != count;
+                });
+                idle = false;
+            }
+        }
+
+        void wake() {
+            if (idle) {
+                std::lock_guard<std::mutex> lock(mutex);
+                cond.notify_one();
+            }
+        }
+
+        /*
+         * Ask the writer to flush the streams once the messages pushed so far
+         * are written, and return how many these are.
+         */
+        unsigned long request() {
+            unsigned long target = pushed.load();
+            unsigned long current = requested.load();
+            while (current < target && !requested.compare_exchange_weak(current, target)) {
+            }
+            wake();
+            return target;
+        }
+    };
+
+    static LogWriter& writer() {
+        // Never destroyed, so that messages can be logged until the process ends.
+        static LogWriter* w = new LogWriter;
+        return *w;
+    }
+
+    static void drainAtExit() {
+        LogSink::drain();
+    }
+
+    void LogSink::write(std::ostream* stream, std::string text) {
+        LogWriter& w = writer();
+        std::call_once(w.started, [&w]() {
+            std::thread(&LogWriter::run, &w).detach();
+            std::atexit(drainAtExit);
+        });
+        LogEntry* entry = new LogEntry;
+        entry->stream = stream;
+        entry->text.swap(text);
+        w.queue.push(entry);
+        w.pushed++;
+        w.wake();
+    }
+
+    void LogSink::flush() {
+        writer().request();
+    }
+
+    void LogSink::drain() {
+        LogWriter& w = writer();
+        unsigned long target = w.request();
+        w.draining++;
+        {
+            std::unique_lock<std::mutex> lock(w.mutex);
+            w.drained.wait(lock, [&w, target]() {
+                return w.flushed.load() >= target;
+            });
+        }
+        w.draining--;
+    }
+}
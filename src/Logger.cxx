@@ -1,5 +1,8 @@
 #include "Logger.h"
 
+// C++ standard library
+#include <mutex>
+
 ClassImp(hps::Logger);
 
 namespace hps {
@@ -9,20 +12,42 @@ namespace hps {
 
     std::string LogHandler::DEFAULT = std::string("DEFAULT");
 
+    // Loggers are also created on worker threads.
+    static std::mutex& registryMutex() {
+        static std::mutex* mutex = new std::mutex;
+        return *mutex;
+    }
+
+    LogHandler* LogHandler::getDefault() {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        if (HANDLERS_.find(DEFAULT) == HANDLERS_.end()) {
+            HANDLERS_[DEFAULT] = new LogHandler(DEFAULT);
+        }
+        return HANDLERS_[DEFAULT];
+    }
+
     Logger::Logger(std::string name,
                    int level,
                    LogHandler* handler) :
             name_(name),
+            handler_(handler),
             level_(level) {
-        LOGGERS_[name] = this;
-        if (handler == nullptr) {
+        if (handler_ == nullptr) {
             handler_ = LogHandler::getDefault();
         }
+        std::lock_guard<std::mutex> lock(registryMutex());
+        LOGGERS_[name] = this;
     }
 
     Logger::~Logger() {
     }
 
+    Logger* Logger::getLogger(std::string& name) {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        LoggerMapIter it = LOGGERS_.find(name);
+        return it != LOGGERS_.end() ? it->second : nullptr;
+    }
+
     int Logger::getLogLevel() {
         return level_;
     }
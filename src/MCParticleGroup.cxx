@@ -0,0 +1,62 @@
+#include "MCParticleGroup.h"
+
+namespace hps {
+
+    MCParticleGroup::MCParticleGroup(std::shared_ptr<const EventStore> store,
+                                     int owner,
+                                     TEveElement* parent,
+                                     const std::vector<int>& particles,
+                                     LCObjectListUserData::TitleFunction titleFunction) :
+            LCPointSet("Collapsed MCParticles", particles.size(), store, titleFunction),
+            store_(store),
+            owner_(owner),
+            parent_(parent),
+            particles_(particles) {
+        const EventStore::MCParticles& mcps = store_->mcParticles;
+        double energy = 0.;
+        for (size_t n = 0; n < particles_.size(); n++) {
+            int i = particles_[n];
+            addPoint(i, mcps.vertex.x[i], mcps.vertex.y[i], mcps.vertex.z[i]);
+            if (mcps.parent[i] == owner_) {
+                energy += mcps.energy[i];
+            }
+        }
+        SetElementName(TString::Format("Collapsed MCParticles (%d)", (int) particles_.size()));
+        SetElementTitle(TString::Format("%d collapsed MCParticles\n"
+                                        "Energy = %.3f\n"
+                                        "Select the parent to expand",
+                                        (int) particles_.size(), energy));
+        SetMarkerStyle(kFullDotMedium);
+        SetMarkerColor(kOrange);
+    }
+
+    MCParticleGroup::~MCParticleGroup() {
+    }
+
+    std::shared_ptr<const EventStore> MCParticleGroup::getStore() {
+        return store_;
+    }
+
+    int MCParticleGroup::getOwner() {
+        return owner_;
+    }
+
+    TEveElement* MCParticleGroup::getParent() {
+        return parent_;
+    }
+
+    const std::vector<int>& MCParticleGroup::getParticles() {
+        return particles_;
+    }
+
+    std::vector<int> MCParticleGroup::getRoots() {
+        const std::vector<int>& parents = store_->mcParticles.parent;
+        std::vector<int> roots;
+        for (size_t n = 0; n < particles_.size(); n++) {
+            if (parents[particles_[n]] == owner_) {
+                roots.push_back(particles_[n]);
+            }
+        }
+        return roots;
+    }
+}
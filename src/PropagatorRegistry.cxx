@@ -0,0 +1,96 @@
+#include "PropagatorRegistry.h"
+
+// C++ standard library
+#include <stdexcept>
+#include <tuple>
+
+namespace hps {
+
+    bool PropagatorRegistry::Settings::operator<(const Settings& rhs) const {
+        return std::tie(charged, delta, maxR, maxZ, maxOrbs,
+                        fitDaughters, fitReferences, fitDecay, fitCluster2Ds, fitLineSegments)
+                < std::tie(rhs.charged, rhs.delta, rhs.maxR, rhs.maxZ, rhs.maxOrbs,
+                           rhs.fitDaughters, rhs.fitReferences, rhs.fitDecay, rhs.fitCluster2Ds,
+                           rhs.fitLineSegments);
+    }
+
+    PropagatorRegistry::PropagatorRegistry(double bY) :
+            Logger("PropagatorRegistry"),
+            bY_(bY) {
+    }
+
+    PropagatorRegistry::~PropagatorRegistry() {
+        for (std::map<Key, TEveTrackPropagator*>::iterator it = propagators_.begin();
+                it != propagators_.end(); it++) {
+            // Deleted here unless tracks still refer to it.
+            it->second->DecRefCount();
+        }
+    }
+
+    TEveTrackPropagator* PropagatorRegistry::getPropagator(const Settings& settings) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Key key(bY_, settings);
+        std::map<Key, TEveTrackPropagator*>::iterator fnd = propagators_.find(key);
+        if (fnd != propagators_.end()) {
+            return fnd->second;
+        }
+        HPS_LOG(FINE) << "Creating " << (settings.charged ? "charged" : "neutral")
+                << " propagator with bY = " << bY_ << ", max orbits = " << settings.maxOrbs << std::endl;
+        TEveTrackPropagator* propagator = createPropagator(settings, bY_);
+        propagator->IncRefCount();
+        propagators_[key] = propagator;
+        return propagator;
+    }
+
+    TEveTrackPropagator* PropagatorRegistry::copyPropagator(TEveTrackPropagator* propagator) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (std::map<Key, TEveTrackPropagator*>::iterator it = propagators_.begin();
+                it != propagators_.end(); it++) {
+            if (it->second == propagator) {
+                TEveTrackPropagator* copy = createPropagator(it->first.second, it->first.first);
+                copy->SetDestroyOnZeroRefCnt(kFALSE);
+                return copy;
+            }
+        }
+        throw std::runtime_error("Propagator is not in the registry!");
+    }
+
+    TEveTrackPropagator* PropagatorRegistry::createPropagator(const Settings& settings, double bY) {
+        TEveTrackPropagator* propagator = new TEveTrackPropagator();
+        propagator->SetMagFieldObj(new TEveMagFieldConst(0.0, bY, 0.0));
+        propagator->SetDelta(settings.delta);
+        propagator->SetMaxR(settings.maxR);
+        propagator->SetMaxZ(settings.maxZ);
+        propagator->SetMaxOrbs(settings.maxOrbs);
+        propagator->SetFitDaughters(settings.fitDaughters);
+        propagator->SetFitReferences(settings.fitReferences);
+        propagator->SetFitDecay(settings.fitDecay);
+        propagator->SetFitCluster2Ds(settings.fitCluster2Ds);
+        propagator->SetFitLineSegments(settings.fitLineSegments);
+        return propagator;
+    }
+
+    void PropagatorRegistry::setMagFieldY(double bY) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (bY == bY_) {
+            return;
+        }
+        log(INFO) << "Changing field of " << propagators_.size()
+                << " propagators to bY = " << bY << std::endl;
+        bY_ = bY;
+        std::map<Key, TEveTrackPropagator*> propagators;
+        for (std::map<Key, TEveTrackPropagator*>::iterator it = propagators_.begin();
+                it != propagators_.end(); it++) {
+            TEveTrackPropagator* propagator = it->second;
+            propagator->SetMagFieldObj(new TEveMagFieldConst(0.0, bY, 0.0));
+            propagator->RebuildTracks();
+            propagators[Key(bY, it->first.second)] = propagator;
+        }
+        propagators_.swap(propagators);
+    }
+
+    double PropagatorRegistry::getMagFieldY() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return bY_;
+    }
+}
@@ -0,0 +1,96 @@
+#include "SceneCache.h"
+
+// ROOT
+#include "TEveDigitSet.h"
+#include "TPolyMarker3D.h"
+
+namespace hps {
+
+    SceneCache::SceneCache(size_t maxSize) :
+            Logger("SceneCache"),
+            maxSize_(maxSize) {
+    }
+
+    SceneCache::~SceneCache() {
+        for (SceneList::iterator it = scenes_.begin(); it != scenes_.end(); it++) {
+            destroy(it->second);
+        }
+    }
+
+    bool SceneCache::contains(const Key& key) {
+        return index_.find(key) != index_.end();
+    }
+
+    void SceneCache::put(const Key& key, Scene* scene) {
+        Scene* old = take(key);
+        if (old != nullptr) {
+            destroy(old);
+        }
+        if (scene->size > maxSize_) {
+            HPS_LOG(FINE) << "Scene for event " << key.second << " is too large to cache: "
+                    << scene->size / 1024 << " kB" << std::endl;
+            destroy(scene);
+            return;
+        }
+        while (size_ + scene->size > maxSize_ && scenes_.size() > 0) {
+            std::pair<Key, Scene*> last = scenes_.back();
+            HPS_LOG(FINER) << "Evicting cached scene for event: " << last.first.second << std::endl;
+            scenes_.pop_back();
+            index_.erase(last.first);
+            size_ -= last.second->size;
+            destroy(last.second);
+        }
+        scenes_.push_front(std::make_pair(key, scene));
+        index_[key] = scenes_.begin();
+        size_ += scene->size;
+        HPS_LOG(FINE) << "Cached scene for event " << key.second << " with size "
+                << scene->size / 1024 << " kB; cache has " << scenes_.size() << " scenes using "
+                << size_ / 1024 << " of " << maxSize_ / 1024 << " kB" << std::endl;
+    }
+
+    SceneCache::Scene* SceneCache::take(const Key& key) {
+        std::map<Key, SceneList::iterator>::iterator fnd = index_.find(key);
+        if (fnd == index_.end()) {
+            return nullptr;
+        }
+        Scene* scene = fnd->second->second;
+        scenes_.erase(fnd->second);
+        index_.erase(fnd);
+        size_ -= scene->size;
+        return scene;
+    }
+
+    size_t SceneCache::getMaxSize() {
+        return maxSize_;
+    }
+
+    size_t SceneCache::getSize() {
+        return size_;
+    }
+
+    size_t SceneCache::estimateSize(TEveElement* element) {
+        // Fixed cost of an element with its name, title and list tree bookkeeping
+        size_t size = 512;
+        TPolyMarker3D* points = dynamic_cast<TPolyMarker3D*>(element);
+        if (points != nullptr) {
+            size += points->GetN() * 3 * sizeof(Float_t);
+        }
+        TEveDigitSet* digits = dynamic_cast<TEveDigitSet*>(element);
+        if (digits != nullptr) {
+            size += digits->GetPlex()->Size() * digits->GetPlex()->S();
+        }
+        for (TEveElement::List_i it = element->BeginChildren(); it != element->EndChildren(); it++) {
+            size += estimateSize(*it);
+        }
+        return size;
+    }
+
+    void SceneCache::destroy(Scene* scene) {
+        for (std::vector<TEveElement*>::iterator it = scene->elements.begin();
+                it != scene->elements.end(); it++) {
+            // Elements without a parent are deleted once nothing denies it.
+            (*it)->DecDenyDestroy();
+        }
+        delete scene;
+    }
+}
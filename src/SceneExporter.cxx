@@ -0,0 +1,306 @@
+#include "SceneExporter.h"
+
+// HPS
+#include "DetectorGeometry.h"
+#include "EventObjects.h"
+#include "LCBoxSet.h"
+#include "LcioLock.h"
+#include "PropagatorRegistry.h"
+#include "ThreadPool.h"
+
+// ROOT
+#include "TDatabasePDG.h"
+#include "TEveTrack.h"
+#include "TEveUtil.h"
+#include "TSystem.h"
+
+// LCIO
+#include "IOIMPL/LCFactory.h"
+
+// C++ standard library
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace hps {
+
+    SceneExporter::SceneExporter(EventIndex* index, DetectorGeometry* det, double bY, int nThreads) :
+            Logger("SceneExporter"),
+            index_(index),
+            detectorName_(index->getDetectorName()) {
+
+        if (nThreads < 1) {
+            throw std::runtime_error("Number of export threads must be at least one.");
+        }
+
+        // Shared tables are filled before the workers start.
+        TDatabasePDG::Instance()->GetParticle(11);
+        det->setMaxThreads(nThreads);
+
+        // Propagators keep the state of the track being stepped, so every worker has its own.
+        workers_.resize(nThreads);
+        for (std::vector<Worker>::iterator it = workers_.begin(); it != workers_.end(); it++) {
+            it->propagators = new PropagatorRegistry(bY);
+            it->builder = new EventObjects(det, it->propagators);
+        }
+    }
+
+    SceneExporter::~SceneExporter() {
+        LcioLock lcioLock;
+        for (std::vector<Worker>::iterator it = workers_.begin(); it != workers_.end(); it++) {
+            if (it->reader != nullptr) {
+                it->reader->close();
+                delete it->reader;
+            }
+            delete it->builder;
+            delete it->propagators;
+        }
+    }
+
+    void SceneExporter::setLogLevel(int level) {
+        Logger::setLogLevel(level);
+        for (std::vector<Worker>::iterator it = workers_.begin(); it != workers_.end(); it++) {
+            it->propagators->setLogLevel(level);
+            it->builder->setLogLevel(level);
+        }
+    }
+
+    void SceneExporter::setExcludedCollections(const std::set<std::string>& names,
+                                               const std::set<std::string>& types) {
+        for (std::vector<Worker>::iterator it = workers_.begin(); it != workers_.end(); it++) {
+            it->builder->setExcludedCollections(names, types);
+        }
+    }
+
+    void SceneExporter::setMCDetail(double minEnergy, int maxDepth, int maxParticles) {
+        for (std::vector<Worker>::iterator it = workers_.begin(); it != workers_.end(); it++) {
+            it->builder->setMCDetail(minEnergy, maxDepth, maxParticles);
+        }
+    }
+
+    int SceneExporter::run(const std::vector<int>& events, const std::string& outputDir) {
+        gSystem->mkdir(outputDir.c_str(), kTRUE);
+        if (gSystem->AccessPathName(outputDir.c_str())) {
+            throw std::runtime_error("Failed to create output directory: " + outputDir);
+        }
+
+        log(INFO) << "Exporting " << events.size() << " events on "
+                << workers_.size() << " threads to: " << outputDir << std::endl;
+
+        next_ = 0;
+        written_ = 0;
+        std::vector<std::future<void>> futures;
+        {
+            ThreadPool pool(workers_.size());
+            for (size_t w = 0; w < workers_.size(); w++) {
+                Worker& worker = workers_[w];
+                futures.push_back(pool.submit([this, &worker, &events, &outputDir]() {
+                    work(worker, events, outputDir);
+                }));
+            }
+        }
+        for (size_t i = 0; i < futures.size(); i++) {
+            futures[i].get();
+        }
+        return written_;
+    }
+
+    void SceneExporter::work(Worker& worker, const std::vector<int>& events, const std::string& outputDir) {
+        for (size_t n = next_++; n < events.size(); n = next_++) {
+            int i = events[n];
+            if (i < 0 || i >= index_->getNumberOfEvents()) {
+                log(ERROR) << "Event number is not valid: " << i << std::endl;
+                continue;
+            }
+            EVENT::LCEvent* event = read(worker, i);
+            if (event == nullptr) {
+                log(ERROR) << "Failed to read event: " << i << std::endl;
+                continue;
+            }
+
+            std::vector<TEveElementList*> elementLists = worker.builder->build(nullptr, event);
+
+            // The builders only group the lists by type.
+            std::vector<std::string> typeNames(elementLists.size());
+            const EventObjects::TypeMap& typeMap = worker.builder->getTypeMap();
+            for (EventObjects::TypeMap::const_iterator it = typeMap.begin(); it != typeMap.end(); it++) {
+                for (size_t l = 0; l < elementLists.size(); l++) {
+                    if (std::find(it->second.begin(), it->second.end(), elementLists[l]) != it->second.end()) {
+                        typeNames[l] = it->first;
+                    }
+                }
+            }
+
+            const EventIndex::Entry& entry = index_->getEntry(i);
+            std::stringstream fileName;
+            fileName << outputDir << "/event_" << entry.run << "_" << entry.event << ".json";
+            std::ofstream out(fileName.str().c_str());
+            writeScene(out, entry, detectorName_, elementLists, typeNames);
+            out.close();
+            if (out.fail()) {
+                log(ERROR) << "Failed to write scene: " << fileName.str() << std::endl;
+            } else {
+                HPS_LOG(FINE) << "Wrote scene of event " << i << " to: " << fileName.str() << std::endl;
+                written_++;
+            }
+
+            for (size_t l = 0; l < elementLists.size(); l++) {
+                destroy(elementLists[l]);
+            }
+        }
+    }
+
+    EVENT::LCEvent* SceneExporter::read(Worker& worker, int i) {
+        const EventIndex::Entry& entry = index_->getEntry(i);
+        LcioLock lcioLock;
+        EVENT::LCEvent* event = nullptr;
+        try {
+            if (worker.reader != nullptr && worker.file != entry.file) {
+                worker.reader->close();
+                delete worker.reader;
+                worker.reader = nullptr;
+            }
+            if (worker.reader == nullptr) {
+                worker.reader = IOIMPL::LCFactory::getInstance()->createLCReader(IO::LCReader::directAccess);
+                worker.reader->open(index_->getFile(entry.file));
+                worker.file = entry.file;
+            }
+            event = worker.reader->readEvent(entry.run, entry.event);
+        } catch (IO::IOException& ioe) {
+            log(ERROR) << ioe.what() << std::endl;
+        } catch (std::exception& e) {
+            log(ERROR) << e.what() << std::endl;
+        }
+        return event;
+    }
+
+    void SceneExporter::writeScene(std::ostream& out,
+                                   const EventIndex::Entry& entry,
+                                   const std::string& detectorName,
+                                   const std::vector<TEveElementList*>& elementLists,
+                                   const std::vector<std::string>& typeNames) {
+        out << std::fixed << std::setprecision(3);
+        out << "{\"run\":" << entry.run << ",\"event\":" << entry.event << ",\"detector\":";
+        writeString(out, detectorName);
+        out << ",\"collections\":[";
+        for (size_t l = 0; l < elementLists.size(); l++) {
+            if (l > 0) {
+                out << ",";
+            }
+            out << "{\"name\":";
+            writeString(out, elementLists[l]->GetElementName());
+            out << ",\"type\":";
+            writeString(out, typeNames[l]);
+            out << ",\"elements\":[";
+            for (TEveElement::List_i it = elementLists[l]->BeginChildren();
+                    it != elementLists[l]->EndChildren(); it++) {
+                if (it != elementLists[l]->BeginChildren()) {
+                    out << ",";
+                }
+                writeElement(out, *it);
+            }
+            out << "]}";
+        }
+        out << "]}" << std::endl;
+    }
+
+    void SceneExporter::writeElement(std::ostream& out, TEveElement* element) {
+        out << "{";
+        if (TEveTrack* track = dynamic_cast<TEveTrack*>(element)) {
+            out << "\"kind\":\"track\",\"points\":";
+            writePoints(out, track->GetP(), track->Size());
+        } else if (TEvePointSet* points = dynamic_cast<TEvePointSet*>(element)) {
+            out << "\"kind\":\"points\",\"points\":";
+            writePoints(out, points->GetP(), points->Size());
+        } else if (LCBoxSet* boxes = dynamic_cast<LCBoxSet*>(element)) {
+            out << "\"kind\":\"boxes\",\"boxes\":[";
+            Float_t vertices[24];
+            UChar_t rgba[4];
+            for (int i = 0; i < boxes->getNumberOfBoxes(); i++) {
+                boxes->getBox(i, vertices, rgba);
+                out << (i > 0 ? ",{\"color\":" : "{\"color\":");
+                writeColor(out, rgba);
+                out << ",\"vertices\":";
+                writePoints(out, vertices, 8);
+                out << "}";
+            }
+            out << "]";
+        } else {
+            out << "\"kind\":\"group\"";
+        }
+        out << ",\"name\":";
+        writeString(out, element->GetElementName());
+        if (element->GetMainColorPtr() != nullptr) {
+            UChar_t rgba[4];
+            TEveUtil::ColorFromIdx(element->GetMainColor(), rgba, kFALSE);
+            out << ",\"color\":";
+            writeColor(out, rgba);
+        }
+        out << ",\"visible\":" << (element->GetRnrSelf() ? "true" : "false");
+        if (element->HasChildren()) {
+            out << ",\"children\":[";
+            for (TEveElement::List_i it = element->BeginChildren(); it != element->EndChildren(); it++) {
+                if (it != element->BeginChildren()) {
+                    out << ",";
+                }
+                writeElement(out, *it);
+            }
+            out << "]";
+        }
+        out << "}";
+    }
+
+    void SceneExporter::writePoints(std::ostream& out, const Float_t* points, int n) {
+        out << "[";
+        for (int i = 0; i < 3 * n; i++) {
+            if (i > 0) {
+                out << ",";
+            }
+            // JSON has no NaN or infinity.
+            if (std::isfinite(points[i])) {
+                out << points[i];
+            } else {
+                out << "null";
+            }
+        }
+        out << "]";
+    }
+
+    void SceneExporter::writeColor(std::ostream& out, const UChar_t* rgba) {
+        char color[10];
+        snprintf(color, sizeof(color), "\"#%02x%02x%02x\"", rgba[0], rgba[1], rgba[2]);
+        out << color;
+    }
+
+    void SceneExporter::writeString(std::ostream& out, const std::string& str) {
+        out << "\"";
+        for (std::string::const_iterator it = str.begin(); it != str.end(); it++) {
+            if (*it == '"' || *it == '\\') {
+                out << "\\" << *it;
+            } else if ((unsigned char) *it < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", *it);
+                out << escaped;
+            } else {
+                out << *it;
+            }
+        }
+        out << "\"";
+    }
+
+    void SceneExporter::destroy(TEveElement* element) {
+        // Without the Eve manager, elements are deleted from the leaves up so
+        // that no element looks for the manager when it loses its last parent.
+        while (element->HasChildren()) {
+            destroy(element->FirstChild());
+        }
+
+        // Elements with user data delete it themselves.
+        delete element;
+    }
+}
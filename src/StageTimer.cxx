@@ -0,0 +1,104 @@
+#include "StageTimer.h"
+
+// C++ standard library
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace hps {
+
+    // Number of recent durations of a stage that its 95th percentile is taken from
+    static const size_t N_RECENT = 100;
+
+    struct StageSamples {
+        std::string stage;
+        std::vector<double> recent;
+        size_t next{0};
+        double sum{0.};
+        double last{0.};
+        int count{0};
+    };
+
+    struct StageTimes {
+        std::mutex mutex;
+        std::vector<StageSamples> stages;
+        std::vector<std::pair<std::string, int>> counts;
+    };
+
+    static StageTimes& times() {
+        static StageTimes t;
+        return t;
+    }
+
+    std::atomic<bool> StageTimer::enabled_{false};
+
+    void StageTimer::setEnabled(bool enabled) {
+        enabled_ = enabled;
+    }
+
+    void StageTimer::record(const std::string& stage, double seconds) {
+        StageTimes& t = times();
+        std::lock_guard<std::mutex> lock(t.mutex);
+        std::vector<StageSamples>::iterator it = t.stages.begin();
+        while (it != t.stages.end() && it->stage != stage) {
+            it++;
+        }
+        if (it == t.stages.end()) {
+            StageSamples samples;
+            samples.stage = stage;
+            t.stages.push_back(samples);
+            it = t.stages.end() - 1;
+        }
+        if (it->recent.size() < N_RECENT) {
+            it->recent.push_back(seconds);
+        } else {
+            it->recent[it->next] = seconds;
+        }
+        it->next = (it->next + 1) % N_RECENT;
+        it->sum += seconds;
+        it->last = seconds;
+        it->count++;
+    }
+
+    void StageTimer::setCount(const std::string& collection, int count) {
+        StageTimes& t = times();
+        std::lock_guard<std::mutex> lock(t.mutex);
+        t.counts.push_back(std::make_pair(collection, count));
+    }
+
+    void StageTimer::clearCounts() {
+        StageTimes& t = times();
+        std::lock_guard<std::mutex> lock(t.mutex);
+        t.counts.clear();
+    }
+
+    void StageTimer::clear() {
+        StageTimes& t = times();
+        std::lock_guard<std::mutex> lock(t.mutex);
+        t.stages.clear();
+        t.counts.clear();
+    }
+
+    std::vector<std::pair<std::string, StageTimer::Stats>> StageTimer::getStats() {
+        StageTimes& t = times();
+        std::lock_guard<std::mutex> lock(t.mutex);
+        std::vector<std::pair<std::string, Stats>> stats;
+        for (std::vector<StageSamples>::iterator it = t.stages.begin(); it != t.stages.end(); it++) {
+            std::vector<double> sorted(it->recent);
+            std::sort(sorted.begin(), sorted.end());
+            Stats s;
+            s.last = it->last;
+            s.mean = it->sum / it->count;
+            s.p95 = sorted[std::min(sorted.size() - 1, (size_t) std::ceil(0.95 * sorted.size()) - 1)];
+            s.count = it->count;
+            stats.push_back(std::make_pair(it->stage, s));
+        }
+        return stats;
+    }
+
+    std::vector<std::pair<std::string, int>> StageTimer::getCounts() {
+        StageTimes& t = times();
+        std::lock_guard<std::mutex> lock(t.mutex);
+        return t.counts;
+    }
+}
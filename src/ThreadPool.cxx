@@ -0,0 +1,60 @@
+#include "ThreadPool.h"
+
+namespace hps {
+
+    static thread_local bool workerThread = false;
+
+    ThreadPool::ThreadPool(int nThreads) :
+            Logger("ThreadPool") {
+        for (int i = 0; i < nThreads; i++) {
+            threads_.push_back(std::thread(&ThreadPool::run, this));
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        for (std::vector<std::thread>::iterator it = threads_.begin(); it != threads_.end(); it++) {
+            it->join();
+        }
+    }
+
+    std::future<void> ThreadPool::submit(const std::function<void()>& task) {
+        std::packaged_task<void()> packaged(task);
+        std::future<void> future = packaged.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(packaged));
+        }
+        cond_.notify_one();
+        return future;
+    }
+
+    int ThreadPool::getNumberOfThreads() {
+        return threads_.size();
+    }
+
+    bool ThreadPool::isWorkerThread() {
+        return workerThread;
+    }
+
+    void ThreadPool::run() {
+        workerThread = true;
+        while (true) {
+            std::packaged_task<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+                if (tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+}
@@ -0,0 +1,117 @@
+#include "TrackMaker.h"
+
+// HPS
+#include "PropagatorRegistry.h"
+#include "ThreadPool.h"
+
+// C++ standard library
+#include <algorithm>
+#include <future>
+#include <map>
+
+namespace hps {
+
+    TrackMaker::TrackMaker(PropagatorRegistry* propagators, ThreadPool* pool) :
+            Logger("TrackMaker"),
+            propagators_(propagators),
+            pool_(pool) {
+    }
+
+    TrackMaker::~TrackMaker() {
+    }
+
+    void TrackMaker::addTrack(TEveTrack* track, TEveTrackPropagator* propagator) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        PendingTrack pending;
+        pending.track = track;
+        pending.propagator = propagator;
+        pending_.push_back(pending);
+    }
+
+    void TrackMaker::makeTracks(size_t maxTracks) {
+
+        // Take the tracks to make out of the queue.
+        std::vector<PendingTrack> tracks;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (maxTracks == 0 || maxTracks >= pending_.size()) {
+                tracks.swap(pending_);
+            } else {
+                tracks.assign(pending_.begin(), pending_.begin() + maxTracks);
+                pending_.erase(pending_.begin(), pending_.begin() + maxTracks);
+            }
+        }
+
+        int nTasks = 0;
+        if (pool_ != nullptr) {
+            nTasks = std::min(pool_->getNumberOfThreads(), (int) tracks.size() / minTracksPerTask_);
+        }
+        HPS_LOG(FINE) << "Making " << tracks.size() << " tracks in "
+                << std::max(nTasks, 1) << " tasks" << std::endl;
+
+        if (nTasks < 1) {
+            for (std::vector<PendingTrack>::iterator it = tracks.begin(); it != tracks.end(); it++) {
+                it->track->SetPropagator(it->propagator);
+                it->track->MakeTrack(false);
+            }
+            return;
+        }
+
+        std::vector<std::vector<TEveTrackPropagator*>> copies(nTasks);
+        std::vector<std::future<void>> futures;
+        size_t chunk = (tracks.size() + nTasks - 1) / nTasks;
+        for (int t = 0; t < nTasks; t++) {
+            size_t begin = t * chunk;
+            size_t end = std::min(begin + chunk, tracks.size());
+            futures.push_back(pool_->submit([this, &tracks, begin, end, &copies, t]() {
+                makeTracks(tracks, begin, end, copies[t]);
+            }));
+        }
+        for (size_t i = 0; i < futures.size(); i++) {
+            futures[i].wait();
+        }
+
+        // Give the tracks their shared propagators, which are used to rebuild them later.
+        for (std::vector<PendingTrack>::iterator it = tracks.begin(); it != tracks.end(); it++) {
+            it->track->SetPropagator(it->propagator);
+        }
+        for (size_t t = 0; t < copies.size(); t++) {
+            for (size_t c = 0; c < copies[t].size(); c++) {
+                delete copies[t][c];
+            }
+        }
+
+        for (size_t i = 0; i < futures.size(); i++) {
+            futures[i].get();
+        }
+    }
+
+    void TrackMaker::makeTracks(std::vector<PendingTrack>& tracks, size_t begin, size_t end,
+                                std::vector<TEveTrackPropagator*>& copies) {
+        std::map<TEveTrackPropagator*, TEveTrackPropagator*> copyMap;
+        for (size_t i = begin; i < end; i++) {
+            PendingTrack& pending = tracks[i];
+            TEveTrackPropagator*& copy = copyMap[pending.propagator];
+            if (copy == nullptr) {
+                copy = propagators_->copyPropagator(pending.propagator);
+                copies.push_back(copy);
+            }
+            pending.track->SetPropagator(copy);
+            pending.track->MakeTrack(false);
+        }
+    }
+
+    void TrackMaker::clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.clear();
+    }
+
+    int TrackMaker::getNumberOfTracks() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pending_.size();
+    }
+
+    void TrackMaker::setMinTracksPerTask(int minTracksPerTask) {
+        minTracksPerTask_ = std::max(minTracksPerTask, 1);
+    }
+}